@@ -0,0 +1,65 @@
+#include "airtime.h"
+
+// On-air duration of a received frame, from the PHY fields the driver
+// reports. Everything is table driven so the sniffer pays a couple of
+// lookups and one divide per frame. Tables live in DRAM because they are
+// read from the Wi-Fi callback.
+
+enum PhyKind : uint8_t { PHY_NONE, PHY_DSSS_LONG, PHY_DSSS_SHORT, PHY_OFDM };
+
+struct LegacyRate {
+  uint8_t kind;
+  uint8_t param;  // DSSS: rate in 500 kbps units, OFDM: data bits per symbol / 4
+};
+
+// Indexed by rx_ctrl.rate (wifi_phy_rate_t).
+DRAM_ATTR static const LegacyRate legacyRates[32] = {
+  {PHY_DSSS_LONG, 2},  {PHY_DSSS_LONG, 4},  {PHY_DSSS_LONG, 11}, {PHY_DSSS_LONG, 22},
+  {PHY_NONE, 0},       {PHY_DSSS_SHORT, 4}, {PHY_DSSS_SHORT, 11}, {PHY_DSSS_SHORT, 22},
+  {PHY_OFDM, 48},      {PHY_OFDM, 24},      {PHY_OFDM, 12},      {PHY_OFDM, 6},
+  {PHY_OFDM, 54},      {PHY_OFDM, 36},      {PHY_OFDM, 18},      {PHY_OFDM, 9},
+};
+
+// HT data bits per symbol for one spatial stream, MCS 0-7, [20 MHz, 40 MHz].
+DRAM_ATTR static const uint16_t htBitsPerSymbol[2][8] = {
+  {26, 52, 78, 104, 156, 208, 234, 260},
+  {54, 108, 162, 216, 324, 432, 486, 540},
+};
+
+#define DSSS_LONG_PREAMBLE_US 192
+#define DSSS_SHORT_PREAMBLE_US 96
+#define OFDM_PREAMBLE_US 20
+#define HT_PREAMBLE_US 32
+#define HT_LTF_US 4
+#define SIGNAL_EXT_US 6
+#define OFDM_SERVICE_TAIL_BITS 22
+
+uint32_t IRAM_ATTR frameAirtimeUs(const wifi_pkt_rx_ctrl_t* rx, bool acked) {
+  uint32_t bits = (uint32_t)rx->sig_len * 8;
+  uint32_t us;
+  bool ofdmAck = true;
+
+  if (rx->sig_mode == 0) {
+    const LegacyRate& r = legacyRates[rx->rate & 0x1F];
+    if (r.kind == PHY_OFDM) {
+      uint32_t dbps = (uint32_t)r.param * 4;
+      uint32_t symbols = (bits + OFDM_SERVICE_TAIL_BITS + dbps - 1) / dbps;
+      us = OFDM_PREAMBLE_US + symbols * 4 + SIGNAL_EXT_US;
+    } else if (r.kind != PHY_NONE) {
+      uint32_t preamble = (r.kind == PHY_DSSS_LONG) ? DSSS_LONG_PREAMBLE_US : DSSS_SHORT_PREAMBLE_US;
+      us = preamble + (bits * 2 + r.param - 1) / r.param;
+      ofdmAck = false;
+    } else {
+      return 0;
+    }
+  } else {
+    uint8_t streams = (rx->mcs >> 3) + 1;
+    uint32_t dbps = (uint32_t)htBitsPerSymbol[rx->cwb ? 1 : 0][rx->mcs & 0x07] * streams;
+    uint32_t symbols = (bits + OFDM_SERVICE_TAIL_BITS + dbps - 1) / dbps;
+    uint32_t symbolUs = rx->sgi ? (symbols * 18 + 4) / 5 : symbols * 4;
+    us = HT_PREAMBLE_US + HT_LTF_US * streams + symbolUs + SIGNAL_EXT_US;
+  }
+
+  if (acked) us += SIFS_US + (ofdmAck ? ACK_OFDM_US : ACK_DSSS_US);
+  return us;
+}
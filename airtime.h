@@ -0,0 +1,13 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+#define SIFS_US 10
+#define ACK_DSSS_US 304
+#define ACK_OFDM_US 34
+
+uint32_t frameAirtimeUs(const wifi_pkt_rx_ctrl_t* rx, bool acked);
+
+#endif // AIRTIME_H
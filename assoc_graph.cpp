@@ -0,0 +1,300 @@
+#include "assoc_graph.h"
+#include "alerts.h"
+
+// Which station talks to which AP, from the addressing of the data and
+// (re)association requests the sniffer callbacks queue. Nodes are found through
+// an open-addressed index on the MAC. Every edge sits on both endpoints'
+// lists and on one recency list, so a frame costs a constant number of
+// steps, the stalest pair is dropped when the table is full, and ageing
+// out only looks at the stale tail.
+//
+// A station's current AP only moves on frames the station sent itself;
+// an AP still retrying to a station that has left does not count as a
+// roam back.
+
+uint32_t assocRoamCount = 0;
+
+static AssocNode nodes[ASSOC_MAX_NODES];
+static AssocEdge edges[ASSOC_MAX_EDGES];
+static uint8_t nodeIndex[ASSOC_INDEX_SIZE];  // node + 1, 0 = empty
+static uint8_t freeNode = ASSOC_NONE;        // free nodes chain through head[0]
+static uint8_t freeEdge = ASSOC_NONE;        // free edges chain through lruNext
+static uint8_t lruHead = ASSOC_NONE;
+static uint8_t lruTail = ASSOC_NONE;
+static uint32_t lastRoamLog = 0;
+static bool roamLogged = false;
+
+static uint32_t indexHome(const uint8_t* mac) {
+  uint32_t k = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | mac[4] << 8 | mac[5]) ^
+               ((uint32_t)mac[0] << 8 | mac[1]);
+  return ((k * 2654435761u) >> 16) & (ASSOC_INDEX_SIZE - 1);
+}
+
+static uint8_t findNode(const uint8_t* mac) {
+  for (uint32_t i = indexHome(mac);; i = (i + 1) & (ASSOC_INDEX_SIZE - 1)) {
+    uint8_t e = nodeIndex[i];
+    if (e == 0) return ASSOC_NONE;
+    if (memcmp(nodes[e - 1].mac, mac, 6) == 0) return e - 1;
+  }
+}
+
+static uint8_t addNode(const uint8_t* mac) {
+  uint8_t n = freeNode;
+  freeNode = nodes[n].head[0];
+
+  AssocNode& node = nodes[n];
+  memcpy(node.mac, mac, 6);
+  node.head[0] = node.head[1] = ASSOC_NONE;
+  node.count[0] = node.count[1] = 0;
+  node.current = ASSOC_NONE;
+  node.roams = 0;
+
+  uint32_t i = indexHome(mac);
+  while (nodeIndex[i] != 0) i = (i + 1) & (ASSOC_INDEX_SIZE - 1);
+  nodeIndex[i] = n + 1;
+  return n;
+}
+
+// Backward-shift deletion, as in the device table
+static void releaseNode(uint8_t n) {
+  const uint32_t mask = ASSOC_INDEX_SIZE - 1;
+  uint32_t i = indexHome(nodes[n].mac);
+  while (nodeIndex[i] != n + 1) i = (i + 1) & mask;
+
+  for (uint32_t j = (i + 1) & mask; nodeIndex[j] != 0; j = (j + 1) & mask) {
+    uint32_t home = indexHome(nodes[nodeIndex[j] - 1].mac);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      nodeIndex[i] = nodeIndex[j];
+      i = j;
+    }
+  }
+  nodeIndex[i] = 0;
+
+  nodes[n].head[0] = freeNode;
+  freeNode = n;
+}
+
+static void linkEdge(uint8_t e, uint8_t side) {
+  AssocEdge& d = edges[e];
+  AssocNode& n = nodes[d.end[side]];
+  d.prev[side] = ASSOC_NONE;
+  d.next[side] = n.head[side];
+  if (n.head[side] != ASSOC_NONE) edges[n.head[side]].prev[side] = e;
+  n.head[side] = e;
+  n.count[side]++;
+}
+
+static void unlinkEdge(uint8_t e, uint8_t side) {
+  AssocEdge& d = edges[e];
+  AssocNode& n = nodes[d.end[side]];
+  if (d.prev[side] != ASSOC_NONE) edges[d.prev[side]].next[side] = d.next[side];
+  else n.head[side] = d.next[side];
+  if (d.next[side] != ASSOC_NONE) edges[d.next[side]].prev[side] = d.prev[side];
+  n.count[side]--;
+}
+
+static void lruUnlink(uint8_t e) {
+  uint8_t p = edges[e].lruPrev, n = edges[e].lruNext;
+  if (p != ASSOC_NONE) edges[p].lruNext = n;
+  else lruHead = n;
+  if (n != ASSOC_NONE) edges[n].lruPrev = p;
+  else lruTail = p;
+}
+
+static void lruPushFront(uint8_t e) {
+  edges[e].lruPrev = ASSOC_NONE;
+  edges[e].lruNext = lruHead;
+  if (lruHead != ASSOC_NONE) edges[lruHead].lruPrev = e;
+  lruHead = e;
+  if (lruTail == ASSOC_NONE) lruTail = e;
+}
+
+static void dropEdge(uint8_t e) {
+  lruUnlink(e);
+  for (uint8_t side = 0; side < 2; side++) {
+    uint8_t n = edges[e].end[side];
+    unlinkEdge(e, side);
+    if (nodes[n].current == e) nodes[n].current = ASSOC_NONE;
+    if (nodes[n].count[0] == 0 && nodes[n].count[1] == 0) releaseNode(n);
+  }
+  edges[e].lruNext = freeEdge;
+  freeEdge = e;
+}
+
+// Walks whichever endpoint list is shorter; a station rarely has more
+// than a couple of APs.
+static uint8_t findEdge(uint8_t sta, uint8_t ap) {
+  uint8_t side = nodes[sta].count[0] <= nodes[ap].count[1] ? 0 : 1;
+  uint8_t self = side == 0 ? sta : ap;
+  uint8_t other = side == 0 ? ap : sta;
+  for (uint8_t e = nodes[self].head[side]; e != ASSOC_NONE; e = edges[e].next[side]) {
+    if (edges[e].end[1 - side] == other) return e;
+  }
+  return ASSOC_NONE;
+}
+
+static void logRoam(uint8_t sta, uint8_t from, uint8_t to) {
+  const uint8_t* s = nodes[sta].mac;
+  const uint8_t* a = nodes[edges[from].end[1]].mac;
+  const uint8_t* b = nodes[edges[to].end[1]].mac;
+  assocRoamCount++;
+  if (nodes[sta].roams < 0xFF) nodes[sta].roams++;
+
+  Serial.printf("[ROAM] %02X:%02X:%02X:%02X:%02X:%02X %02X:%02X:%02X:%02X:%02X:%02X -> "
+                "%02X:%02X:%02X:%02X:%02X:%02X\n",
+                s[0], s[1], s[2], s[3], s[4], s[5], a[0], a[1], a[2], a[3], a[4], a[5],
+                b[0], b[1], b[2], b[3], b[4], b[5]);
+
+  uint32_t now = millis();
+  if (roamLogged && now - lastRoamLog < ASSOC_ROAM_LOG_MS) return;
+  char msg[40];
+  snprintf(msg, 40, "Roam %02X%02X%02X %02X%02X%02X>%02X%02X%02X", s[3], s[4], s[5], a[3], a[4],
+           a[5], b[3], b[4], b[5]);
+  logEvent(4, msg);
+  lastRoamLog = now;
+  roamLogged = true;
+}
+
+static void observeLink(const uint8_t* staMac, const uint8_t* apMac, int8_t rssi, bool uplink) {
+  uint8_t s = findNode(staMac);
+  uint8_t a = findNode(apMac);
+  uint8_t e = (s != ASSOC_NONE && a != ASSOC_NONE) ? findEdge(s, a) : ASSOC_NONE;
+
+  if (e == ASSOC_NONE) {
+    if (freeEdge == ASSOC_NONE) {
+      // Dropping the stalest pair can release either endpoint
+      dropEdge(lruTail);
+      s = findNode(staMac);
+      a = findNode(apMac);
+    }
+    if (s == ASSOC_NONE) s = addNode(staMac);
+    if (a == ASSOC_NONE) a = addNode(apMac);
+
+    e = freeEdge;
+    freeEdge = edges[e].lruNext;
+    AssocEdge& d = edges[e];
+    d.end[0] = s;
+    d.end[1] = a;
+    d.frames = 0;
+    d.rssi = 0;
+    linkEdge(e, 0);
+    linkEdge(e, 1);
+  } else {
+    lruUnlink(e);
+  }
+  lruPushFront(e);
+
+  AssocEdge& d = edges[e];
+  d.lastSeen = millis();
+  if (d.frames < 0xFFFF) d.frames++;
+  if (uplink) d.rssi = rssi;
+
+  AssocNode& st = nodes[s];
+  if (st.current == e || (!uplink && st.current != ASSOC_NONE)) return;
+  if (st.current != ASSOC_NONE) logRoam(s, st.current, e);
+  st.current = e;
+}
+
+void clearAssociations() {
+  memset(nodeIndex, 0, sizeof(nodeIndex));
+  for (uint8_t n = 0; n < ASSOC_MAX_NODES; n++) {
+    nodes[n].head[0] = (n + 1 < ASSOC_MAX_NODES) ? n + 1 : ASSOC_NONE;
+  }
+  for (uint8_t e = 0; e < ASSOC_MAX_EDGES; e++) {
+    edges[e].lruNext = (e + 1 < ASSOC_MAX_EDGES) ? e + 1 : ASSOC_NONE;
+  }
+  freeNode = 0;
+  freeEdge = 0;
+  lruHead = lruTail = ASSOC_NONE;
+  assocRoamCount = 0;
+  roamLogged = false;
+}
+
+// Station and BSSID by the DS bits: to the AP, addr1 is the BSSID; from
+// it, addr2. (Re)association requests carry the BSSID in addr3.
+void assocObserve(const IngestFrame& f) {
+  if (f.len < 22) return;
+  const uint8_t* h = f.payload;
+  uint8_t frameType = (h[0] >> 2) & 0x03;
+  uint8_t frameSubtype = (h[0] >> 4) & 0x0F;
+  const uint8_t* sta;
+  const uint8_t* bssid;
+  bool uplink;
+
+  if (frameType == 0 && (frameSubtype == 0 || frameSubtype == 2)) {
+    sta = &h[10];
+    bssid = &h[16];
+    uplink = true;
+  } else if (frameType == 2 && (h[1] & 0x03) == 1) {
+    sta = &h[10];
+    bssid = &h[4];
+    uplink = true;
+  } else if (frameType == 2 && (h[1] & 0x03) == 2) {
+    sta = &h[4];
+    bssid = &h[10];
+    uplink = false;
+  } else {
+    return;
+  }
+
+  if ((sta[0] | bssid[0]) & 0x01) return;  // group addresses
+  if (memcmp(sta, bssid, 6) == 0) return;
+  observeLink(sta, bssid, f.rssi, uplink);
+}
+
+void updateAssociations() {
+  uint32_t now = millis();
+  while (lruTail != ASSOC_NONE && now - edges[lruTail].lastSeen > ASSOC_EDGE_TIMEOUT_MS) {
+    dropEdge(lruTail);
+  }
+}
+
+static void fillLink(uint8_t e, AssocLink& out) {
+  const AssocEdge& d = edges[e];
+  memcpy(out.sta, nodes[d.end[0]].mac, 6);
+  memcpy(out.bssid, nodes[d.end[1]].mac, 6);
+  out.lastSeen = d.lastSeen;
+  out.frames = d.frames;
+  out.rssi = d.rssi;
+}
+
+uint8_t assocClientCount(const uint8_t* bssid) {
+  uint8_t n = findNode(bssid);
+  return n == ASSOC_NONE ? 0 : nodes[n].count[1];
+}
+
+// Strongest first; a client only heard from the AP side (rssi 0) sorts last.
+uint8_t assocClients(const uint8_t* bssid, AssocLink* out, uint8_t max) {
+  uint8_t n = findNode(bssid);
+  if (n == ASSOC_NONE) return 0;
+
+  uint8_t count = 0;
+  for (uint8_t e = nodes[n].head[1]; e != ASSOC_NONE; e = edges[e].next[1]) {
+    int8_t key = edges[e].rssi ? edges[e].rssi : -128;
+    uint8_t pos = count;
+    while (pos > 0 && (out[pos - 1].rssi ? out[pos - 1].rssi : -128) < key) pos--;
+    if (pos >= max) continue;
+    uint8_t last = count < max ? count : max - 1;
+    for (uint8_t i = last; i > pos; i--) out[i] = out[i - 1];
+    fillLink(e, out[pos]);
+    if (count < max) count++;
+  }
+  return count;
+}
+
+// Most recently seen first
+uint8_t assocLinks(AssocLink* out, uint8_t max) {
+  uint8_t count = 0;
+  for (uint8_t e = lruHead; e != ASSOC_NONE && count < max; e = edges[e].lruNext) {
+    fillLink(e, out[count++]);
+  }
+  return count;
+}
+
+bool assocStationAp(const uint8_t* sta, uint8_t* bssid, uint8_t* roams) {
+  uint8_t n = findNode(sta);
+  if (n == ASSOC_NONE || nodes[n].current == ASSOC_NONE) return false;
+  memcpy(bssid, nodes[edges[nodes[n].current].end[1]].mac, 6);
+  *roams = nodes[n].roams;
+  return true;
+}
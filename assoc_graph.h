@@ -0,0 +1,17 @@
+#ifndef ASSOC_GRAPH_H
+#define ASSOC_GRAPH_H
+
+#include "config.h"
+
+extern uint32_t assocRoamCount;
+
+void clearAssociations();
+void assocObserve(const IngestFrame& f);
+void updateAssociations();
+
+uint8_t assocClientCount(const uint8_t* bssid);
+uint8_t assocClients(const uint8_t* bssid, AssocLink* out, uint8_t max);
+uint8_t assocLinks(AssocLink* out, uint8_t max);
+bool assocStationAp(const uint8_t* sta, uint8_t* bssid, uint8_t* roams);
+
+#endif // ASSOC_GRAPH_H
@@ -0,0 +1,216 @@
+#include "beacon_loss.h"
+
+// Beacon loss per AP. Every AP a scan returns is registered with its
+// channel. While the sniffer dwells on a channel, the callback counts the
+// beacons of the registered APs there; when the dwell ends, the loop
+// credits each of them with dwell time / beacon interval expected beacons.
+// Loss is 1 - heard / expected over about the last BEACON_LOSS_WINDOW
+// expected beacons, so it says how well the AP is heard here and lately,
+// which one RSSI sample from a scan cannot.
+//
+// The first beacon of each dwell is also walked for the BSS Load and HT
+// Operation elements, in place in the received buffer, so the AP's own
+// view of its channel utilization and its channel width are at hand.
+//
+// Only the loop changes the table. The callback skips beacons while it is
+// being rewritten, and the counts of a dwell are read after the callback
+// has stopped crediting that channel.
+
+static BeaconTrack tracks[BEACON_TRACK_MAX];
+static uint8_t trackCount = 0;
+static uint8_t trackIndex[BEACON_INDEX_SIZE];  // track + 1, 0 = empty
+static volatile uint8_t listenChannel = 0;
+static volatile bool rewriting = false;
+
+static uint32_t IRAM_ATTR indexHome(const uint8_t* mac) {
+  uint32_t k = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | mac[4] << 8 | mac[5];
+  return ((k * 2654435761u) >> 16) & (BEACON_INDEX_SIZE - 1);
+}
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static int IRAM_ATTR findTrack(const uint8_t* bssid) {
+  for (uint32_t i = indexHome(bssid);; i = (i + 1) & (BEACON_INDEX_SIZE - 1)) {
+    uint8_t e = trackIndex[i];
+    if (e == 0) return -1;
+    if (sameMac(tracks[e - 1].bssid, bssid)) return e - 1;
+  }
+}
+
+static void rebuildIndex() {
+  memset(trackIndex, 0, sizeof(trackIndex));
+  for (uint8_t t = 0; t < trackCount; t++) {
+    uint32_t i = indexHome(tracks[t].bssid);
+    while (trackIndex[i] != 0) i = (i + 1) & (BEACON_INDEX_SIZE - 1);
+    trackIndex[i] = t + 1;
+  }
+}
+
+static void resetCounts(BeaconTrack& b) {
+  b.dwellLoss = -1;
+  b.dwellHeard = 0;
+  b.heard = 0;
+  b.expected = 0;
+  b.ies = 0;
+  b.secondary = 0;
+}
+
+static int8_t lossPct(float heard, float expected) {
+  if (heard >= expected) return 0;
+  return (int8_t)(100.0f * (expected - heard) / expected + 0.5f);
+}
+
+// A new AP takes a free entry, or the one longest missing from scans.
+void beaconLossTrack(const wifi_ap_record_t& ap) {
+  if (ap.primary == 0 || ap.primary > MAX_CHANNEL) return;
+  uint32_t now = millis();
+
+  int t = findTrack(ap.bssid);
+  if (t >= 0) {
+    BeaconTrack& b = tracks[t];
+    b.lastListed = now;
+    if (b.channel != ap.primary) {
+      b.channel = ap.primary;
+      resetCounts(b);
+    }
+    return;
+  }
+
+  rewriting = true;
+  __sync_synchronize();
+  if (trackCount < BEACON_TRACK_MAX) {
+    t = trackCount++;
+  } else {
+    t = 0;
+    for (uint8_t i = 1; i < BEACON_TRACK_MAX; i++) {
+      if (now - tracks[i].lastListed > now - tracks[t].lastListed) t = i;
+    }
+  }
+  BeaconTrack& b = tracks[t];
+  memcpy(b.bssid, ap.bssid, 6);
+  b.channel = ap.primary;
+  b.intervalTu = BEACON_DEFAULT_TU;
+  b.lastListed = now;
+  resetCounts(b);
+  rebuildIndex();
+  __sync_synchronize();
+  rewriting = false;
+}
+
+static void IRAM_ATTR parseIes(BeaconTrack& b, const uint8_t* ie, const uint8_t* end) {
+  while (ie + 2 <= end) {
+    uint8_t id = ie[0];
+    uint8_t len = ie[1];
+    const uint8_t* body = ie + 2;
+    if (body + len > end) break;
+
+    if (id == 11 && len >= 5) {  // BSS Load
+      b.stations = body[0] | (body[1] << 8);
+      b.utilization = body[2];
+      b.ies |= BEACON_IE_LOAD;
+    } else if (id == 61 && len >= 2 && body[0] == b.channel) {  // HT Operation
+      uint8_t offset = body[1] & 0x03;
+      bool wide = body[1] & 0x04;
+      b.secondary = !wide ? 0 : offset == 1 ? 1 : offset == 3 ? -1 : 0;
+      b.ies |= BEACON_IE_HT;
+    }
+    ie = body + len;
+  }
+}
+
+void IRAM_ATTR beaconLossObserve(const wifi_promiscuous_pkt_t* p) {
+  uint8_t ch = listenChannel;
+  if (rewriting || ch == 0 || p->rx_ctrl.channel != ch) return;
+  if (p->rx_ctrl.sig_len < 36) return;
+
+  // An AP on a neighbouring channel can be heard here too; only its own counts
+  int t = findTrack(&p->payload[16]);
+  if (t < 0 || tracks[t].channel != ch) return;
+
+  BeaconTrack& b = tracks[t];
+  b.dwellHeard++;
+  uint16_t tu = p->payload[32] | (p->payload[33] << 8);
+  if (tu >= 10 && tu <= 1000) b.intervalTu = tu;
+  if (b.dwellHeard == 1) parseIes(b, &p->payload[36], p->payload + p->rx_ctrl.sig_len);
+}
+
+void beaconLossBeginDwell(uint8_t ch) {
+  listenChannel = ch;
+}
+
+void beaconLossEndDwell(uint8_t ch, uint32_t elapsedMs) {
+  listenChannel = 0;
+  __sync_synchronize();
+
+  for (uint8_t t = 0; t < trackCount; t++) {
+    BeaconTrack& b = tracks[t];
+    if (b.channel != ch) continue;
+
+    uint16_t heard = b.dwellHeard;
+    b.dwellHeard = 0;
+    float expected = elapsedMs / (b.intervalTu * 1.024f);
+    if (expected >= BEACON_DWELL_MIN_EXPECTED) b.dwellLoss = lossPct(heard, expected);
+
+    b.heard += heard;
+    b.expected += expected;
+    if (b.expected > BEACON_LOSS_WINDOW) {
+      b.heard /= 2;
+      b.expected /= 2;
+    }
+  }
+}
+
+// -1 until the AP's channel has been listened to long enough
+int8_t beaconLossPct(const uint8_t* bssid) {
+  int t = findTrack(bssid);
+  if (t < 0 || tracks[t].expected < BEACON_LOSS_MIN_EXPECTED) return -1;
+  return lossPct(tracks[t].heard, tracks[t].expected);
+}
+
+int8_t beaconDwellLoss(const uint8_t* bssid) {
+  int t = findTrack(bssid);
+  return t < 0 ? -1 : tracks[t].dwellLoss;
+}
+
+// Channel the last scan that returned the AP put it on, 0 if none has
+uint8_t beaconListedChannel(const uint8_t* bssid, uint32_t* listedMs) {
+  int t = findTrack(bssid);
+  if (t < 0) return 0;
+  if (listedMs) *listedMs = tracks[t].lastListed;
+  return tracks[t].channel;
+}
+
+// Utilization in percent and station count from the AP's BSS Load element
+bool beaconBssLoad(const uint8_t* bssid, uint8_t* utilPct, uint16_t* stations) {
+  int t = findTrack(bssid);
+  if (t < 0 || !(tracks[t].ies & BEACON_IE_LOAD)) return false;
+  if (utilPct) *utilPct = (tracks[t].utilization * 100 + 127) / 255;
+  if (stations) *stations = tracks[t].stations;
+  return true;
+}
+
+// Busiest channel utilization any AP with ch as its primary reports, -1 if none does
+int8_t beaconReportedLoad(uint8_t ch) {
+  int16_t worst = -1;
+  for (uint8_t t = 0; t < trackCount; t++) {
+    if (tracks[t].channel != ch || !(tracks[t].ies & BEACON_IE_LOAD)) continue;
+    if (tracks[t].utilization > worst) worst = tracks[t].utilization;
+  }
+  return worst < 0 ? -1 : (worst * 100 + 127) / 255;
+}
+
+// What the AP's beacon said, else what the scan record carried
+int8_t apSecondaryOffset(const wifi_ap_record_t& ap) {
+  int t = findTrack(ap.bssid);
+  if (t >= 0 && tracks[t].channel == ap.primary && (tracks[t].ies & BEACON_IE_HT)) {
+    return tracks[t].secondary;
+  }
+  if (ap.second == WIFI_SECOND_CHAN_ABOVE) return 1;
+  if (ap.second == WIFI_SECOND_CHAN_BELOW) return -1;
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef BEACON_LOSS_H
+#define BEACON_LOSS_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+void beaconLossTrack(const wifi_ap_record_t& ap);
+void IRAM_ATTR beaconLossObserve(const wifi_promiscuous_pkt_t* p);
+void beaconLossBeginDwell(uint8_t ch);
+void beaconLossEndDwell(uint8_t ch, uint32_t elapsedMs);
+
+int8_t beaconLossPct(const uint8_t* bssid);
+int8_t beaconDwellLoss(const uint8_t* bssid);
+uint8_t beaconListedChannel(const uint8_t* bssid, uint32_t* listedMs);
+bool beaconBssLoad(const uint8_t* bssid, uint8_t* utilPct, uint16_t* stations);
+int8_t beaconReportedLoad(uint8_t ch);
+int8_t apSecondaryOffset(const wifi_ap_record_t& ap);
+
+#endif // BEACON_LOSS_H
@@ -1,5 +1,7 @@
 #include "ble_scanner.h"
 #include "wifi_scanner.h"
+#include "profiler.h"
+#include "cardinality.h"
 
 BLEDeviceInfo bleDevices[MAX_BLE_DEVICES];
 uint8_t bleDeviceCount = 0;
@@ -16,6 +18,7 @@ BLEScan* pBLEScan = nullptr;
 void MyAdvertisedDeviceCallbacks::onResult(BLEAdvertisedDevice advertisedDevice) {
   String addr = advertisedDevice.getAddress().toString().c_str();
   bool found = false;
+  cardinalityObserveBLE(addr.c_str(), addr.length());
 
   for (int i = 0; i < bleDeviceCount; i++) {
     if (bleDevices[i].address == addr) {
@@ -72,6 +75,7 @@ void initBLE() {
 }
 
 void startBLEScan() {
+  PhaseScope radio(PH_RADIO);
   if (bleInitialized && !bleScanning) {
     bleScanning = true;
     bleScanStart = millis();
@@ -80,6 +84,7 @@ void startBLEScan() {
 }
 
 void stopBLEScan() {
+  PhaseScope radio(PH_RADIO);
   if (bleScanning && pBLEScan != nullptr) {
     pBLEScan->stop();
     pBLEScan->clearResults();
@@ -93,6 +98,7 @@ void updateBLEScan() {
   }
 
   if (millis() - lastBLEScan > 1000) {
+    PhaseScope radio(PH_RADIO);
     pBLEScan->start(1, false);
     lastBLEScan = millis();
   }
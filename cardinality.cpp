@@ -0,0 +1,108 @@
+#include "cardinality.h"
+#include "hll.h"
+
+// How many devices are around, without tracking any of them. Every
+// transmitter address the promiscuous callbacks see, and every BSSID an
+// AP scan returns, goes into a HyperLogLog for its channel; every BLE
+// advertiser address goes into one more. Each minute the loop merges the channel sketches (the union of
+// HyperLogLogs is the register-wise max), files the result into a ring of
+// one-minute sketches and the current ten-minute block, and clears the
+// live ones. Counts for 1 min, 10 min and 1 hour are estimates of those
+// merges, so they stay at ~9% error however dense the air is.
+//
+// The live sketches are cleared while the callback may be writing them.
+// A frame racing the clear can be lost from the new minute; that is one
+// address, and the estimate is approximate anyway.
+
+static CardinalityHistory wifiCardinality;
+static CardinalityHistory bleCardinality;
+uint16_t chDevices[MAX_CHANNEL + 1];
+
+static uint8_t channelHll[MAX_CHANNEL + 1][CARD_HLL_REGS];
+static uint8_t bleHll[CARD_HLL_REGS];
+static uint32_t minuteStart = 0;
+static uint32_t lastRefresh = 0;
+
+static const char* windowNames[CARD_WINDOWS] = {"1m", "10m", "1h"};
+
+void IRAM_ATTR cardinalityObserveWiFi(const wifi_promiscuous_pkt_t* p, wifi_promiscuous_pkt_type_t type) {
+  // Control frames mostly carry no transmitter address (ACK, CTS)
+  if (type == WIFI_PKT_CTRL || p->rx_ctrl.sig_len < 16) return;
+  uint8_t ch = p->rx_ctrl.channel;
+  if (ch == 0 || ch > MAX_CHANNEL) return;
+  hllAdd(channelHll[ch], CARD_HLL_BITS, sketchHash(&p->payload[10], 6, 0));
+}
+
+void cardinalityObserveAP(const wifi_ap_record_t& ap) {
+  if (ap.primary == 0 || ap.primary > MAX_CHANNEL) return;
+  hllAdd(channelHll[ap.primary], CARD_HLL_BITS, sketchHash(ap.bssid, 6, 0));
+}
+
+void cardinalityObserveBLE(const char* addr, uint8_t len) {
+  hllAdd(bleHll, CARD_HLL_BITS, sketchHash((const uint8_t*)addr, len, 0));
+}
+
+static void estimateHistory(CardinalityHistory& h, const uint8_t* live) {
+  uint8_t merged[CARD_HLL_REGS];
+
+  // Until the first minute completes, the live sketch stands in for it
+  const uint8_t* last = h.minutesDone ? h.minute[(h.minuteIdx + CARD_MINUTES - 1) % CARD_MINUTES] : live;
+  h.estimate[CARD_1MIN] = hllEstimate(last, CARD_HLL_REGS);
+
+  memcpy(merged, live, CARD_HLL_REGS);
+  for (uint8_t i = 0; i < CARD_MINUTES; i++) hllMerge(merged, h.minute[i], CARD_HLL_REGS);
+  h.estimate[CARD_10MIN] = hllEstimate(merged, CARD_HLL_REGS);
+
+  memcpy(merged, live, CARD_HLL_REGS);
+  for (uint8_t i = 0; i < CARD_BLOCKS; i++) hllMerge(merged, h.block[i], CARD_HLL_REGS);
+  h.estimate[CARD_1HOUR] = hllEstimate(merged, CARD_HLL_REGS);
+}
+
+static void closeMinute(CardinalityHistory& h, const uint8_t* live) {
+  if (h.minutesDone % CARD_MINUTES == 0) {
+    if (h.minutesDone) h.blockIdx = (h.blockIdx + 1) % CARD_BLOCKS;
+    memset(h.block[h.blockIdx], 0, CARD_HLL_REGS);
+  }
+  memcpy(h.minute[h.minuteIdx], live, CARD_HLL_REGS);
+  hllMerge(h.block[h.blockIdx], live, CARD_HLL_REGS);
+  h.minuteIdx = (h.minuteIdx + 1) % CARD_MINUTES;
+  h.minutesDone++;
+}
+
+void updateCardinality() {
+  uint32_t now = millis();
+  bool rollover = now - minuteStart >= CARD_MINUTE_MS;
+  if (!rollover && now - lastRefresh < CARD_REFRESH_MS) return;
+  lastRefresh = now;
+
+  uint8_t live[CARD_HLL_REGS];
+  memset(live, 0, sizeof(live));
+  for (uint8_t ch = 1; ch <= MAX_CHANNEL; ch++) {
+    hllMerge(live, channelHll[ch], CARD_HLL_REGS);
+    // Per channel is the live minute until the first one completes
+    if (rollover || !wifiCardinality.minutesDone) chDevices[ch] = hllEstimate(channelHll[ch], CARD_HLL_REGS);
+  }
+
+  if (rollover) {
+    minuteStart = now;
+    closeMinute(wifiCardinality, live);
+    closeMinute(bleCardinality, bleHll);
+    memset(channelHll, 0, sizeof(channelHll));
+    memset(bleHll, 0, sizeof(bleHll));
+    memset(live, 0, sizeof(live));
+  }
+  estimateHistory(wifiCardinality, live);
+  estimateHistory(bleCardinality, bleHll);
+}
+
+uint16_t wifiDevicesSeen(CardWindow w) {
+  return wifiCardinality.estimate[w];
+}
+
+uint16_t bleDevicesSeen(CardWindow w) {
+  return bleCardinality.estimate[w];
+}
+
+const char* cardWindowName(CardWindow w) {
+  return windowNames[w];
+}
@@ -0,0 +1,18 @@
+#ifndef CARDINALITY_H
+#define CARDINALITY_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+extern uint16_t chDevices[MAX_CHANNEL + 1];
+
+void IRAM_ATTR cardinalityObserveWiFi(const wifi_promiscuous_pkt_t* p, wifi_promiscuous_pkt_type_t type);
+void cardinalityObserveAP(const wifi_ap_record_t& ap);
+void cardinalityObserveBLE(const char* addr, uint8_t len);
+void updateCardinality();
+
+uint16_t wifiDevicesSeen(CardWindow w);
+uint16_t bleDevicesSeen(CardWindow w);
+const char* cardWindowName(CardWindow w);
+
+#endif // CARDINALITY_H
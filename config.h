@@ -14,6 +14,8 @@
 #define RGB_LED_PIN 10
 #define RGB_LED_COUNT 1
 #define RGB_ENABLED true
+#define SNIFFER_STATS_ENABLED true
+#define PROFILER_ENABLED true
 
 #define RGB_OFF     rgb.Color(0, 0, 0)
 #define RGB_GREEN   rgb.Color(0, 50, 0)
@@ -32,13 +34,19 @@
 
 enum ButtonEvent { BTN_NONE, BTN_SHORT, BTN_LONG, BTN_BACK, BTN_BACK_LONG };
 
+enum LoopPhase { PH_BUTTONS, PH_HANDLER, PH_RADIO, PH_DRAW, PH_FLUSH, PH_DELAY, PH_COUNT };
+
 #define MAX_CHANNEL 13
 #define HISTORY_SIZE 128
+#define DWELL_MIN_MS 5
+#define CYCLE_HIST_BUCKETS 16
+#define LAT_HIST_BUCKETS 14
 #define MAX_APS 20
 #define AP_VISIBLE 3
 #define MAX_HIDDEN_SSIDS 10
 #define MAX_SSID_LEN 32
 #define MAX_ROGUE_APS 5
+#define MAX_TRUSTED_APS 64
 
 #define MAX_BLE_DEVICES 20
 #define BLE_VISIBLE 3
@@ -48,7 +56,105 @@ enum ButtonEvent { BTN_NONE, BTN_SHORT, BTN_LONG, BTN_BACK, BTN_BACK_LONG };
 #define RSSI_HISTORY_SIZE 50
 #define MAX_TRACKED_APS 3
 
-#define MAX_MONITORED_DEVICES 15
+#define DEVICE_TABLE_MIN 32
+#define DEVICE_TABLE_MAX 1024
+#define DEVICE_TABLE_HEAP_SHARE 8
+
+#define INGEST_RING_SIZE 64  // power of two
+#define INGEST_SNAP_LEN 192
+#define CSV_LOG_LIMIT 1000
+
+#define DEAUTH_BUCKET_MS 50
+#define DEAUTH_BUCKETS 20  // 1 s of history
+#define DEAUTH_MAX_SOURCES 8
+#define DEAUTH_COOLDOWN_MS 3000
+#define DEAUTH_REASON_BINS 24  // codes 0-22, last bin takes the rest
+#define DEAUTH_MIN_FRAMES 3     // a window with fewer frames never raises
+#define DEAUTH_GENUINE_FACTOR 4 // an AP's own deauths raise at this times the threshold
+
+#define FLOOD_WINDOW_MS 1000
+#define FLOOD_MIN_WINDOW_MS 200   // two beacon intervals; shorter dwells are skipped
+#define FLOOD_MAX_WINDOW_MS 1250  // longer ones had the loop blocked (AP or BLE scan), not learned
+#define FLOOD_CMS_DEPTH 4
+#define FLOOD_CMS_WIDTH 256  // one byte of the BSSID hash per row
+#define FLOOD_HLL_BITS 6
+#define FLOOD_HLL_REGS (1 << FLOOD_HLL_BITS)
+#define FLOOD_MIN_BEACONS 5       // quieter windows (radio busy scanning) are skipped
+#define FLOOD_LEARN_WINDOWS 5     // per channel
+#define FLOOD_FACTOR 3
+#define FLOOD_MIN_DISTINCT 40     // floor under FLOOD_FACTOR * baseline
+#define FLOOD_BEACON_RATE_MAX 100 // per second from one BSSID
+#define FLOOD_COOLDOWN_WINDOWS 3  // quiet windows on the flooded channel
+#define FLOOD_HOLD_MS 20000       // or this long without a flooded window
+
+#define CARD_HLL_BITS 7           // 128 registers, ~9% standard error
+#define CARD_HLL_REGS (1 << CARD_HLL_BITS)
+#define CARD_MINUTE_MS 60000
+#define CARD_MINUTES 10           // one-minute sketches, merged for 10 min
+#define CARD_BLOCKS 6             // ten-minute sketches, merged for 1 hour
+#define CARD_REFRESH_MS 5000
+
+#define TALKER_K 16
+#define TALKER_INDEX_SIZE 32      // open-addressed, at most half full
+#define TALKER_ROWS 5
+#define ASSOC_MAX_EDGES 96
+#define ASSOC_MAX_NODES (2 * ASSOC_MAX_EDGES)  // every live node has an edge
+#define ASSOC_INDEX_SIZE 512                   // power of two, at most 3/8 full
+#define ASSOC_NONE 0xFF
+#define ASSOC_EDGE_TIMEOUT_MS 300000
+#define ASSOC_ROAM_LOG_MS 10000  // event log gets at most one roam per interval
+#define ASSOC_ROWS 5
+#define BEACON_TRACK_MAX 32          // APs whose beacons are counted, >= MAX_APS
+#define BEACON_INDEX_SIZE 64         // power of two, at most half full
+#define BEACON_DEFAULT_TU 100        // 102.4 ms until a beacon says otherwise
+#define BEACON_LOSS_MIN_EXPECTED 10  // fewer expected beacons give no loss figure
+#define BEACON_DWELL_MIN_EXPECTED 5  // same for a single dwell (walk test)
+#define BEACON_LOSS_WINDOW 300       // expected beacons kept before both counts halve
+#define BEACON_IE_LOAD 0x01          // BeaconTrack.ies: BSS Load element seen
+#define BEACON_IE_HT 0x02            // HT Operation element seen
+#define RETRY_TABLE_BITS 7           // 128 transmitters keep their last sequence number
+#define RETRY_MIN_FRAMES 20          // fewer sequenced frames give no retry rate
+#define SEQ_SET_BITS 7               // 128 sets...
+#define SEQ_WAYS 2                   // ...of 2 BSSID sequence streams
+#define SEQ_GAP_BASE 32              // frames an AP may send between two beacons we hear...
+#define SEQ_MS_PER_FRAME 4           // ...plus one per this many ms in between
+#define SEQ_GAP_MAX 2048             // beyond this any number is possible: re-anchor
+#define SEQ_STALE_MS ((SEQ_GAP_MAX - SEQ_GAP_BASE) * SEQ_MS_PER_FRAME)
+#define SEQ_BACKWARD 16              // frames queued before a beacon may go out after it
+#define SEQ_ESTABLISHED 4            // in-stream beacons before frames are judged
+#define SEQ_CLONE_MIN 3              // out-of-stream beacons that mark a BSSID cloned
+#define SEQ_CLONE_HOLD_MS 60000      // ...when no more than this apart
+#define TSF_SET_BITS 6               // 64 sets...
+#define TSF_WAYS 2                   // ...of 2 BSSID beacon clocks
+#define TSF_TOLERANCE_US 256         // a beacon this close to the predicted TSF is on the clock...
+#define TSF_SLACK_PPM 20             // ...give or take this rate error once the clock is established
+#define TSF_DRIFT_MAX_PPM 100        // crystals are +-20 ppm each, so more is another clock
+#define TSF_DRIFT_BASE_MS 1000       // shortest baseline drift is measured over
+#define TSF_REBASE_MS 600000         // baselines and clocks unheard for this long restart
+#define TSF_ESTABLISHED 4            // beacons on the clock before it is judged
+#define TSF_ADOPT_BEACONS 10         // a second clock heard this often in a row replaces the first (AP restart)
+#define TSF_CLONE_SWITCHES 4         // alternations between two clocks that mark a clone...
+#define TSF_JITTER_MAX_US 50         // ...or this mean deviation from the one clock
+#define TSF_CLONE_HOLD_MS 60000      // ...seen no longer ago than this
+#define KARMA_SET_BITS 3             // 8 sets...
+#define KARMA_WAYS 4                 // ...of 4 probe responders
+#define KARMA_SSIDS 8                // distinct SSID hashes kept per responder
+#define KARMA_SSID_LIMIT 4           // one BSSID answering for this many SSIDs...
+#define KARMA_KEEP 2                 // a responder with this many keeps its slot against newcomers
+#define KARMA_WINDOW_MS 60000        // ...within this long is a Karma AP
+#define KARMA_HOLD_MS 60000          // alert clears this long after the last one was seen
+#define CSA_TRACKS 8                 // channel switch announcements followed at once
+#define CSA_WATCH_MS 10000           // an announcement is followed this long after last heard
+#define CSA_PLAIN_BEACONS 3          // the AP's own beacons without it that contradict it
+#define CSA_GRACE_MS 2000            // after the announced switch time, the AP should be gone
+#define CSA_HOLD_MS 60000            // alert clears this long after the last suspect one
+#define EAPOL_SET_BITS 4             // 16 sets...
+#define EAPOL_WAYS 2                 // ...of 2 client/AP pairs
+#define EAPOL_WINDOW_MS 60000        // handshakes of a pair are counted over this long
+#define EAPOL_ATTEMPT_MS 3000        // a handshake not finished this long after its last message failed
+#define EAPOL_FAIL_LIMIT 3           // failed handshakes in a window that make a storm...
+#define EAPOL_REPEAT_LIMIT 6         // ...or handshakes started at all
+#define EAPOL_HOLD_MS 60000          // alert clears this long after the last storm was seen
 #define DEVICE_TIMEOUT_MS 30000
 
 struct Settings {
@@ -60,6 +166,7 @@ struct Settings {
   uint8_t deauthThreshold;
   uint16_t screenTimeout;
   uint8_t powerMode;
+  uint16_t deauthWindowMs;
 };
 
 struct HiddenSSID {
@@ -69,11 +176,24 @@ struct HiddenSSID {
   bool active;
 };
 
+enum RogueReason : uint8_t { ROGUE_UNTRUSTED, ROGUE_DOWNGRADE, ROGUE_CHANNEL, ROGUE_CLONE, ROGUE_CLOCK };
+
 struct RogueAP {
   char ssid[MAX_SSID_LEN + 1];
-  uint8_t bssid1[6];
-  uint8_t bssid2[6];
-  bool active;
+  uint8_t bssid[6];
+  uint8_t reason;
+  uint8_t channel;
+  uint8_t authmode;
+  uint32_t lastSeen;
+  bool active;  // seen in the latest scan
+};
+
+// Stored as a blob in NVS, sorted by (ssidHash, bssid)
+struct TrustedAP {
+  uint32_t ssidHash;
+  uint8_t bssid[6];
+  uint8_t authmode;
+  uint8_t channel;
 };
 
 struct BLEDeviceInfo {
@@ -107,18 +227,302 @@ struct Baseline {
   bool saved;
 };
 
+// Per-device fields read by the screens; the ones updated on every frame
+// (key, lastSeen, rssi, seenCount) live in device_monitor's SoA arrays.
 struct MonitoredDevice {
+  char name[33];
   uint8_t type;
+  uint8_t channel;
+  bool isPresent;
+  uint32_t firstSeen;
+};
+
+struct DeviceTableStats {
+  uint32_t lookups;
+  uint32_t inserts;
+  uint32_t evictions;
+  uint16_t maxProbe;
+};
+
+struct HopProfile {
+  uint16_t minDwellMs;
+  uint16_t baseDwellMs;
+  uint16_t maxDwellMs;
+  uint16_t maxRevisitMs;
+  uint8_t firstCh;
+  uint8_t lastCh;
+};
+
+struct ChannelCoverage {
+  uint32_t dwellMs;
+  uint32_t visits;
+  uint32_t lastVisit;
+  uint32_t maxGapMs;
+};
+
+struct SnifferStats {
+  uint32_t frames;
+  uint32_t discarded;
+  uint32_t rxErrors;
+  uint32_t ringDrops;
+  uint32_t maxCycles;
+  uint32_t cycleHist[CYCLE_HIST_BUCKETS];
+  uint32_t fps;
+  uint32_t peakFps;
+  uint32_t lastFrames;
+};
+
+// Deauth/disassoc counts in DEAUTH_BUCKET_MS buckets, indexed by absolute
+// bucket number modulo DEAUTH_BUCKETS.
+struct DeauthWindow {
+  uint16_t buckets[DEAUTH_BUCKETS];
+  uint16_t genuine[DEAUTH_BUCKETS];  // frames in their BSSID's sequence stream
+  uint32_t calmSince;
+  bool active;
+};
+
+// One channel's count for one bucket, as the sniffer callback writes it;
+// stamped with its absolute bucket number so nothing has to clear it
+struct DeauthTally {
+  volatile uint32_t bucket;
+  volatile uint16_t count;
+  volatile uint16_t genuine;
+};
+
+struct DeauthSource {
+  uint8_t mac[6];
   uint8_t bssid[6];
-  char bleAddr[18];
-  char name[33];
+  uint8_t target[6];
+  uint8_t channel;
+  bool used;
+  uint32_t frames;
+  uint32_t spoofed;  // sent as a BSSID, out of its sequence stream
+  uint32_t genuine;  // sent as a BSSID, in its stream; not counted as attack
+  uint32_t lastSeen;
+  uint32_t disassoc;  // of frames, the disassociations
+  uint16_t reasons[DEAUTH_REASON_BINS];
+  uint16_t disassocReasons[DEAUTH_REASON_BINS];
+  DeauthWindow window;
+};
+
+// One window of beacons: a count-min sketch of BSSIDs (saturating byte
+// counters) and HyperLogLog registers for distinct BSSIDs and SSIDs.
+struct FloodSketch {
+  uint8_t cms[FLOOD_CMS_DEPTH][FLOOD_CMS_WIDTH];
+  uint8_t bssidHll[FLOOD_HLL_REGS];
+  uint8_t ssidHll[FLOOD_HLL_REGS];
+  uint32_t beacons;
+  uint8_t topCount;
+  uint8_t topBssid[6];
+  uint8_t channel;      // of the first beacon
+  uint8_t lastChannel;  // of the latest; differs once the radio hops
+};
+
+// A BSSID heard sending probe responses, with the SSIDs it answered for
+// in the current window.
+struct KarmaResponder {
+  uint8_t bssid[6];
+  volatile uint8_t count;  // distinct SSIDs, saturates at KARMA_SSIDS
+  bool reported;           // logged since it took the slot
+  uint16_t ssidHash[KARMA_SSIDS];
+  uint32_t windowStart;
   int8_t rssi;
   uint8_t channel;
-  uint32_t firstSeen;
+};
+
+// A Channel Switch Announcement heard for a BSSID, and what the AP did
+// after it.
+struct CsaTrack {
+  uint8_t bssid[6];
+  uint8_t channel;     // the one it was announced on
+  bool dsKnown;        // ...as the frame's own DS Parameter Set said
+  uint8_t newChannel;
+  uint8_t count;       // beacon intervals to go, as last heard
+  uint8_t mode;        // 1: clients must stop sending until the switch
+  uint8_t via;         // CSA_VIA_* frames that carried it
+  volatile uint8_t flags;  // CSA_* anomalies
+  uint8_t plain;       // own beacons heard on the old channel without it
+  uint8_t heard;
+  bool noted;          // printed by the loop
+  bool reported;       // logged as suspect
+  uint16_t intervalTu;
+  uint32_t firstMs;
+  uint32_t lastMs;
+  uint32_t switchMs;   // when the AP said it would be gone
+  int8_t rssi;
+};
+
+// A client's handshakes with one AP in the current window. Counters and
+// addresses only: nonces, MICs and key data are never kept.
+struct EapolPair {
+  uint8_t client[6];
+  uint8_t bssid[6];
+  uint8_t msgs[4];        // 4-way messages 1-4 heard, saturating
+  uint8_t attempts;       // handshakes started (message 1)
+  uint8_t completed;      // reached message 4
+  uint8_t rejected;       // message 2 answered by a new message 1, not 3
+  uint8_t unanswered;     // message 1 repeated without a message 2
+  uint8_t eapFailures;    // 802.1X EAP-Failure from the AP
+  volatile uint8_t stage; // last message of the open handshake, 0 none
+  uint8_t channel;
+  int8_t rssi;
+  bool reported;
+  uint32_t windowStart;
+  uint32_t lastMs;
+};
+
+enum CardWindow : uint8_t { CARD_1MIN, CARD_10MIN, CARD_1HOUR, CARD_WINDOWS };
+
+// Distinct-address history for one kind of transmitter: the last ten
+// minutes and the last six ten-minute blocks as HyperLogLog registers.
+struct CardinalityHistory {
+  uint8_t minute[CARD_MINUTES][CARD_HLL_REGS];
+  uint8_t block[CARD_BLOCKS][CARD_HLL_REGS];
+  uint8_t minuteIdx;
+  uint8_t blockIdx;
+  uint32_t minutesDone;
+  uint16_t estimate[CARD_WINDOWS];
+};
+
+// Space-Saving summary of the heaviest addresses on the current channel.
+// Entries are kept in ascending order of frames, unused ones (frames == 0)
+// first, so entry[0] is always the one to replace. Counts over-estimate by
+// at most frameErr, the count inherited from the address it replaced.
+struct Talker {
+  uint8_t mac[6];
+  uint32_t frames;
+  uint32_t frameErr;
+  uint32_t bytes;
+  uint32_t airtimeUs;
+};
+
+struct TalkerTable {
+  Talker entry[TALKER_K];
+  uint8_t index[TALKER_INDEX_SIZE];  // entry position + 1, 0 = empty
+  uint32_t frames;
+  uint32_t airtimeUs;
+};
+
+// TSF clocks heard in one BSSID's beacons
+struct TsfClock {
+  uint8_t bssid[6];
+  uint16_t intervalTu;
+  uint64_t tsf;          // main clock at its last beacon...
+  uint64_t refTsf;       // ...and where its drift is measured from
+  uint64_t altTsf;       // a second clock heard under the same BSSID
+  uint32_t rxUs;         // our rx timestamps of those three beacons
+  uint32_t refRxUs;
+  uint32_t altRxUs;
+  int32_t drift;         // main clock rate against ours, 1/16 ppm
+  uint16_t jitter;       // mean deviation from the main clock, 1/16 us
+  int8_t rssi;           // of the last main clock beacon
+  uint8_t run;           // beacons on the main clock, saturating
+  uint8_t altRun;        // ...and on the second one
+  uint8_t altAlone;      // second clock beacons since the main clock was last heard
+  bool onAlt;            // the last beacon that fitted a clock was on the second
+  volatile uint8_t switches;  // alternations between the two, saturating
+  volatile uint32_t lastSwitchMs;
+};
+
+// Sequence numbers of one BSSID's beacons. Only the sniffer callback
+// writes it.
+struct SeqStream {
+  uint8_t bssid[6];
+  uint16_t seq;      // of the last in-stream beacon
+  uint16_t judgedSeq;  // of the last in-stream frame judged against it
+  uint32_t lastMs;   // when it was heard
+  int8_t rssi;       // of that beacon
+  uint8_t run;       // in-stream beacons, saturating
+  volatile uint8_t strays;  // out-of-stream beacons, saturating
+  volatile uint32_t lastStrayMs;
+};
+
+// Last sequence control field heard from one transmitter
+struct SeqSlot {
+  uint8_t ta[6];
+  uint16_t seqCtl;
+};
+
+// Beacons heard from one AP against the number its interval promised for
+// the time the sniffer spent on its channel, plus what the AP's own BSS
+// Load and HT Operation elements say. The callback writes the volatile
+// fields.
+struct BeaconTrack {
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t dwellLoss;  // percent in the last long enough dwell, -1 = none yet
+  volatile uint16_t intervalTu;
+  volatile uint16_t dwellHeard;
+  volatile uint16_t stations;    // BSS Load: associated stations
+  volatile uint8_t utilization;  // BSS Load: busy time, 255 = 100%
+  volatile int8_t secondary;     // HT: +1 / -1 secondary above / below, 0 = 20 MHz
+  volatile uint8_t ies;          // BEACON_IE_* seen since the channel was set
+  uint32_t lastListed;  // last AP scan that returned it
+  float heard;
+  float expected;
+};
+
+// Station <-> BSSID graph. Side 0 of an edge is the station, side 1 the
+// AP; each node keeps a doubly linked list of its edges per side, so
+// adding or dropping an edge never walks a list.
+struct AssocNode {
+  uint8_t mac[6];
+  uint8_t head[2];  // first edge on each side
+  uint8_t count[2];
+  uint8_t current;  // station: edge of the AP it last sent to
+  uint8_t roams;
+};
+
+struct AssocEdge {
+  uint8_t end[2];
+  uint8_t next[2];
+  uint8_t prev[2];
+  uint8_t lruPrev;
+  uint8_t lruNext;
   uint32_t lastSeen;
-  uint16_t seenCount;
-  bool isPresent;
-  bool active;
+  uint16_t frames;
+  int8_t rssi;  // of the station, from frames it sent
+};
+
+struct AssocLink {
+  uint8_t sta[6];
+  uint8_t bssid[6];
+  uint32_t lastSeen;
+  uint16_t frames;
+  int8_t rssi;
+};
+
+// A frame the Wi-Fi callback passed to the loop: rx metadata plus the
+// first INGEST_SNAP_LEN bytes of the 802.11 frame.
+struct IngestFrame {
+  int64_t timeUs;
+  uint16_t sigLen;
+  uint16_t len;
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t type;
+  uint8_t source;
+  uint8_t flags;
+  uint8_t payload[INGEST_SNAP_LEN];
+};
+
+struct LoopProfile {
+  uint32_t count;
+  uint32_t maxUs;
+  uint32_t hist[LAT_HIST_BUCKETS];
+  uint64_t phaseUs[PH_COUNT];
+};
+
+// Frame counts leave out retransmissions of a frame already heard;
+// airtime, retry and sequenced count every frame.
+struct ChannelCounters {
+  uint32_t total[MAX_CHANNEL + 1];
+  uint32_t beacon[MAX_CHANNEL + 1];
+  uint32_t data[MAX_CHANNEL + 1];
+  uint32_t deauth[MAX_CHANNEL + 1];
+  uint32_t airtimeUs[MAX_CHANNEL + 1];
+  uint32_t retry[MAX_CHANNEL + 1];      // Retry bit set
+  uint32_t sequenced[MAX_CHANNEL + 1];  // management and data frames
 };
 
 struct RSSIHistory {
@@ -141,10 +545,9 @@ extern uint8_t eventScroll;
 extern Baseline baseline;
 extern Baseline currentSnapshot;
 
-extern MonitoredDevice monitoredDevices[MAX_MONITORED_DEVICES];
-extern uint8_t monitoredDeviceCount;
+extern uint16_t monitoredDeviceCount;
 extern uint8_t deviceCursor;
-extern uint8_t deviceScroll;
-extern uint8_t deviceSelectedIndex;
+extern uint16_t deviceScroll;
+extern uint16_t deviceSelectedIndex;
 
 #endif
@@ -0,0 +1,275 @@
+#include "csa_watch.h"
+#include "beacon_loss.h"
+#include "alerts.h"
+#include <esp_timer.h>
+
+// Channel Switch Announcements. An AP about to change channel says so in
+// its beacons and probe responses, as a Channel Switch Announcement or
+// Extended CSA element counting down the beacon intervals left, and may
+// repeat it in an action frame. Clients follow it without question, so a
+// forged one moves them off the AP as surely as a deauth and leaves no
+// deauth behind.
+//
+// Where an announcement can sit is looked up by management subtype, and
+// for action frames by category and action, so the callback only walks
+// the elements of frames that can carry one. Each announcement is
+// followed in a small table for CSA_WATCH_MS after it was last heard, and
+// checked against what the AP itself does:
+// - the new channel must be another one in the band
+// - the frame must fit the BSSID's beacon sequence numbers
+// - an AP that is leaving puts the element in every beacon until it goes,
+//   so its own beacons on the old channel without it contradict it
+// - a scan from after the switch time must not still find it there
+// - it must come from the channel the last scan put the AP on, by its own
+//   DS Parameter Set; a frame without one may have bled over from the
+//   channel next door
+//
+// The callback writes the table and the loop reads it; a track taken over
+// by another BSSID mid-read costs one late alert.
+
+bool csaAlertActive = false;
+uint32_t csaHeard = 0;
+uint32_t csaDetected = 0;
+
+static CsaTrack tracks[CSA_TRACKS];
+static volatile uint32_t lastAnnounceMs = 0;
+static uint32_t lastSuspectMs = 0;
+
+// Offset of the elements, by management subtype; 0 where no CSA element
+// can be (action frames are matched below)
+DRAM_ATTR static const uint8_t elementsAt[16] = {
+  0, 0, 0, 0,    // (re)association request and response
+  0, 36, 0, 0,   // probe request, probe response, timing advertisement
+  36, 0, 0, 0,   // beacon, ATIM, disassociation, authentication
+  0, 0, 0, 0,    // deauthentication, action, action no ack
+};
+
+// Action frames that announce a switch, and where: as elements, or as the
+// bare mode, operating class, channel and count fields of an ECSA element
+struct CsaAction {
+  uint8_t category;
+  uint8_t action;
+  bool elements;
+};
+
+DRAM_ATTR static const CsaAction csaActions[] = {
+  {0, 4, true},   // spectrum management: Channel Switch Announcement
+  {4, 4, false},  // public: Extended Channel Switch Announcement
+};
+
+struct CsaFields {
+  uint8_t mode;
+  uint8_t newChannel;
+  uint8_t count;
+  uint8_t dsChannel;  // DS Parameter Set, where the AP says it is
+};
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static bool IRAM_ATTR parseElements(const uint8_t* ie, const uint8_t* end, CsaFields* out) {
+  bool found = false;
+  while (ie + 2 <= end) {
+    uint8_t id = ie[0];
+    uint8_t len = ie[1];
+    const uint8_t* body = ie + 2;
+    if (body + len > end) break;
+
+    if (id == 3 && len >= 1) {  // DS Parameter Set
+      out->dsChannel = body[0];
+    } else if (id == 37 && len >= 3 && !found) {  // Channel Switch Announcement
+      out->mode = body[0];
+      out->newChannel = body[1];
+      out->count = body[2];
+      found = true;
+    } else if (id == 60 && len >= 4 && !found) {  // Extended Channel Switch Announcement
+      out->mode = body[0];
+      out->newChannel = body[2];
+      out->count = body[3];
+      found = true;
+    }
+    ie = body + len;
+  }
+  return found;
+}
+
+static bool IRAM_ATTR parseAction(const uint8_t* f, const uint8_t* end, CsaFields* out) {
+  if (f + 26 > end) return false;
+  for (size_t i = 0; i < sizeof(csaActions) / sizeof(csaActions[0]); i++) {
+    const CsaAction& a = csaActions[i];
+    if (f[24] != a.category || f[25] != a.action) continue;
+    if (a.elements) return parseElements(f + 26, end, out);
+    if (f + 30 > end) return false;
+    out->mode = f[26];
+    out->newChannel = f[28];
+    out->count = f[29];
+    return true;
+  }
+  return false;
+}
+
+static CsaTrack* IRAM_ATTR findTrack(const uint8_t* bssid) {
+  for (int i = 0; i < CSA_TRACKS; i++) {
+    if (tracks[i].heard && sameMac(tracks[i].bssid, bssid)) return &tracks[i];
+  }
+  return nullptr;
+}
+
+// A new announcement takes the BSSID's own track, else a free one, else
+// the one heard longest ago
+static CsaTrack* IRAM_ATTR claimTrack(const uint8_t* bssid) {
+  CsaTrack* t = findTrack(bssid);
+  if (t) return t;
+  t = &tracks[0];
+  for (int i = 0; i < CSA_TRACKS; i++) {
+    if (!tracks[i].heard) return &tracks[i];
+    if ((int32_t)(tracks[i].lastMs - t->lastMs) < 0) t = &tracks[i];
+  }
+  return t;
+}
+
+// v is the sequence verdict on a beacon; other frames are checked here
+// once they turn out to carry an announcement. A retried copy repeats a
+// number already judged, so it is neither judged nor counted as plain.
+void IRAM_ATTR csaObserve(const wifi_promiscuous_pkt_t* p, uint8_t subtype, SeqVerdict v, bool duplicate) {
+  const uint8_t* f = p->payload;
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (!f || len < 24) return;
+  const uint8_t* end = f + len;
+
+  CsaFields a = {0, 0, 0, 0};
+  bool found;
+  uint8_t at = elementsAt[subtype & 0x0F];
+  if (at) found = len > at && parseElements(f + at, end, &a);
+  else found = parseAction(f, end, &a);
+
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  const uint8_t* bssid = &f[16];
+  uint8_t ch = a.dsChannel ? a.dsChannel : p->rx_ctrl.channel;
+
+  if (!found) {
+    if (subtype != 0x08 || duplicate || now - lastAnnounceMs > CSA_WATCH_MS) return;
+    CsaTrack* t = findTrack(bssid);
+    if (t && now - t->lastMs <= CSA_WATCH_MS && ch == t->channel && v != SEQ_STRAY && t->plain < 0xFF) {
+      t->plain++;
+    }
+    return;
+  }
+
+  if (duplicate) v = SEQ_UNKNOWN;
+  else if (subtype != 0x08) v = seqCheck(p, false);
+  lastAnnounceMs = now;
+  CsaTrack* t = claimTrack(bssid);
+  if (!t->heard || !sameMac(t->bssid, bssid) || t->newChannel != a.newChannel || now - t->lastMs > CSA_WATCH_MS) {
+    for (int i = 0; i < 6; i++) t->bssid[i] = bssid[i];
+    t->channel = ch;
+    t->dsKnown = a.dsChannel != 0;
+    t->newChannel = a.newChannel;
+    t->via = 0;
+    t->flags = 0;
+    t->plain = 0;
+    t->heard = 0;
+    t->noted = false;
+    t->reported = false;
+    t->intervalTu = 100;
+    t->firstMs = now;
+  } else if (a.dsChannel) {
+    t->channel = a.dsChannel;
+    t->dsKnown = true;
+  }
+  if (subtype == 0x08) {
+    uint16_t tu = f[32] | (f[33] << 8);
+    if (tu >= 10 && tu <= 1000) t->intervalTu = tu;
+  }
+  t->via |= subtype == 0x08 ? CSA_VIA_BEACON : at ? CSA_VIA_RESPONSE : CSA_VIA_ACTION;
+  t->mode = a.mode;
+  t->count = a.count;
+  t->lastMs = now;
+  t->switchMs = now + (uint32_t)a.count * t->intervalTu * 1024 / 1000;
+  t->rssi = p->rx_ctrl.rssi;
+  if (t->heard < 0xFF) t->heard++;
+
+  uint8_t flags = t->flags;
+  if (a.newChannel == 0 || a.newChannel > MAX_CHANNEL || a.newChannel == a.dsChannel) flags |= CSA_BAD_CHANNEL;
+  if (v == SEQ_STRAY) flags |= CSA_STRAY;
+  t->flags = flags;
+}
+
+static const char* anomalyName(uint8_t flags) {
+  if (flags & CSA_BAD_CHANNEL) return "bad channel";
+  if (flags & CSA_STRAY) return "forged";
+  if (flags & CSA_IGNORED) return "AP denies";
+  if (flags & CSA_STAYED) return "AP stayed";
+  return "wrong channel";
+}
+
+static void printTrack(const CsaTrack& t, const char* what) {
+  Serial.printf("[CSA] %02X:%02X:%02X:%02X:%02X:%02X ch%u -> ch%u count %u mode %u via%s%s%s heard %u %s",
+                t.bssid[0], t.bssid[1], t.bssid[2], t.bssid[3], t.bssid[4], t.bssid[5], t.channel,
+                t.newChannel, t.count, t.mode, t.via & CSA_VIA_BEACON ? " beacon" : "",
+                t.via & CSA_VIA_RESPONSE ? " response" : "", t.via & CSA_VIA_ACTION ? " action" : "",
+                t.heard, what);
+  if (t.flags & CSA_BAD_CHANNEL) Serial.print(" bad-channel");
+  if (t.flags & CSA_STRAY) Serial.print(" out-of-sequence");
+  if (t.flags & CSA_IGNORED) Serial.printf(" %u-plain-beacons", t.plain);
+  if (t.flags & CSA_STAYED) Serial.print(" still-listed");
+  if (t.flags & CSA_ELSEWHERE) Serial.print(" off-channel");
+  Serial.println();
+}
+
+static void raiseCsa(CsaTrack& t) {
+  csaDetected++;
+  char msg[40];
+  snprintf(msg, 40, "CSA Ch%d>%d %02X:%02X:%02X %s", t.channel, t.newChannel, t.bssid[3], t.bssid[4],
+           t.bssid[5], anomalyName(t.flags));
+  logEvent(6, msg);
+  printTrack(t, "suspect");
+}
+
+void updateCsaWatch() {
+  uint32_t now = millis();
+  for (int i = 0; i < CSA_TRACKS; i++) {
+    CsaTrack& t = tracks[i];
+    if (!t.heard || now - t.lastMs > CSA_WATCH_MS) continue;
+    if (!t.noted) {
+      t.noted = true;
+      csaHeard++;
+      printTrack(t, "announced");
+    }
+
+    uint8_t flags = 0;
+    if (t.plain >= CSA_PLAIN_BEACONS) flags |= CSA_IGNORED;
+    uint32_t listedMs = 0;
+    uint8_t home = beaconListedChannel(t.bssid, &listedMs);
+    if (home && home != t.newChannel) {
+      if (home == t.channel) {
+        if ((int32_t)(listedMs - t.switchMs) > CSA_GRACE_MS) flags |= CSA_STAYED;
+      } else if (t.dsKnown) {
+        flags |= CSA_ELSEWHERE;
+      }
+    }
+    if (flags) t.flags |= flags;
+    if (!t.flags) continue;
+
+    lastSuspectMs = now;
+    if (!t.reported) {
+      t.reported = true;
+      raiseCsa(t);
+    }
+  }
+  csaAlertActive = csaDetected && now - lastSuspectMs <= CSA_HOLD_MS;
+}
+
+bool csaFlagged(const uint8_t* bssid) {
+  const CsaTrack* t = findTrack(bssid);
+  return t && t->reported;
+}
+
+const CsaTrack* csaTrackAt(uint8_t i) {
+  if (i >= CSA_TRACKS || !tracks[i].heard) return nullptr;
+  return &tracks[i];
+}
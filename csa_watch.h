@@ -0,0 +1,29 @@
+#ifndef CSA_WATCH_H
+#define CSA_WATCH_H
+
+#include "config.h"
+#include "seq_watch.h"
+#include <esp_wifi.h>
+
+// CsaTrack.via
+#define CSA_VIA_BEACON 0x01
+#define CSA_VIA_RESPONSE 0x02
+#define CSA_VIA_ACTION 0x04
+
+// CsaTrack.flags
+#define CSA_BAD_CHANNEL 0x01  // new channel outside the band, or the one it is on
+#define CSA_STRAY 0x02        // out of the BSSID's sequence stream
+#define CSA_IGNORED 0x04      // the AP's own beacons on the old channel go on without it
+#define CSA_STAYED 0x08       // a scan after the switch time still finds the AP there
+#define CSA_ELSEWHERE 0x10    // announced on a channel the AP is not on
+
+extern bool csaAlertActive;
+extern uint32_t csaHeard;
+extern uint32_t csaDetected;
+
+void IRAM_ATTR csaObserve(const wifi_promiscuous_pkt_t* p, uint8_t subtype, SeqVerdict v, bool duplicate);
+void updateCsaWatch();
+bool csaFlagged(const uint8_t* bssid);
+const CsaTrack* csaTrackAt(uint8_t i);
+
+#endif // CSA_WATCH_H
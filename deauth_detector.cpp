@@ -0,0 +1,309 @@
+#include "deauth_detector.h"
+#include "wifi_scanner.h"
+#include "alerts.h"
+#include "ingest.h"
+#include <esp_timer.h>
+
+// Deauth/disassoc rates over a sliding window, per channel and per
+// transmitter. Counts go into DEAUTH_BUCKET_MS buckets shared by every
+// window; the rate is the sum of the newest settings.deauthWindowMs worth.
+// A window raises when its rate exceeds settings.deauthThreshold and
+// clears only after staying at or below half of it for DEAUTH_COOLDOWN_MS,
+// so a burst with gaps stays one attack, and needs DEAUTH_MIN_FRAMES
+// frames, so one stray deauth in a short window is no attack. The
+// detector keeps its own counts, so resetting the live or analyzer
+// counters does not blind it.
+//
+// The channel counts are taken in the sniffer callback, so a loop held up
+// (a BLE scan, a full ingest ring) loses no frames and judges each in its
+// own bucket; the transmitter detail comes from the ingest ring.
+// Frames whose sequence number follows their BSSID's beacons were sent by
+// the AP itself; they are counted apart and only raise at
+// DEAUTH_GENUINE_FACTOR times the threshold, since an AP kicking clients
+// that fast empties its network all the same.
+// Both subtypes feed the same windows, since either one knocks a client
+// off; each source counts its disassociations and their reason codes
+// apart.
+
+DeauthSource deauthSources[DEAUTH_MAX_SOURCES];
+uint32_t deauthSpoofedTotal = 0;
+uint32_t deauthGenuineTotal = 0;
+
+static DeauthWindow channelWindows[MAX_CHANNEL + 1];
+static DeauthTally tallies[MAX_CHANNEL + 1][DEAUTH_BUCKETS];
+static uint32_t curBucket = 0;
+
+static void bump(uint16_t& c) {
+  if (c < 0xFFFF) c++;
+}
+
+// Moves the window edge forward, clearing the buckets it passes over.
+static void advanceTo(uint32_t bucket) {
+  if ((int32_t)(bucket - curBucket) <= 0) return;
+  uint32_t steps = min(bucket - curBucket, (uint32_t)DEAUTH_BUCKETS);
+  for (uint32_t i = 1; i <= steps; i++) {
+    uint8_t col = (bucket - steps + i) % DEAUTH_BUCKETS;
+    for (int s = 0; s < DEAUTH_MAX_SOURCES; s++) {
+      deauthSources[s].window.buckets[col] = 0;
+      deauthSources[s].window.genuine[col] = 0;
+    }
+  }
+  curBucket = bucket;
+}
+
+static uint32_t windowCount(const uint16_t* buckets, uint8_t span) {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < span; i++) {
+    n += buckets[(curBucket - i) % DEAUTH_BUCKETS];
+  }
+  return n;
+}
+
+static uint8_t windowSpan() {
+  uint16_t span = settings.deauthWindowMs / DEAUTH_BUCKET_MS;
+  return constrain(span, 1, DEAUTH_BUCKETS);
+}
+
+// The rate a window is judged by: the frames that may be forged, or all of
+// them scaled down by DEAUTH_GENUINE_FACTOR. Fewer than DEAUTH_MIN_FRAMES
+// frames give no rate.
+static uint32_t windowRate(const DeauthWindow& w) {
+  uint8_t span = windowSpan();
+  uint32_t ms = span * DEAUTH_BUCKET_MS;
+  uint32_t forged = windowCount(w.buckets, span);
+  uint32_t all = forged + windowCount(w.genuine, span);
+  uint32_t rate = forged >= DEAUTH_MIN_FRAMES ? forged * 1000 / ms : 0;
+  if (all >= DEAUTH_MIN_FRAMES) rate = max(rate, all * 1000 / ms / DEAUTH_GENUINE_FACTOR);
+  return rate;
+}
+
+// +1 when the window raises, -1 when it clears, 0 otherwise
+static int8_t updateState(DeauthWindow& w, uint32_t rate, uint32_t now) {
+  if (!w.active) {
+    if (rate <= settings.deauthThreshold) return 0;
+    w.active = true;
+    w.calmSince = now;
+    return 1;
+  }
+  if (rate * 2 > settings.deauthThreshold) {
+    w.calmSince = now;
+    return 0;
+  }
+  if (now - w.calmSince < DEAUTH_COOLDOWN_MS) return 0;
+  w.active = false;
+  return -1;
+}
+
+// The transmitter's slot; a new one takes a free slot or the idle source
+// seen longest ago. Returns nullptr when every slot is mid-attack.
+static DeauthSource* findSource(const uint8_t* mac) {
+  DeauthSource* victim = nullptr;
+  for (int i = 0; i < DEAUTH_MAX_SOURCES; i++) {
+    DeauthSource& s = deauthSources[i];
+    if (s.used && memcmp(s.mac, mac, 6) == 0) return &s;
+    if (!s.used) {
+      if (!victim || victim->used) victim = &s;
+    } else if (!s.window.active && (!victim || (victim->used && s.lastSeen < victim->lastSeen))) {
+      victim = &s;
+    }
+  }
+  if (victim) {
+    memset(victim, 0, sizeof(DeauthSource));
+    memcpy(victim->mac, mac, 6);
+    victim->used = true;
+  }
+  return victim;
+}
+
+// One deauth or disassoc heard on ch
+void IRAM_ATTR deauthCount(uint8_t ch, bool genuine) {
+  uint32_t bucket = (uint32_t)(esp_timer_get_time() / 1000) / DEAUTH_BUCKET_MS;
+  DeauthTally& t = tallies[ch][bucket % DEAUTH_BUCKETS];
+  if (t.bucket != bucket) {
+    t.count = 0;
+    t.genuine = 0;
+    t.bucket = bucket;
+  }
+  if (genuine) {
+    if (t.genuine < 0xFFFF) t.genuine++;
+  } else if (t.count < 0xFFFF) {
+    t.count++;
+  }
+}
+
+// Copies the callback's counts of the buckets in the window
+static void collectTallies() {
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    for (uint32_t i = 0; i < DEAUTH_BUCKETS; i++) {
+      uint32_t bucket = curBucket - i;
+      const DeauthTally& t = tallies[ch][bucket % DEAUTH_BUCKETS];
+      bool current = t.bucket == bucket;
+      channelWindows[ch].buckets[bucket % DEAUTH_BUCKETS] = current ? t.count : 0;
+      channelWindows[ch].genuine[bucket % DEAUTH_BUCKETS] = current ? t.genuine : 0;
+    }
+  }
+}
+
+void deauthRecord(const IngestFrame& f) {
+  if (f.channel == 0 || f.channel > MAX_CHANNEL) return;
+
+  uint32_t now = f.timeUs / 1000;
+  uint32_t bucket = now / DEAUTH_BUCKET_MS;
+  advanceTo(bucket);
+  if (curBucket - bucket >= DEAUTH_BUCKETS) return;
+  uint8_t col = bucket % DEAUTH_BUCKETS;
+  bool genuine = f.flags & INGEST_GENUINE;
+  if (genuine) deauthGenuineTotal++;
+  if (f.flags & INGEST_SPOOFED) deauthSpoofedTotal++;
+
+  if (f.len < 26) return;
+
+  DeauthSource* s = findSource(&f.payload[10]);
+  if (!s) return;
+  memcpy(s->target, &f.payload[4], 6);
+  memcpy(s->bssid, &f.payload[16], 6);
+  s->channel = f.channel;
+  s->frames++;
+  s->lastSeen = now;
+  uint16_t reason = min((uint16_t)(f.payload[24] | (f.payload[25] << 8)), (uint16_t)(DEAUTH_REASON_BINS - 1));
+  if (((f.payload[0] >> 4) & 0x0F) == 0x0A) {
+    s->disassoc++;
+    bump(s->disassocReasons[reason]);
+  } else {
+    bump(s->reasons[reason]);
+  }
+  if (f.flags & INGEST_SPOOFED) s->spoofed++;
+  if (genuine) {
+    s->genuine++;
+    bump(s->window.genuine[col]);
+  } else {
+    bump(s->window.buckets[col]);
+  }
+}
+
+// Most of its frames broke the sequence stream of the BSSID they claimed
+bool deauthSourceSpoofed(const DeauthSource& s) {
+  return s.spoofed * 2 > s.frames;
+}
+
+static void formatTarget(const uint8_t* mac, char* out) {
+  if (memcmp(mac, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0) strcpy(out, "all");
+  else sprintf(out, "%02X:%02X:%02X", mac[3], mac[4], mac[5]);
+}
+
+static void logSourceStart(const DeauthSource& s) {
+  char target[9];
+  formatTarget(s.target, target);
+  char msg[40];
+  snprintf(msg, 40, "Src %02X:%02X:%02X:%02X:%02X:%02X>%s%s",
+           s.mac[0], s.mac[1], s.mac[2], s.mac[3], s.mac[4], s.mac[5], target,
+           deauthSourceSpoofed(s) ? " forged" : "");
+  logEvent(0, msg);
+}
+
+static void printReasons(const char* label, const uint16_t* reasons) {
+  Serial.printf(" %s", label);
+  for (uint8_t r = 0; r < DEAUTH_REASON_BINS; r++) {
+    if (reasons[r]) Serial.printf(" %u%s:%u", r, r == DEAUTH_REASON_BINS - 1 ? "+" : "", reasons[r]);
+  }
+}
+
+// Logs the two most common reason codes of either subtype; the full
+// histograms go to serial.
+static void logSourceEnd(const DeauthSource& s) {
+  uint32_t both[DEAUTH_REASON_BINS];
+  uint32_t counted = 0;
+  for (uint8_t r = 0; r < DEAUTH_REASON_BINS; r++) {
+    both[r] = s.reasons[r] + s.disassocReasons[r];
+    counted += both[r];
+  }
+  if (counted == 0) counted = 1;
+  uint8_t top[2] = {0, 0};
+  for (uint8_t r = 1; r < DEAUTH_REASON_BINS; r++) {
+    if (both[r] > both[top[0]]) {
+      top[1] = top[0];
+      top[0] = r;
+    } else if (r != top[0] && both[r] > both[top[1]]) {
+      top[1] = r;
+    }
+  }
+
+  char msg[40];
+  snprintf(msg, 40, "End %02X:%02X:%02X n=%lu r%u:%lu%% r%u:%lu%%", s.mac[3], s.mac[4], s.mac[5],
+           (unsigned long)s.frames, top[0], (unsigned long)(both[top[0]] * 100 / counted),
+           top[1], (unsigned long)(both[top[1]] * 100 / counted));
+  logEvent(0, msg);
+
+  char target[9];
+  formatTarget(s.target, target);
+  Serial.printf("[DEAUTH] %02X:%02X:%02X:%02X:%02X:%02X bssid %02X:%02X:%02X:%02X:%02X:%02X ch%u target %s frames %lu",
+                s.mac[0], s.mac[1], s.mac[2], s.mac[3], s.mac[4], s.mac[5],
+                s.bssid[0], s.bssid[1], s.bssid[2], s.bssid[3], s.bssid[4], s.bssid[5],
+                s.channel, target, (unsigned long)s.frames);
+  Serial.printf(" spoofed %lu genuine %lu disassoc %lu", (unsigned long)s.spoofed, (unsigned long)s.genuine,
+                (unsigned long)s.disassoc);
+  printReasons("reasons", s.reasons);
+  printReasons("disassoc reasons", s.disassocReasons);
+  Serial.println();
+}
+
+void updateDeauthRate() {
+  uint32_t now = millis();
+  advanceTo(now / DEAUTH_BUCKET_MS);
+  collectTallies();
+
+  uint32_t perSecond = 0;
+  bool active = false;
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    DeauthWindow& w = channelWindows[ch];
+    uint32_t rate = windowRate(w);
+    perSecond += windowCount(w.buckets, DEAUTH_BUCKETS);
+    if (updateState(w, rate, now) > 0) {
+      char msg[40];
+      snprintf(msg, 40, "Deauth attack! Ch%d %u/sec", ch, (unsigned)rate);
+      logEvent(0, msg);
+    }
+    if (w.active) active = true;
+  }
+
+  for (int i = 0; i < DEAUTH_MAX_SOURCES; i++) {
+    DeauthSource& s = deauthSources[i];
+    if (!s.used) continue;
+    int8_t change = updateState(s.window, windowRate(s.window), now);
+    if (change > 0) {
+      logSourceStart(s);
+    } else if (change < 0) {
+      logSourceEnd(s);
+      s.frames = 0;
+      s.spoofed = 0;
+      s.genuine = 0;
+      s.disassoc = 0;
+      memset(s.reasons, 0, sizeof(s.reasons));
+      memset(s.disassocReasons, 0, sizeof(s.disassocReasons));
+    }
+  }
+
+  deauthPerSecond = perSecond * 1000 / (DEAUTH_BUCKETS * DEAUTH_BUCKET_MS);
+  attackActive = active;
+}
+
+uint32_t deauthChannelRate(uint8_t ch) {
+  if (ch == 0 || ch > MAX_CHANNEL) return 0;
+  return windowRate(channelWindows[ch]);
+}
+
+// The active source with the highest current rate, else nullptr
+const DeauthSource* deauthTopSource() {
+  const DeauthSource* top = nullptr;
+  uint32_t best = 0;
+  for (int i = 0; i < DEAUTH_MAX_SOURCES; i++) {
+    const DeauthSource& s = deauthSources[i];
+    if (!s.used || !s.window.active) continue;
+    uint32_t rate = windowRate(s.window);
+    if (!top || rate > best) {
+      top = &s;
+      best = rate;
+    }
+  }
+  return top;
+}
@@ -0,0 +1,18 @@
+#ifndef DEAUTH_DETECTOR_H
+#define DEAUTH_DETECTOR_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+extern DeauthSource deauthSources[DEAUTH_MAX_SOURCES];
+extern uint32_t deauthSpoofedTotal;
+extern uint32_t deauthGenuineTotal;
+
+void IRAM_ATTR deauthCount(uint8_t ch, bool genuine);
+void deauthRecord(const IngestFrame& f);
+void updateDeauthRate();
+uint32_t deauthChannelRate(uint8_t ch);
+const DeauthSource* deauthTopSource();
+bool deauthSourceSpoofed(const DeauthSource& s);
+
+#endif // DEAUTH_DETECTOR_H
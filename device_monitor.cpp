@@ -1,6 +1,10 @@
 #include "device_monitor.h"
 #include "wifi_scanner.h"
 #include "ble_scanner.h"
+#include "hop_planner.h"
+#include "sniffer_stats.h"
+#include "ingest.h"
+#include "cardinality.h"
 #include "utils.h"
 #include <string.h>
 
@@ -8,158 +12,297 @@ void IRAM_ATTR deviceMonitorSniffer(void* buf, wifi_promiscuous_pkt_type_t type)
 
 static bool deviceMonitorActive = false;
 static uint8_t monitorChannel = 1;
-static uint32_t lastChannelHop = 0;
 
-void addOrUpdateWiFiClient(const uint8_t* mac, int8_t rssi, uint8_t channel) {
-  uint32_t now = millis();
+#define DEVICE_NONE 0xFFFF
+#define DEVICE_KEY_USED (1ULL << 63)
+#define DEVICE_KEY_BLE (1ULL << 48)
+#define DEVICE_ADDR_MASK 0xFFFFFFFFFFFFULL
 
-  if (mac[0] & 0x01) return;
+uint16_t deviceCapacity = 0;
+uint64_t* deviceKey = nullptr;
+uint32_t* deviceLastSeen = nullptr;
+int8_t* deviceRssi = nullptr;
+uint16_t* deviceSeenCount = nullptr;
+MonitoredDevice* monitoredDevices = nullptr;
+DeviceTableStats deviceTableStats;
 
-  bool allZero = true, allFF = true;
-  for (int i = 0; i < 6; i++) {
-    if (mac[i] != 0x00) allZero = false;
-    if (mac[i] != 0xFF) allFF = false;
-  }
-  if (allZero || allFF) return;
-
-  for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-    if (monitoredDevices[i].active &&
-        monitoredDevices[i].type == 0 &&
-        memcmp(monitoredDevices[i].bssid, mac, 6) == 0) {
-      monitoredDevices[i].rssi = rssi;
-      monitoredDevices[i].channel = channel;
-      monitoredDevices[i].lastSeen = now;
-      monitoredDevices[i].seenCount++;
-      monitoredDevices[i].isPresent = true;
-      return;
+// Open-addressed index of slot + 1 (0 = empty), at most half full
+static uint16_t* deviceIndex = nullptr;
+static uint8_t indexBits = 0;
+
+// Recency list through the slots: head is the most recently seen device,
+// tail the first to be evicted. Free slots chain through lruNext.
+static uint16_t* lruPrev = nullptr;
+static uint16_t* lruNext = nullptr;
+static uint16_t lruHead = DEVICE_NONE;
+static uint16_t lruTail = DEVICE_NONE;
+static uint16_t freeHead = DEVICE_NONE;
+
+static uint32_t indexHome(uint64_t key) {
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - indexBits));
+}
+
+static uint16_t findDevice(uint64_t key) {
+  uint32_t mask = (1UL << indexBits) - 1;
+  uint16_t probes = 1;
+  deviceTableStats.lookups++;
+  for (uint32_t i = indexHome(key);; i = (i + 1) & mask, probes++) {
+    uint16_t e = deviceIndex[i];
+    if (e == 0 || deviceKey[e - 1] == key) {
+      if (probes > deviceTableStats.maxProbe) deviceTableStats.maxProbe = probes;
+      return e == 0 ? DEVICE_NONE : e - 1;
     }
   }
+}
 
-  if (monitoredDeviceCount < MAX_MONITORED_DEVICES) {
-    for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-      if (!monitoredDevices[i].active) {
-        monitoredDevices[i].type = 0;
-        memcpy(monitoredDevices[i].bssid, mac, 6);
-
-        const char* vendor = getVendor((uint8_t*)mac);
-        if (vendor && strlen(vendor) > 0) {
-          strncpy(monitoredDevices[i].name, vendor, 32);
-        } else {
-          sprintf(monitoredDevices[i].name, "%02X:%02X:%02X", mac[0], mac[1], mac[2]);
-        }
-        monitoredDevices[i].name[32] = '\0';
-
-        monitoredDevices[i].rssi = rssi;
-        monitoredDevices[i].channel = channel;
-        monitoredDevices[i].firstSeen = now;
-        monitoredDevices[i].lastSeen = now;
-        monitoredDevices[i].seenCount = 1;
-        monitoredDevices[i].isPresent = true;
-        monitoredDevices[i].active = true;
-        monitoredDeviceCount++;
-        return;
-      }
+static void indexInsert(uint64_t key, uint16_t slot) {
+  uint32_t mask = (1UL << indexBits) - 1;
+  uint32_t i = indexHome(key);
+  while (deviceIndex[i] != 0) i = (i + 1) & mask;
+  deviceIndex[i] = slot + 1;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones.
+static void indexRemove(uint64_t key) {
+  uint32_t mask = (1UL << indexBits) - 1;
+  uint32_t i = indexHome(key);
+  while (deviceIndex[i] != 0 && deviceKey[deviceIndex[i] - 1] != key) i = (i + 1) & mask;
+  if (deviceIndex[i] == 0) return;
+
+  for (uint32_t j = (i + 1) & mask; deviceIndex[j] != 0; j = (j + 1) & mask) {
+    uint32_t home = indexHome(deviceKey[deviceIndex[j] - 1]);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      deviceIndex[i] = deviceIndex[j];
+      i = j;
     }
   }
+  deviceIndex[i] = 0;
 }
 
-void addOrUpdateBLEDevice(const char* address, const char* name, int8_t rssi) {
-  uint32_t now = millis();
+static void lruUnlink(uint16_t slot) {
+  uint16_t p = lruPrev[slot], n = lruNext[slot];
+  if (p != DEVICE_NONE) lruNext[p] = n;
+  else lruHead = n;
+  if (n != DEVICE_NONE) lruPrev[n] = p;
+  else lruTail = p;
+}
+
+static void lruPushFront(uint16_t slot) {
+  lruPrev[slot] = DEVICE_NONE;
+  lruNext[slot] = lruHead;
+  if (lruHead != DEVICE_NONE) lruPrev[lruHead] = slot;
+  lruHead = slot;
+  if (lruTail == DEVICE_NONE) lruTail = slot;
+}
+
+// Takes a free slot, or evicts the least recently seen device when full.
+static uint16_t allocDevice(uint64_t key) {
+  uint16_t slot = freeHead;
+  if (slot != DEVICE_NONE) {
+    freeHead = lruNext[slot];
+    monitoredDeviceCount++;
+  } else {
+    slot = lruTail;
+    lruUnlink(slot);
+    indexRemove(deviceKey[slot]);
+    deviceTableStats.evictions++;
+  }
+
+  deviceKey[slot] = key;
+  indexInsert(key, slot);
+  lruPushFront(slot);
+  deviceTableStats.inserts++;
+  return slot;
+}
+
+// Returns the device's slot with its hot fields refreshed; inserted is set
+// when the slot was newly claimed and its cold fields still need filling.
+static uint16_t touchDevice(uint64_t key, int8_t rssi, uint32_t now, bool& inserted) {
+  uint16_t slot = findDevice(key);
+  inserted = slot == DEVICE_NONE;
+  if (inserted) {
+    slot = allocDevice(key);
+    deviceSeenCount[slot] = 0;
+    monitoredDevices[slot].firstSeen = now;
+  } else if (slot != lruHead) {
+    lruUnlink(slot);
+    lruPushFront(slot);
+  }
+
+  deviceRssi[slot] = rssi;
+  deviceLastSeen[slot] = now;
+  if (deviceSeenCount[slot] < 0xFFFF) deviceSeenCount[slot]++;
+  monitoredDevices[slot].isPresent = true;
+  return slot;
+}
+
+// Hot and cold arrays, both recency links and two index entries.
+static size_t slotBytes() {
+  return sizeof(uint64_t) + sizeof(uint32_t) + sizeof(int8_t) + 3 * sizeof(uint16_t) +
+         sizeof(MonitoredDevice) + 2 * sizeof(uint16_t);
+}
+
+// Sizes the table from the heap left after Wi-Fi and BLE are up, and carves
+// every array out of one allocation.
+void initDeviceMonitor() {
+  if (deviceKey) return;
+
+  uint32_t cap = ESP.getFreeHeap() / DEVICE_TABLE_HEAP_SHARE / slotBytes();
+  cap = constrain(cap, DEVICE_TABLE_MIN, DEVICE_TABLE_MAX);
+
+  uint8_t* block = nullptr;
+  size_t indexSize = 0;
+  size_t bytes = 0;
+  while (!block && cap >= DEVICE_TABLE_MIN / 2) {
+    indexBits = 1;
+    while ((1UL << indexBits) < cap * 2) indexBits++;
+    indexSize = 1UL << indexBits;
+    bytes = cap * (slotBytes() - 2 * sizeof(uint16_t)) + indexSize * sizeof(uint16_t);
+    block = (uint8_t*)calloc(1, bytes);
+    if (!block) cap /= 2;
+  }
+  if (!block) {
+    Serial.println("[DEV] No memory for device table");
+    return;
+  }
+
+  deviceKey = (uint64_t*)block;
+  deviceLastSeen = (uint32_t*)(deviceKey + cap);
+  monitoredDevices = (MonitoredDevice*)(deviceLastSeen + cap);
+  deviceSeenCount = (uint16_t*)(monitoredDevices + cap);
+  lruPrev = deviceSeenCount + cap;
+  lruNext = lruPrev + cap;
+  deviceIndex = lruNext + cap;
+  deviceRssi = (int8_t*)(deviceIndex + indexSize);
+  deviceCapacity = cap;
+
+  clearDeviceMonitor();
+  Serial.printf("[DEV] Device table: %u slots, %u bytes\n", deviceCapacity, (unsigned)bytes);
+}
+
+void formatDeviceAddress(uint16_t slot, char* out) {
+  uint64_t a = deviceKey[slot] & DEVICE_ADDR_MASK;
+  const char* fmt = (deviceKey[slot] & DEVICE_KEY_BLE) ? "%02x:%02x:%02x:%02x:%02x:%02x"
+                                                       : "%02X:%02X:%02X:%02X:%02X:%02X";
+  sprintf(out, fmt, (uint8_t)(a >> 40), (uint8_t)(a >> 32), (uint8_t)(a >> 24),
+          (uint8_t)(a >> 16), (uint8_t)(a >> 8), (uint8_t)a);
+}
+
+void addOrUpdateWiFiClient(const uint8_t* mac, int8_t rssi, uint8_t channel) {
+  if (!deviceCapacity) return;
+  if (mac[0] & 0x01) return;
+
+  uint64_t addr = 0;
+  for (int i = 0; i < 6; i++) addr = (addr << 8) | mac[i];
+  if (addr == 0 || addr == DEVICE_ADDR_MASK) return;
 
-  for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-    if (monitoredDevices[i].active &&
-        monitoredDevices[i].type == 1 &&
-        strcmp(monitoredDevices[i].bleAddr, address) == 0) {
-      monitoredDevices[i].rssi = rssi;
-      monitoredDevices[i].lastSeen = now;
-      monitoredDevices[i].seenCount++;
-      monitoredDevices[i].isPresent = true;
-
-      if (name && strlen(name) > 0) {
-        strncpy(monitoredDevices[i].name, name, 32);
-        monitoredDevices[i].name[32] = '\0';
-      }
-      return;
+  bool inserted;
+  uint16_t slot = touchDevice(DEVICE_KEY_USED | addr, rssi, millis(), inserted);
+  MonitoredDevice& dev = monitoredDevices[slot];
+  dev.channel = channel;
+  if (inserted) {
+    dev.type = 0;
+    const char* vendor = getVendor((uint8_t*)mac);
+    if (vendor && strlen(vendor) > 0) {
+      strncpy(dev.name, vendor, 32);
+    } else {
+      sprintf(dev.name, "%02X:%02X:%02X", mac[0], mac[1], mac[2]);
     }
+    dev.name[32] = '\0';
   }
+}
 
-  if (monitoredDeviceCount < MAX_MONITORED_DEVICES) {
-    for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-      if (!monitoredDevices[i].active) {
-        monitoredDevices[i].type = 1;
-        strncpy(monitoredDevices[i].bleAddr, address, 17);
-        monitoredDevices[i].bleAddr[17] = '\0';
-
-        if (name && strlen(name) > 0) {
-          strncpy(monitoredDevices[i].name, name, 32);
-        } else {
-          strcpy(monitoredDevices[i].name, "Unknown");
-        }
-        monitoredDevices[i].name[32] = '\0';
-
-        monitoredDevices[i].rssi = rssi;
-        monitoredDevices[i].channel = 0;
-        monitoredDevices[i].firstSeen = now;
-        monitoredDevices[i].lastSeen = now;
-        monitoredDevices[i].seenCount = 1;
-        monitoredDevices[i].isPresent = true;
-        monitoredDevices[i].active = true;
-        monitoredDeviceCount++;
-        return;
-      }
+static bool parseBLEAddress(const char* s, uint64_t& addr) {
+  addr = 0;
+  for (int i = 0; i < 6; i++) {
+    for (int k = 0; k < 2; k++) {
+      char c = *s++;
+      uint8_t v;
+      if (c >= '0' && c <= '9') v = c - '0';
+      else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+      else return false;
+      addr = (addr << 4) | v;
     }
+    if (i < 5 && *s++ != ':') return false;
   }
+  return true;
 }
 
-void checkDeviceTimeouts() {
-  uint32_t now = millis();
+void addOrUpdateBLEDevice(const char* address, const char* name, int8_t rssi) {
+  uint64_t addr;
+  if (!deviceCapacity || !parseBLEAddress(address, addr)) return;
 
-  for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-    if (monitoredDevices[i].active && monitoredDevices[i].isPresent) {
-      if (now - monitoredDevices[i].lastSeen > DEVICE_TIMEOUT_MS) {
-        monitoredDevices[i].isPresent = false;
-      }
-    }
+  bool inserted;
+  uint16_t slot = touchDevice(DEVICE_KEY_USED | DEVICE_KEY_BLE | addr, rssi, millis(), inserted);
+  MonitoredDevice& dev = monitoredDevices[slot];
+  if (inserted) {
+    dev.type = 1;
+    dev.channel = 0;
+    strcpy(dev.name, "Unknown");
+  }
+  if (name && strlen(name) > 0) {
+    strncpy(dev.name, name, 32);
+    dev.name[32] = '\0';
   }
 }
 
-void IRAM_ATTR deviceMonitorSniffer(void* buf, wifi_promiscuous_pkt_type_t type) {
-  const wifi_promiscuous_pkt_t* p = (wifi_promiscuous_pkt_t*)buf;
+// The recency list is ordered by lastSeen, so only its stale tail is walked.
+void checkDeviceTimeouts() {
+  uint32_t now = millis();
 
-  if (p->rx_ctrl.sig_len < 24) return;
+  for (uint16_t s = lruTail; s != DEVICE_NONE; s = lruPrev[s]) {
+    if (now - deviceLastSeen[s] <= DEVICE_TIMEOUT_MS) break;
+    monitoredDevices[s].isPresent = false;
+  }
+}
 
-  const uint8_t* frame = p->payload;
+// The station in a frame: the sender of a probe or (re)association request,
+// or the non-AP end of a data frame with exactly one DS bit set.
+static const uint8_t* IRAM_ATTR clientAddress(const uint8_t* frame) {
   uint8_t frameType = (frame[0] >> 2) & 0x03;
   uint8_t frameSubtype = (frame[0] >> 4) & 0x0F;
 
-  const uint8_t* addr1 = &frame[4];
-  const uint8_t* addr2 = &frame[10];
-
-  int8_t rssi = p->rx_ctrl.rssi;
-  uint8_t channel = p->rx_ctrl.channel;
-
   if (frameType == 0) {
-    if (frameSubtype == 4 || frameSubtype == 0 || frameSubtype == 2) {
-      addOrUpdateWiFiClient(addr2, rssi, channel);
-    }
-  }
-  else if (frameType == 2) {
+    if (frameSubtype == 4 || frameSubtype == 0 || frameSubtype == 2) return &frame[10];
+  } else if (frameType == 2) {
     uint8_t toDS = (frame[1] >> 0) & 0x01;
     uint8_t fromDS = (frame[1] >> 1) & 0x01;
 
-    if (toDS && !fromDS) {
-      addOrUpdateWiFiClient(addr2, rssi, channel);
-    }
-    else if (!toDS && fromDS) {
-      addOrUpdateWiFiClient(addr1, rssi, channel);
-    }
+    if (toDS && !fromDS) return &frame[10];
+    if (!toDS && fromDS) return &frame[4];
+  }
+  return nullptr;
+}
+
+void IRAM_ATTR deviceMonitorSniffer(void* buf, wifi_promiscuous_pkt_type_t type) {
+  SnifferProbe probe(snifferStats[CB_DEVICE_MONITOR]);
+  const wifi_promiscuous_pkt_t* p = (wifi_promiscuous_pkt_t*)buf;
+
+  if (p->rx_ctrl.rx_state != 0) {
+    statsRxError(CB_DEVICE_MONITOR);
+    return;
   }
+  if (p->rx_ctrl.sig_len < 24) {
+    statsDiscard(CB_DEVICE_MONITOR);
+    return;
+  }
+
+  cardinalityObserveWiFi(p, type);
+  if (clientAddress(p->payload)) {
+    ingestPush(CB_DEVICE_MONITOR, p, type, INGEST_CLIENT | INGEST_ASSOC, 24);
+  }
+}
+
+void deviceMonitorDeferred(const IngestFrame& f) {
+  if (f.len < 24) return;
+  const uint8_t* mac = clientAddress(f.payload);
+  if (mac) addOrUpdateWiFiClient(mac, f.rssi, f.channel);
 }
 
 void startDeviceMonitorSniffer() {
   deviceMonitorActive = true;
   monitorChannel = 1;
-  lastChannelHop = millis();
 
   esp_wifi_scan_stop();
   esp_wifi_set_promiscuous(false);
@@ -169,13 +312,12 @@ void startDeviceMonitorSniffer() {
   esp_wifi_set_channel(monitorChannel, WIFI_SECOND_CHAN_NONE);
   esp_wifi_set_promiscuous_rx_cb(deviceMonitorSniffer);
   esp_wifi_set_promiscuous(true);
+  hopStart(HOP_DEVICE_MONITOR, monitorChannel);
 }
 
 void updateDeviceMonitor() {
-  if (deviceMonitorActive && millis() - lastChannelHop > 300) {
-    monitorChannel = (monitorChannel % 13) + 1;
-    esp_wifi_set_channel(monitorChannel, WIFI_SECOND_CHAN_NONE);
-    lastChannelHop = millis();
+  if (deviceMonitorActive && hopUpdate()) {
+    monitorChannel = hopChannel();
   }
 
   extern uint8_t bleDeviceCount;
@@ -195,11 +337,16 @@ void updateDeviceMonitor() {
 
 void clearDeviceMonitor() {
   deviceMonitorActive = false;
-  for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-    monitoredDevices[i].active = false;
-    monitoredDevices[i].isPresent = false;
-    monitoredDevices[i].seenCount = 0;
+  if (deviceCapacity) {
+    memset(deviceKey, 0, deviceCapacity * sizeof(uint64_t));
+    memset(deviceIndex, 0, (1UL << indexBits) * sizeof(uint16_t));
+    memset(monitoredDevices, 0, deviceCapacity * sizeof(MonitoredDevice));
+    for (uint16_t i = 0; i < deviceCapacity; i++) {
+      lruNext[i] = (i + 1 < deviceCapacity) ? i + 1 : DEVICE_NONE;
+    }
+    freeHead = 0;
   }
+  lruHead = lruTail = DEVICE_NONE;
   monitoredDeviceCount = 0;
   deviceCursor = 0;
   deviceScroll = 0;
@@ -3,11 +3,27 @@
 
 #include "config.h"
 
+// Device table: deviceCapacity slots, sized from free heap at boot. A slot is
+// in use when deviceKey[slot] != 0; the key packs the 48-bit MAC/BLE address
+// with the device type.
+extern uint16_t deviceCapacity;
+extern uint64_t* deviceKey;
+extern uint32_t* deviceLastSeen;
+extern int8_t* deviceRssi;
+extern uint16_t* deviceSeenCount;
+extern MonitoredDevice* monitoredDevices;
+extern DeviceTableStats deviceTableStats;
+
+void initDeviceMonitor();
 void updateDeviceMonitor();
 void addOrUpdateWiFiClient(const uint8_t* mac, int8_t rssi, uint8_t channel);
 void addOrUpdateBLEDevice(const char* address, const char* name, int8_t rssi);
 void checkDeviceTimeouts();
 void clearDeviceMonitor();
 void startDeviceMonitorSniffer();
+void deviceMonitorDeferred(const IngestFrame& f);
+
+inline bool deviceActive(uint16_t slot) { return slot < deviceCapacity && deviceKey[slot] != 0; }
+void formatDeviceAddress(uint16_t slot, char* out);
 
 #endif // DEVICE_MONITOR_H
@@ -1,10 +1,13 @@
 #include "display.h"
 #include "wifi_scanner.h"
+#include "karma_detector.h"
+#include "csa_watch.h"
 #include "ble_scanner.h"
 #include "menu.h"
 #include "utils.h"
 #include "security.h"
 #include "power.h"
+#include "profiler.h"
 
 void setRGB(uint32_t color) {
   if (!RGB_ENABLED) return;
@@ -21,11 +24,25 @@ void setRGB(uint32_t color) {
   rgb.show();
 }
 
+// Page-mode drawing goes through these so the profiler can tell building a
+// page apart from pushing it over I2C.
+void oledFirstPage() {
+  profilerPhase(PH_DRAW);
+  oled.firstPage();
+}
+
+bool oledNextPage() {
+  profilerPhase(PH_FLUSH);
+  bool more = oled.nextPage();
+  profilerPhase(more ? PH_DRAW : PH_HANDLER);
+  return more;
+}
+
 void updateRGBStatus() {
   if (!RGB_ENABLED) return;
   if (screenSleeping) return;
 
-  if (attackActive) {
+  if (attackActive || karmaActive || csaAlertActive) {
     setRGB(RGB_RED);
   } else if (signalAlert) {
     setRGB(RGB_CYAN);
@@ -5,6 +5,8 @@
 #include "screens.h"
 
 void setRGB(uint32_t color);
+void oledFirstPage();
+bool oledNextPage();
 void updateRGBStatus();
 
 void drawGrid(uint8_t x0, uint8_t y0, uint8_t width, uint8_t height);
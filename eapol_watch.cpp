@@ -0,0 +1,218 @@
+#include "eapol_watch.h"
+#include "alerts.h"
+#include "hll.h"
+#include <esp_timer.h>
+
+// 802.1X / WPA handshakes per client and AP. Every data frame gets one
+// fixed check: unprotected, and the LLC/SNAP header after the MAC header
+// carries the EAPOL EtherType. Only those frames are read further, and
+// only the EAPOL packet type, the EAP code, the key information bits and
+// the key data length; nonces, MICs and key data are never looked at or
+// kept.
+//
+// The key information bits give the 4-way message number. A handshake
+// starts with message 1 from the AP; one that gets a new message 1
+// instead of the next message failed. An AP that never sends message 3
+// after the client's message 2 rejected it (a wrong passphrase), and one
+// that repeats message 1 had no answer. An EAP-Failure is a failed
+// 802.1X login. A client/AP pair with EAPOL_FAIL_LIMIT failures, or
+// EAPOL_REPEAT_LIMIT handshakes at all, within EAPOL_WINDOW_MS is an
+// auth-failure storm: a misconfigured client, or clients being knocked
+// off and coming back.
+//
+// Pairs sit in a set associative table like the Karma responders; a new
+// pair takes a slot whose window ran out, else the one heard longest ago.
+// The loop reads the table as the callback writes it.
+
+bool authStormActive = false;
+uint32_t authStorms = 0;
+uint32_t eapolFrames = 0;
+uint32_t eapolHandshakes = 0;
+
+static EapolPair pairs[1 << EAPOL_SET_BITS][EAPOL_WAYS];
+static uint32_t lastStormSeen = 0;
+
+#define KEY_INFO_PAIRWISE 0x0008
+#define KEY_INFO_ACK 0x0080
+#define KEY_INFO_MIC 0x0100
+#define KEY_INFO_SECURE 0x0200
+
+static uint32_t IRAM_ATTR setOf(const uint8_t* client, const uint8_t* bssid) {
+  return sketchHash(client, 6, sketchHash(bssid, 6, 0x45415021UL)) >> (32 - EAPOL_SET_BITS);
+}
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static EapolPair* IRAM_ATTR findPair(const uint8_t* client, const uint8_t* bssid) {
+  EapolPair* set = pairs[setOf(client, bssid)];
+  for (int w = 0; w < EAPOL_WAYS; w++) {
+    if (sameMac(set[w].client, client) && sameMac(set[w].bssid, bssid)) return &set[w];
+  }
+  return nullptr;
+}
+
+static void IRAM_ATTR resetCounts(EapolPair* e, uint32_t now) {
+  for (int i = 0; i < 4; i++) e->msgs[i] = 0;
+  e->attempts = 0;
+  e->completed = 0;
+  e->rejected = 0;
+  e->unanswered = 0;
+  e->eapFailures = 0;
+  e->stage = 0;
+  e->reported = false;
+  e->windowStart = now;
+}
+
+static EapolPair* IRAM_ATTR claimPair(const uint8_t* client, const uint8_t* bssid, uint32_t now) {
+  EapolPair* set = pairs[setOf(client, bssid)];
+  EapolPair* e = &set[0];
+  for (int w = 0; w < EAPOL_WAYS; w++) {
+    EapolPair& c = set[w];
+    if (c.windowStart == 0 || now - c.windowStart > EAPOL_WINDOW_MS) {
+      e = &c;
+      break;
+    }
+    if ((int32_t)(c.lastMs - e->lastMs) < 0) e = &c;
+  }
+  resetCounts(e, now);
+  for (int i = 0; i < 6; i++) {
+    e->client[i] = client[i];
+    e->bssid[i] = bssid[i];
+  }
+  return e;
+}
+
+static void IRAM_ATTR bump(uint8_t& c) {
+  if (c < 0xFF) c++;
+}
+
+// Message 1-4 of the 4-way handshake, 0 for group key and other frames.
+// WPA1 does not set Secure on message 4, but sends it without key data.
+static uint8_t IRAM_ATTR keyMessage(const uint8_t* key, const uint8_t* end) {
+  uint16_t info = key[1] << 8 | key[2];
+  if (!(info & KEY_INFO_PAIRWISE)) return 0;
+  if (info & KEY_INFO_ACK) return (info & KEY_INFO_MIC) ? 3 : 1;
+  if (!(info & KEY_INFO_MIC)) return 0;
+  if (info & KEY_INFO_SECURE) return 4;
+  if (key + 95 > end) return 0;
+  return (key[93] | key[94]) ? 2 : 4;
+}
+
+void IRAM_ATTR eapolObserve(const wifi_promiscuous_pkt_t* p) {
+  const uint8_t* f = p->payload;
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (!f || len < 24 + 8 + 4 + 4) return;
+
+  // The constant part: header length from the frame control, then the
+  // eight LLC/SNAP bytes compared in one pass
+  uint8_t fc0 = f[0], fc1 = f[1];
+  uint8_t ds = fc1 & 0x03;
+  if ((fc1 & 0x40) || (fc0 & 0x40) || ds == 0 || ds == 3) return;  // protected, no data, not via an AP
+  uint16_t hdr = 24 + ((fc0 & 0x80) ? 2 : 0) + ((fc0 & 0x80) && (fc1 & 0x80) ? 4 : 0);
+  if (hdr + 8 + 4 + 4 > len) return;
+  const uint8_t* llc = f + hdr;
+  uint8_t diff = (llc[0] ^ 0xAA) | (llc[1] ^ 0xAA) | (llc[2] ^ 0x03) | llc[3] | llc[4] | llc[5] |
+                 (llc[6] ^ 0x88) | (llc[7] ^ 0x8E);
+  if (diff) return;
+
+  eapolFrames++;
+  const uint8_t* eapol = llc + 8;
+  const uint8_t* end = f + len - 4;
+  bool fromAp = ds == 0x02;
+  const uint8_t* client = fromAp ? &f[4] : &f[10];
+  const uint8_t* bssid = fromAp ? &f[10] : &f[4];
+
+  uint8_t msg = 0;
+  bool eapFailure = false;
+  if (eapol[1] == 3 && eapol + 4 + 3 <= end) {  // EAPOL-Key
+    msg = keyMessage(eapol + 4, end);
+  } else if (eapol[1] == 0 && eapol + 4 + 1 <= end) {  // EAP packet
+    eapFailure = fromAp && eapol[4] == 4;
+  }
+  if (!msg && !eapFailure) return;
+
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  EapolPair* e = findPair(client, bssid);
+  if (!e) e = claimPair(client, bssid, now);
+  if (now - e->windowStart > EAPOL_WINDOW_MS) resetCounts(e, now);
+  e->lastMs = now;
+  e->channel = p->rx_ctrl.channel;
+  e->rssi = p->rx_ctrl.rssi;
+
+  if (eapFailure) {
+    bump(e->eapFailures);
+    e->stage = 0;
+    return;
+  }
+  bump(e->msgs[msg - 1]);
+  uint8_t stage = e->stage;
+  if (msg == 1) {
+    if (stage == 1) bump(e->unanswered);
+    else if (stage == 2) bump(e->rejected);
+    bump(e->attempts);
+    e->stage = 1;
+  } else if (msg == 4) {
+    if (stage != 0) {
+      bump(e->completed);
+      eapolHandshakes++;
+    }
+    e->stage = 0;
+  } else if (stage != 0) {
+    e->stage = msg;
+  }
+}
+
+// Failed handshakes in the window, counting the open one once it stalled
+uint8_t eapolFailures(const EapolPair& e) {
+  uint32_t failed = e.rejected + e.unanswered + e.eapFailures;
+  if ((e.stage == 1 || e.stage == 2) && millis() - e.lastMs > EAPOL_ATTEMPT_MS) failed++;
+  return min(failed, (uint32_t)0xFF);
+}
+
+static void raiseStorm(const EapolPair& e, uint8_t failed) {
+  authStorms++;
+  char msg[40];
+  snprintf(msg, 40, "Auth fail %02X:%02X:%02X>%02X:%02X:%02X %u/%u", e.client[3], e.client[4],
+           e.client[5], e.bssid[3], e.bssid[4], e.bssid[5], failed, e.attempts);
+  logEvent(7, msg);
+  Serial.printf("[EAPOL] client %02X:%02X:%02X:%02X:%02X:%02X bssid %02X:%02X:%02X:%02X:%02X:%02X ch%u %d dBm "
+                "handshakes %u completed %u rejected %u unanswered %u eap-failures %u msgs %u/%u/%u/%u\n",
+                e.client[0], e.client[1], e.client[2], e.client[3], e.client[4], e.client[5], e.bssid[0],
+                e.bssid[1], e.bssid[2], e.bssid[3], e.bssid[4], e.bssid[5], e.channel, e.rssi, e.attempts,
+                e.completed, e.rejected, e.unanswered, e.eapFailures, e.msgs[0], e.msgs[1], e.msgs[2],
+                e.msgs[3]);
+}
+
+void updateEapolWatch() {
+  uint32_t now = millis();
+  for (int s = 0; s < (1 << EAPOL_SET_BITS); s++) {
+    for (int w = 0; w < EAPOL_WAYS; w++) {
+      EapolPair& e = pairs[s][w];
+      if (e.windowStart == 0 || now - e.windowStart > EAPOL_WINDOW_MS) continue;
+      uint8_t failed = eapolFailures(e);
+      if (failed < EAPOL_FAIL_LIMIT && e.attempts < EAPOL_REPEAT_LIMIT) continue;
+      lastStormSeen = now;
+      if (!e.reported) {
+        e.reported = true;
+        raiseStorm(e, failed);
+      }
+    }
+  }
+  authStormActive = authStorms && now - lastStormSeen <= EAPOL_HOLD_MS;
+}
+
+bool eapolFlagged(const uint8_t* client, const uint8_t* bssid) {
+  const EapolPair* e = findPair(client, bssid);
+  return e && e->reported;
+}
+
+const EapolPair* eapolPairAt(uint16_t i) {
+  if (i >= EAPOL_PAIRS) return nullptr;
+  const EapolPair* e = &pairs[i / EAPOL_WAYS][i % EAPOL_WAYS];
+  return e->windowStart ? e : nullptr;
+}
@@ -0,0 +1,20 @@
+#ifndef EAPOL_WATCH_H
+#define EAPOL_WATCH_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+#define EAPOL_PAIRS ((1 << EAPOL_SET_BITS) * EAPOL_WAYS)
+
+extern bool authStormActive;
+extern uint32_t authStorms;
+extern uint32_t eapolFrames;
+extern uint32_t eapolHandshakes;
+
+void IRAM_ATTR eapolObserve(const wifi_promiscuous_pkt_t* p);
+void updateEapolWatch();
+uint8_t eapolFailures(const EapolPair& e);
+bool eapolFlagged(const uint8_t* client, const uint8_t* bssid);
+const EapolPair* eapolPairAt(uint16_t i);
+
+#endif // EAPOL_WATCH_H
@@ -14,12 +14,23 @@
 #include "alerts.h"
 #include "power.h"
 #include "device_monitor.h"
+#include "hop_planner.h"
+#include "sniffer_stats.h"
+#include "profiler.h"
+#include "ingest.h"
+#include "deauth_detector.h"
+#include "flood_detector.h"
+#include "karma_detector.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
+#include "cardinality.h"
+#include "assoc_graph.h"
 
 U8G2_SSD1306_128X64_NONAME_1_HW_I2C oled(U8G2_R0, U8X8_PIN_NONE, 5, 4);
 Adafruit_NeoPixel rgb(RGB_LED_COUNT, RGB_LED_PIN, NEO_GRB + NEO_KHZ800);
 Preferences prefs;
 
-Settings settings = {1, -70, 50, true, false, 10, 60};
+Settings settings = {1, -70, 50, true, false, 10, 60, 0, 500};
 Screen currentScreen = SCREEN_MENU;
 
 uint8_t autoModeView = 0;
@@ -29,9 +40,14 @@ uint16_t autoTotalAPs = 0;
 uint16_t autoTotalBLE = 0;
 
 uint8_t whySlowView = 0;
+uint8_t diagView = 0;
 RSSIHistory rssiHistory[MAX_TRACKED_APS];
 uint32_t lastRSSISample = 0;
 
+uint8_t monitorView = 0;  // 0 = graph, 1 = top talkers
+uint8_t talkerKey = 0;    // TalkerKey shown in the top talkers view
+uint8_t apDetailView = 0;  // 0 = info, 1 = clients
+
 uint8_t rfHealthView = 0;
 int8_t rfHealthRSSIHistory[60]; // 60 samples of avg RSSI
 uint8_t rfHealthHistoryIndex = 0;
@@ -45,6 +61,7 @@ int8_t walkMinRSSI = 0;
 int8_t walkMaxRSSI = -100;
 int32_t walkRSSISum = 0;
 uint16_t walkSampleCount = 0;
+int8_t walkLoss = -1;        // beacon loss while listening between scans
 uint8_t walkTargetBSSID[6];  // Store BSSID instead of index
 char walkTargetSSID[33];     // Store SSID for display
 String walkTargetBLEAddr = "";
@@ -59,14 +76,11 @@ Baseline baseline = {0, 0, 0, {0}, 0, false};
 Baseline currentSnapshot = {0, 0, 0, {0}, 0, false};
 uint32_t lastEnvCheck = 0;
 uint32_t lastBaselineUpdate = 0;
-bool prevAttackActive = false;
-uint8_t prevRogueCount = 0;
 
-MonitoredDevice monitoredDevices[MAX_MONITORED_DEVICES];
-uint8_t monitoredDeviceCount = 0;
+uint16_t monitoredDeviceCount = 0;
 uint8_t deviceCursor = 0;
-uint8_t deviceScroll = 0;
-uint8_t deviceSelectedIndex = 0;
+uint16_t deviceScroll = 0;
+uint16_t deviceSelectedIndex = 0;
 
 uint8_t displaySettingCursor = 0;
 
@@ -143,6 +157,7 @@ void setup() {
   delay(100);
 
   loadSettings();
+  loadTrustedAPs();
 
   if (RGB_ENABLED) {
     rgb.begin();
@@ -152,13 +167,13 @@ void setup() {
   oled.begin();
   oled.setContrast(128);
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(10, 25, "Wi-Fi Analyzer");
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawStr(15, 40, "Initializing...");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 
   delay(100);
 
@@ -168,6 +183,9 @@ void setup() {
   initBLE();
   Serial.println("[INIT] BLE ready");
 
+  initDeviceMonitor();
+  clearAssociations();
+
   resetSession();
   drawMenu();
 
@@ -177,7 +195,9 @@ void setup() {
 }
 
 void loop() {
+  profilerLoopBegin(currentScreen);
   ButtonEvent ev = updateButton();
+  profilerPhase(PH_HANDLER);
 
   if (ev == BTN_BACK_LONG) {
     enterDeepSleep();
@@ -222,17 +242,17 @@ void loop() {
     }
   }
 
-  if (millis() - lastDeauthCheck > 1000) {
-    deauthPerSecond = pktDeauth - lastDeauthCount;
-    lastDeauthCount = pktDeauth;
-    lastDeauthCheck = millis();
+  drainIngest();
 
-    if (deauthPerSecond > settings.deauthThreshold) {
-      attackActive = true;
-    } else if (deauthPerSecond == 0 && attackActive) {
-      attackActive = false;
-    }
-  }
+  updateDeauthRate();
+  updateFloodDetector();
+  updateKarmaDetector();
+  updateCsaWatch();
+  updateEapolWatch();
+  updateCardinality();
+  updateAssociations();
+
+  updateSnifferStats();
 
   signalAlert = (avgRssi > settings.rssiThreshold);
   updateRGBStatus();
@@ -255,6 +275,7 @@ void loop() {
           currentChannel = 1;
           resetLiveStats();
           enterSnifferMode(currentChannel);
+          hopStart(HOP_AUTO_WATCH, currentChannel);
           startBLEScan();
           drawAutoWatch();
           break;
@@ -265,6 +286,7 @@ void loop() {
         case 2:
           currentScreen = SCREEN_MONITOR;
           frozen = false;
+          monitorView = 0;
           currentChannel = 1;
           resetLiveStats();
           enterSnifferMode(currentChannel);
@@ -274,6 +296,7 @@ void loop() {
           selectedChannel = 1;
           resetAnalyzer();
           enterSnifferMode(1);
+          hopStart(analyzerHopProfile(settings.scanSpeed), 1);
           break;
         case 4:
           currentScreen = SCREEN_DEVICE_MONITOR;
@@ -323,7 +346,7 @@ void loop() {
           break;
       }
     }
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -338,6 +361,7 @@ void loop() {
           currentScreen = SCREEN_DEAUTH_WATCH;
           currentChannel = 1;
           enterSnifferMode(currentChannel);
+          hopStart(HOP_DEAUTH_WATCH, currentChannel);
           break;
         case 1:
           currentScreen = SCREEN_ROGUE_AP_WATCH;
@@ -357,43 +381,43 @@ void loop() {
       currentScreen = SCREEN_MENU;
       drawMenu();
     }
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_INSIGHTS_MENU) {
     handleInsightsMenu(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_HISTORY_MENU) {
     handleHistoryMenu(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_SYSTEM_MENU) {
     handleSystemMenu(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_AUTO_WATCH) {
     handleAutoWatch(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_RF_HEALTH) {
     if (ev == BTN_LONG) {
-      rfHealthView = (rfHealthView + 1) % 2;
+      rfHealthView = (rfHealthView + 1) % 3;
     }
 
     if (millis() - lastScan > 2000) {
       enterScanMode();
       startApScan();
-      delay(1500);
+      waitForScan(1500);
       fetchApResults(false);
       updateBLEScan();
 
@@ -424,31 +448,31 @@ void loop() {
     }
 
     drawRFHealth();
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_DEVICE_MONITOR) {
     handleDeviceMonitor(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_DEVICE_DETAIL) {
     handleDeviceDetail(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_AP_WALK_TEST) {
     handleAPWalkTest(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_BLE_WALK_TEST) {
     handleBLEWalkTest(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -477,87 +501,61 @@ void loop() {
       alertLevel = 0;
       setRGB(RGB_GREEN);
     }
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_ALERT_SETTINGS) {
-    static uint8_t settingIndex = 0;
-
-    if (ev == BTN_SHORT) {
-      settingIndex = (settingIndex + 1) % 2;
-    } else if (ev == BTN_LONG) {
-      switch (settingIndex) {
-        case 0:
-          settings.deauthThreshold = (settings.deauthThreshold + 5) % 55;
-          if (settings.deauthThreshold == 0) settings.deauthThreshold = 5;
-          break;
-        case 1:
-          if (settings.screenTimeout == 0) settings.screenTimeout = 30;
-          else if (settings.screenTimeout == 30) settings.screenTimeout = 60;
-          else if (settings.screenTimeout == 60) settings.screenTimeout = 120;
-          else if (settings.screenTimeout == 120) settings.screenTimeout = 300;
-          else settings.screenTimeout = 0;
-          break;
-      }
-    }
-
-    drawAlertSettings();
-
-    if (ev == BTN_BACK) {
-      saveSettings();
-      currentScreen = SCREEN_SECURITY_MENU;
-      drawSecurityMenu();
-    }
-    delay(40);
+    handleAlertSettings(ev);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_WHY_IS_IT_SLOW) {
     handleWhyIsItSlow(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_CHANNEL_RECOMMENDATION) {
     handleChannelRecommendation(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_ENVIRONMENT_CHANGE) {
     handleEnvironmentChange(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_QUICK_SNAPSHOT) {
     handleQuickSnapshot(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_CHANNEL_SCORECARD) {
     handleChannelScorecard(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_EVENT_LOG) {
     handleEventLog(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_BASELINE_COMPARE) {
     handleBaselineCompare(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_EXPORT) {
     handleExport(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -579,7 +577,7 @@ void loop() {
       currentScreen = SCREEN_SYSTEM_MENU;
       drawSystemMenu();
     }
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -596,7 +594,7 @@ void loop() {
       currentScreen = SCREEN_SYSTEM_MENU;
       drawSystemMenu();
     }
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -608,89 +606,31 @@ void loop() {
       currentScreen = SCREEN_SYSTEM_MENU;
       drawSystemMenu();
     }
-    delay(40);
+    loopDelay(40);
+    return;
+  }
+
+  if (currentScreen == SCREEN_DIAGNOSTICS) {
+    handleDiagnostics(ev);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_POWER_MODE) {
     handlePowerMode(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_DEAUTH_WATCH) {
-    static uint32_t lastChannelHop = 0;
-    if (millis() - lastChannelHop > 500) {
-      currentChannel = (currentChannel % MAX_CHANNEL) + 1;
-      enterSnifferMode(currentChannel);
-      lastChannelHop = millis();
-    }
-
-    totalDeauthDetected = pktDeauth;
-
-    if (attackActive) {
-      alertLevel = 2;
-    } else if (deauthPerSecond > 0) {
-      alertLevel = 1;
-    } else {
-      alertLevel = 0;
-    }
-    updateAlertLED();
-
-    if (attackActive && !prevAttackActive) {
-      char msg[40];
-      snprintf(msg, 40, "Deauth attack! Ch%d %lu/sec", currentChannel, deauthPerSecond);
-      logEvent(0, msg);
-    }
-    prevAttackActive = attackActive;
-
-    drawDeauthWatch();
-    if (ev == BTN_BACK) {
-      currentScreen = SCREEN_SECURITY_MENU;
-      stopAllWifi();
-      drawSecurityMenu();
-      alertLevel = 0;
-      setRGB(RGB_GREEN);
-    }
-    delay(40);
+    handleDeauthWatch(ev);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_ROGUE_AP_WATCH) {
-    if (millis() - lastScan > 3000) {
-      fetchApResults(false);
-      uint8_t oldRogueCount = rogueCount;
-      detectRogueAPs();
-
-      if (rogueCount > prevRogueCount) {
-        for (int i = prevRogueCount; i < rogueCount; i++) {
-          char msg[40];
-          snprintf(msg, 40, "Rogue AP: %.15s", rogueList[i].ssid);
-          logEvent(1, msg);
-        }
-      }
-      prevRogueCount = rogueCount;
-
-      startApScan();
-      lastScan = millis();
-    }
-
-    if (rogueCount > 0) {
-      alertLevel = 2;
-    } else {
-      alertLevel = 0;
-    }
-    updateAlertLED();
-
-    drawRogueAPWatch();
-    if (ev == BTN_BACK) {
-      currentScreen = SCREEN_SECURITY_MENU;
-      stopAllWifi();
-      drawSecurityMenu();
-      alertLevel = 0;
-      setRGB(RGB_GREEN);
-    }
-    delay(40);
+    handleRogueAPWatch(ev);
+    loopDelay(40);
     return;
   }
 
@@ -707,6 +647,7 @@ void loop() {
 
     if (ev == BTN_LONG && apCount > 0) {
       apSelectedIndex = apScroll + apCursor;
+      apDetailView = 0;
       currentScreen = SCREEN_AP_DETAIL;
     }
 
@@ -724,13 +665,13 @@ void loop() {
     }
 
     drawApList();
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_AP_DETAIL) {
     if (ev == BTN_SHORT) {
-      currentScreen = SCREEN_AP_LIST;
+      apDetailView = (apDetailView + 1) % 2;
     }
     if (ev == BTN_LONG) {
       if (apSelectedIndex < apCount) {
@@ -743,6 +684,7 @@ void loop() {
         walkMaxRSSI = -100;
         walkRSSISum = 0;
         walkSampleCount = 0;
+        walkLoss = -1;
         walkTestActive = true;
         memset(walkRSSIHistory, 0, sizeof(walkRSSIHistory));
         currentScreen = SCREEN_AP_WALK_TEST;
@@ -754,7 +696,7 @@ void loop() {
       drawApList();
     }
     drawApDetail();
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -771,39 +713,17 @@ void loop() {
       drawMenu();
     }
     drawCompare();
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_HIDDEN_SSID) {
-    static uint32_t lastHop = 0;
-    if (millis() - lastHop > 200) {
-      currentChannel = (currentChannel % MAX_CHANNEL) + 1;
-      enterSnifferMode(currentChannel);
-      lastHop = millis();
-    }
-
-    if (ev == BTN_SHORT && hiddenCount > 0) {
-      if (hiddenScroll + hiddenCursor + 1 < hiddenCount) {
-        if (hiddenCursor < AP_VISIBLE - 1) hiddenCursor++;
-        else hiddenScroll++;
-      } else {
-        hiddenCursor = 0;
-        hiddenScroll = 0;
-      }
-    }
-
-    if (ev == BTN_BACK) {
-      currentScreen = SCREEN_MENU;
-      stopAllWifi();
-      drawMenu();
-    }
-
-    drawHiddenSSID();
-    delay(40);
+    handleHiddenSSID(ev);
+    loopDelay(40);
     return;
   }
 
+
   if (currentScreen == SCREEN_STATS) {
     if (ev == BTN_SHORT) {
       currentScreen = SCREEN_MENU;
@@ -815,60 +735,25 @@ void loop() {
     }
 
     drawStats();
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_MONITOR) {
-    if (ev == BTN_SHORT && !frozen) {
-      currentChannel = currentChannel % MAX_CHANNEL + 1;
-      resetLiveStats();
-      enterSnifferMode(currentChannel);
-    }
-
-    if (ev == BTN_LONG) {
-      frozen = !frozen;
-    }
-
-    if (ev == BTN_BACK) {
-      currentScreen = SCREEN_MENU;
-      stopAllWifi();
-      drawMenu();
-      return;
-    }
-
-    if (!frozen && millis() - lastSecond >= 1000) {
-      uint32_t d = pktTotal - lastPkt;
-      lastPkt = pktTotal;
-      smoothPps = 0.7 * smoothPps + 0.3 * d;
-      pps = (uint32_t)smoothPps;
-      peak = max(peak, pps);
-      peakPPS = max(peakPPS, pps);
-      history[histIdx] = pps;
-      histIdx = (histIdx + 1) % HISTORY_SIZE;
-
-      if (rssiCount) {
-        float r = (float)rssiAccum / rssiCount;
-        avgRssi = 0.8 * avgRssi + 0.2 * r;
-        rssiAccum = rssiCount = 0;
-      }
-      lastSecond = millis();
-    }
-
-    drawMonitor();
-    delay(40);
+    handleMonitor(ev);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_ANALYZER) {
     handleAnalyzer(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
   if (currentScreen == SCREEN_BLE_SCAN) {
     handleBLEScan(ev);
-    delay(40);
+    loopDelay(40);
     return;
   }
 
@@ -901,7 +786,7 @@ void loop() {
     }
 
     drawBLEDetail();
-    delay(40);
+    loopDelay(40);
     return;
   }
 }
@@ -0,0 +1,144 @@
+#include "flood_detector.h"
+#include "alerts.h"
+#include "hll.h"
+
+// Beacon flood / SSID spam detection in constant memory. The callback
+// hashes each beacon's BSSID into a count-min sketch and a HyperLogLog,
+// and its SSID into a second HyperLogLog: three hashes and a few byte
+// stores, no allocation. The loop swaps to the other sketch when the
+// window reaches FLOOD_WINDOW_MS or the radio hops, and scores the
+// finished one. A beacon racing the swap can land in the sketch being
+// scored; it is one beacon out of a window.
+//
+// Windows cover one channel, so the distinct BSSIDs and SSIDs in them are
+// compared against that channel's own baseline, averaged over its first
+// windows and then tracked slowly while the channel is quiet. A flood
+// raises when either count exceeds FLOOD_FACTOR times the baseline (and
+// FLOOD_MIN_DISTINCT), or when one BSSID sends more than
+// FLOOD_BEACON_RATE_MAX beacons a second. A channel without a baseline yet
+// is held to FLOOD_MIN_DISTINCT alone. A window over the limit is never
+// folded into the baseline, so a flood is not learned as normal. Nor is one
+// the loop stretched past FLOOD_MAX_WINDOW_MS (a blocking AP or BLE scan):
+// the radio may have been off for part of it, which only lowers its counts,
+// so it may still raise but says nothing about the quiet level.
+
+bool beaconFloodActive = false;
+uint8_t floodChannel = 0;
+uint16_t floodBssids = 0;
+uint16_t floodSsids = 0;
+uint16_t floodTopRate = 0;
+uint8_t floodTopBssid[6];
+
+static FloodSketch sketches[2];
+static volatile uint8_t writeSketch = 0;
+static uint32_t windowStart = 0;
+static float baseBssids[MAX_CHANNEL + 1];
+static float baseSsids[MAX_CHANNEL + 1];
+static uint8_t learned[MAX_CHANNEL + 1];
+static uint8_t calmWindows = 0;
+static uint32_t lastFloodWindow = 0;
+
+void IRAM_ATTR floodObserveBeacon(const wifi_promiscuous_pkt_t* p) {
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (len < 24) return;
+
+  FloodSketch& s = sketches[writeSketch];
+  const uint8_t* bssid = &p->payload[16];
+  if (!s.beacons) s.channel = p->rx_ctrl.channel;
+  s.lastChannel = p->rx_ctrl.channel;
+  // The radio hopped and the loop has yet to close the window
+  if (s.lastChannel != s.channel) return;
+  s.beacons++;
+
+  uint32_t h = sketchHash(bssid, 6, 0);
+  uint8_t est = 0xFF;
+  for (uint8_t row = 0; row < FLOOD_CMS_DEPTH; row++) {
+    uint8_t& c = s.cms[row][(h >> (row * 8)) & 0xFF];
+    if (c < 0xFF) c++;
+    if (c < est) est = c;
+  }
+  if (est > s.topCount) {
+    s.topCount = est;
+    memcpy(s.topBssid, bssid, 6);
+  }
+  hllAdd(s.bssidHll, FLOOD_HLL_BITS, sketchHash(bssid, 6, 0x9E3779B9UL));
+
+  // SSID element right after the 12 fixed bytes; hidden SSIDs are skipped
+  const uint8_t* ie = &p->payload[36];
+  if (len < 38 || ie[0] != 0 || ie[1] == 0 || ie[1] > MAX_SSID_LEN || 38 + ie[1] > len) return;
+  if (ie[2] == 0) return;
+  hllAdd(s.ssidHll, FLOOD_HLL_BITS, sketchHash(&ie[2], ie[1], 0x7F4A7C15UL));
+}
+
+static void raiseFlood(uint8_t ch, float bssidLimit) {
+  beaconFloodActive = true;
+  floodChannel = ch;
+  char msg[40];
+  if (floodTopRate > FLOOD_BEACON_RATE_MAX && floodBssids <= bssidLimit) {
+    snprintf(msg, 40, "Beacon spam Ch%d %02X:%02X:%02X %u/s", ch, floodTopBssid[3], floodTopBssid[4],
+             floodTopBssid[5], floodTopRate);
+  } else {
+    snprintf(msg, 40, "Beacon flood Ch%d %u BSS %u SSID", ch, floodBssids, floodSsids);
+  }
+  logEvent(3, msg);
+  Serial.printf("[FLOOD] Ch%d %u BSSIDs %u SSIDs (baseline %u/%u), top %02X:%02X:%02X:%02X:%02X:%02X %u/s\n",
+                ch, floodBssids, floodSsids, (unsigned)(baseBssids[ch] + 0.5f), (unsigned)(baseSsids[ch] + 0.5f),
+                floodTopBssid[0], floodTopBssid[1], floodTopBssid[2], floodTopBssid[3], floodTopBssid[4],
+                floodTopBssid[5], floodTopRate);
+}
+
+static void scoreWindow(const FloodSketch& s, uint32_t elapsed, uint32_t now) {
+  uint8_t ch = s.channel;
+  if (ch == 0 || ch > MAX_CHANNEL) return;
+  floodBssids = hllEstimate(s.bssidHll, FLOOD_HLL_REGS);
+  floodSsids = hllEstimate(s.ssidHll, FLOOD_HLL_REGS);
+  floodTopRate = s.topCount * 1000UL / elapsed;
+  memcpy(floodTopBssid, s.topBssid, 6);
+
+  // Until a channel has a baseline only the absolute floor applies
+  float bssidLimit = FLOOD_MIN_DISTINCT, ssidLimit = FLOOD_MIN_DISTINCT;
+  if (learned[ch]) {
+    bssidLimit = max(FLOOD_FACTOR * baseBssids[ch], (float)FLOOD_MIN_DISTINCT);
+    ssidLimit = max(FLOOD_FACTOR * baseSsids[ch], (float)FLOOD_MIN_DISTINCT);
+  }
+  bool over = floodBssids > bssidLimit || floodSsids > ssidLimit || floodTopRate > FLOOD_BEACON_RATE_MAX;
+
+  if (over) {
+    calmWindows = 0;
+    lastFloodWindow = now;
+    if (!beaconFloodActive) raiseFlood(ch, bssidLimit);
+    return;
+  }
+  if (elapsed > FLOOD_MAX_WINDOW_MS) return;
+
+  if (beaconFloodActive && ch == floodChannel) {
+    if (++calmWindows >= FLOOD_COOLDOWN_WINDOWS) beaconFloodActive = false;
+    return;
+  }
+  if (learned[ch] < FLOOD_LEARN_WINDOWS) {
+    learned[ch]++;
+    baseBssids[ch] += (floodBssids - baseBssids[ch]) / learned[ch];
+    baseSsids[ch] += (floodSsids - baseSsids[ch]) / learned[ch];
+  } else {
+    baseBssids[ch] += (floodBssids - baseBssids[ch]) / 8;
+    baseSsids[ch] += (floodSsids - baseSsids[ch]) / 8;
+  }
+}
+
+void updateFloodDetector() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - windowStart;
+  FloodSketch& s = sketches[writeSketch];
+  if (elapsed < FLOOD_WINDOW_MS && s.lastChannel == s.channel) return;
+
+  uint8_t done = writeSketch;
+  writeSketch = done ^ 1;
+  windowStart = now;
+
+  if (s.beacons >= FLOOD_MIN_BEACONS && elapsed >= FLOOD_MIN_WINDOW_MS) {
+    scoreWindow(s, elapsed, now);
+  }
+  memset(&s, 0, sizeof(s));
+
+  if (beaconFloodActive && now - lastFloodWindow > FLOOD_HOLD_MS) beaconFloodActive = false;
+}
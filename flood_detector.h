@@ -0,0 +1,17 @@
+#ifndef FLOOD_DETECTOR_H
+#define FLOOD_DETECTOR_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+extern bool beaconFloodActive;
+extern uint8_t floodChannel;
+extern uint16_t floodBssids;
+extern uint16_t floodSsids;
+extern uint16_t floodTopRate;
+extern uint8_t floodTopBssid[6];
+
+void IRAM_ATTR floodObserveBeacon(const wifi_promiscuous_pkt_t* p);
+void updateFloodDetector();
+
+#endif // FLOOD_DETECTOR_H
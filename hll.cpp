@@ -0,0 +1,26 @@
+#include "hll.h"
+
+uint16_t hllEstimate(const uint8_t* regs, uint16_t m) {
+  float sum = 0;
+  uint16_t zeros = 0;
+  for (uint16_t i = 0; i < m; i++) {
+    sum += 1.0f / (float)(1UL << regs[i]);
+    if (regs[i] == 0) zeros++;
+  }
+  float alpha = 0.7213f / (1 + 1.079f / m);
+  if (m == 16) alpha = 0.673f;
+  else if (m == 32) alpha = 0.697f;
+  else if (m == 64) alpha = 0.709f;
+
+  float e = alpha * m * m / sum;
+  if (e <= 2.5f * m && zeros) e = m * logf((float)m / zeros);  // linear counting
+  return (uint16_t)min(e + 0.5f, 65535.0f);
+}
+
+// Registers of the union of two sketches: a sketch per channel or per
+// minute merges into one for all channels or a longer window.
+void hllMerge(uint8_t* dst, const uint8_t* src, uint16_t m) {
+  for (uint16_t i = 0; i < m; i++) {
+    if (src[i] > dst[i]) dst[i] = src[i];
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef HLL_H
+#define HLL_H
+
+#include "config.h"
+#include <esp_attr.h>
+
+// Hashing and HyperLogLog registers for the sketches the promiscuous
+// callbacks update. Inline and IRAM-safe: the rank is counted by hand
+// because __builtin_clz may call into flash libgcc.
+
+static inline uint32_t IRAM_ATTR sketchHash(const uint8_t* b, uint8_t len, uint32_t seed) {
+  uint32_t h = 2166136261UL ^ seed;  // FNV-1a, finished with a murmur mix
+  for (uint8_t i = 0; i < len; i++) h = (h ^ b[i]) * 16777619UL;
+  h ^= h >> 16;
+  h *= 0x85EBCA6BUL;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35UL;
+  h ^= h >> 16;
+  return h;
+}
+
+// Register index from the top bits, rank = position of the first set bit
+// in the rest.
+static inline void IRAM_ATTR hllAdd(uint8_t* regs, uint8_t bits, uint32_t h) {
+  uint32_t idx = h >> (32 - bits);
+  uint32_t w = h << bits;
+  uint8_t rank = 1;
+  while (!(w & 0x80000000UL) && rank <= 32 - bits) {
+    w <<= 1;
+    rank++;
+  }
+  if (rank > regs[idx]) regs[idx] = rank;
+}
+
+uint16_t hllEstimate(const uint8_t* regs, uint16_t m);
+void hllMerge(uint8_t* dst, const uint8_t* src, uint16_t m);
+
+#endif // HLL_H
@@ -0,0 +1,191 @@
+#include "hop_planner.h"
+#include "wifi_scanner.h"
+#include "device_monitor.h"
+
+// One channel-hop schedule for every screen that sweeps the band.
+//
+// Each channel has a weight built from its measured busy time, the APs
+// the last scan put there and the clients Device Monitor has seen on it.
+// The next channel is the one with the largest age * weight, so equal
+// weights degrade to a plain round robin. Weight gives way once the
+// channels falling due could no longer all be reached within the maximum
+// revisit interval if visited oldest first; the oldest is then taken. The
+// dwell on the chosen channel scales with its share of the total weight.
+// Only the channel just left is re-weighted on a hop, which keeps the
+// plan current without rebuilding it.
+
+const HopProfile HOP_AUTO_WATCH = {500, 1000, 1500, 17000, 1, 11};
+const HopProfile HOP_DEAUTH_WATCH = {250, 400, 600, 8000, 1, MAX_CHANNEL};
+const HopProfile HOP_HIDDEN_SSID = {100, 200, 600, 8000, 1, MAX_CHANNEL};
+const HopProfile HOP_DEVICE_MONITOR = {150, 300, 600, 8000, 1, MAX_CHANNEL};
+
+static HopProfile profile = HOP_DEAUTH_WATCH;
+static uint8_t hopCh = 1;
+static uint16_t dwellMs = 0;
+static uint32_t dwellStart = 0;
+static uint8_t weight[MAX_CHANNEL + 1];
+static uint16_t weightSum = 0;
+static ChannelCoverage coverage[MAX_CHANNEL + 1];
+static uint32_t coverageStart = 0;
+
+HopProfile analyzerHopProfile(uint8_t scanSpeed) {
+  uint16_t base = 30;
+  if (scanSpeed == 0) base = 15;       // Fast
+  else if (scanSpeed == 2) base = 50;  // Slow
+  HopProfile p = {(uint16_t)(base / 2), base, (uint16_t)(base * 3), 2000, 1, MAX_CHANNEL};
+  return p;
+}
+
+static uint8_t channelWeight(uint8_t ch) {
+  uint32_t w = 4 + channelLoad(ch) / 10;
+
+  for (int i = 0; i < apCount; i++) {
+    if (apList[i].primary == ch) w += 2;
+  }
+  for (uint16_t i = 0; i < deviceCapacity && w < 32; i++) {
+    if (deviceActive(i) && monitoredDevices[i].type == 0 &&
+        monitoredDevices[i].isPresent && monitoredDevices[i].channel == ch) {
+      w++;
+    }
+  }
+  return min(w, (uint32_t)32);
+}
+
+static void reweigh(uint8_t ch) {
+  weightSum -= weight[ch];
+  weight[ch] = channelWeight(ch);
+  weightSum += weight[ch];
+}
+
+static uint16_t dwellFor(uint8_t ch) {
+  uint8_t n = profile.lastCh - profile.firstCh + 1;
+  uint32_t d = (uint32_t)profile.baseDwellMs * weight[ch] * n / weightSum;
+  return constrain(d, profile.minDwellMs, profile.maxDwellMs);
+}
+
+static uint8_t pickNext(uint32_t now) {
+  uint8_t n = profile.lastCh - profile.firstCh + 1;
+  uint8_t best = hopCh;
+  uint32_t bestScore = 0;
+  uint8_t oldest = hopCh;
+  uint32_t oldestAge = 0;
+  uint32_t ages[MAX_CHANNEL];  // of the waiting channels, oldest first
+  uint16_t dwells[MAX_CHANNEL];
+  uint8_t waiting = 0;
+
+  // Start after the current channel so ties fall through in band order
+  uint8_t ch = hopCh;
+  for (uint8_t k = 0; k < n; k++) {
+    ch = (ch >= profile.lastCh) ? profile.firstCh : ch + 1;
+    if (ch == hopCh) continue;
+
+    uint32_t age = now - coverage[ch].lastVisit;
+    uint8_t i = waiting++;
+    for (; i > 0 && ages[i - 1] < age; i--) {
+      ages[i] = ages[i - 1];
+      dwells[i] = dwells[i - 1];
+    }
+    ages[i] = age;
+    dwells[i] = dwellFor(ch);
+    if (age > oldestAge || oldest == hopCh) {
+      oldest = ch;
+      oldestAge = age;
+    }
+    uint32_t score = age * weight[ch];
+    if (score > bestScore || best == hopCh) {
+      bestScore = score;
+      best = ch;
+    }
+  }
+
+  // Taken oldest first after a detour to best, each channel waits out best's
+  // dwell and those of the channels older than it; once one of them would
+  // miss the interval the detour is off
+  uint32_t wait = dwellFor(best);
+  for (uint8_t i = 0; i < waiting; i++) {
+    if (ages[i] + wait >= profile.maxRevisitMs) return oldest;
+    wait += dwells[i];
+  }
+  return best;
+}
+
+static void leaveChannel(uint32_t now) {
+  ChannelCoverage& c = coverage[hopCh];
+  c.dwellMs += now - dwellStart;
+  c.lastVisit = now;
+}
+
+static void enterChannel(uint8_t ch, uint32_t now) {
+  ChannelCoverage& c = coverage[ch];
+  uint32_t gap = now - c.lastVisit;
+  if (gap > c.maxGapMs) c.maxGapMs = gap;
+  c.visits++;
+  hopCh = ch;
+  dwellStart = now;
+  dwellMs = dwellFor(ch);
+}
+
+void hopStart(const HopProfile& p, uint8_t startCh) {
+  profile = p;
+  uint32_t now = millis();
+  memset(coverage, 0, sizeof(coverage));
+  memset(weight, 0, sizeof(weight));
+  weightSum = 0;
+  for (uint8_t ch = profile.firstCh; ch <= profile.lastCh; ch++) {
+    coverage[ch].lastVisit = now;
+    reweigh(ch);
+  }
+  coverageStart = now;
+  if (startCh < profile.firstCh || startCh > profile.lastCh) startCh = profile.firstCh;
+  enterChannel(startCh, now);
+}
+
+bool hopUpdate() {
+  uint32_t now = millis();
+  if (now - dwellStart < dwellMs) return false;
+
+  leaveChannel(now);
+  reweigh(hopCh);
+  uint8_t next = pickNext(now);
+  enterChannel(next, now);
+  setSnifferChannel(next);
+  return true;
+}
+
+// The caller took the radio away (e.g. for a blocking AP scan) and has
+// re-tuned to hopChannel(); restart the dwell instead of counting the gap.
+void hopResume() {
+  dwellStart = millis();
+}
+
+uint8_t hopChannel() {
+  return hopCh;
+}
+
+uint16_t hopDwellMs() {
+  return dwellMs;
+}
+
+const ChannelCoverage* hopCoverage(uint8_t ch) {
+  if (ch == 0 || ch > MAX_CHANNEL) return nullptr;
+  return &coverage[ch];
+}
+
+uint8_t hopCoveragePct(uint8_t ch) {
+  uint32_t elapsed = millis() - coverageStart;
+  if (ch == 0 || ch > MAX_CHANNEL || elapsed == 0) return 0;
+  uint32_t d = coverage[ch].dwellMs;
+  if (ch == hopCh) d += millis() - dwellStart;
+  return min(d * 100 / elapsed, (uint32_t)100);
+}
+
+uint32_t hopWorstGapMs() {
+  uint32_t now = millis();
+  uint32_t worst = 0;
+  for (uint8_t ch = profile.firstCh; ch <= profile.lastCh; ch++) {
+    uint32_t gap = coverage[ch].maxGapMs;
+    if (ch != hopCh) gap = max(gap, now - coverage[ch].lastVisit);
+    worst = max(worst, gap);
+  }
+  return worst;
+}
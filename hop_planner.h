@@ -0,0 +1,23 @@
+#ifndef HOP_PLANNER_H
+#define HOP_PLANNER_H
+
+#include "config.h"
+
+extern const HopProfile HOP_AUTO_WATCH;
+extern const HopProfile HOP_DEAUTH_WATCH;
+extern const HopProfile HOP_HIDDEN_SSID;
+extern const HopProfile HOP_DEVICE_MONITOR;
+
+HopProfile analyzerHopProfile(uint8_t scanSpeed);
+
+void hopStart(const HopProfile& profile, uint8_t startCh);
+bool hopUpdate();
+void hopResume();
+uint8_t hopChannel();
+uint16_t hopDwellMs();
+
+const ChannelCoverage* hopCoverage(uint8_t ch);
+uint8_t hopCoveragePct(uint8_t ch);
+uint32_t hopWorstGapMs();
+
+#endif // HOP_PLANNER_H
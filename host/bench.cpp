@@ -0,0 +1,457 @@
+// Microbenchmarks for the firmware's hot paths on the host: frame parsing,
+// device table updates, AP/BLE sorting and analysis, and every screen
+// renderer. Table-driven functions run at several population sizes up to
+// the firmware's own table capacity; the size is the last component of the
+// benchmark name (e.g. "sortApsByRssi/20").
+//
+// Output is JSON in Google Benchmark's layout, so two runs can be diffed
+// with its tools/compare.py:
+//   esp32util_bench > base.json; ...; esp32util_bench > head.json
+//   compare.py benchmarks base.json head.json
+// Numbers are host nanoseconds, useful for comparing builds rather than as
+// device timings.
+//
+//   esp32util_bench [--format=json|text] [--filter=SUBSTR] [--min-time=SEC]
+#include <chrono>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "screens.h"
+#include "screens_draw.h"
+#include "wifi_scanner.h"
+#include "ble_scanner.h"
+#include "device_monitor.h"
+#include "security.h"
+#include "ingest.h"
+#include "utils.h"
+#include "host_env.h"
+
+void setup();
+void updateRSSIHistory();
+void IRAM_ATTR deviceMonitorSniffer(void* buf, wifi_promiscuous_pkt_type_t type);
+
+extern uint8_t autoModeView, rfHealthView, walkTestView, whySlowView, diagView, monitorView, apDetailView;
+
+#define ROGUE_BENCH_APS 500
+
+struct BenchResult {
+  std::string name;
+  uint64_t iters;
+  double realNs;
+  double cpuNs;
+};
+
+static std::vector<BenchResult> results;
+static const char* filter = nullptr;
+static double minTimeSec = 0.02;
+
+static double cpuNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Grows the iteration count until one batch runs for at least minTimeSec,
+// then records that batch.
+template <class F>
+static void bench(const std::string& name, F fn) {
+  if (filter && name.find(filter) == std::string::npos) return;
+
+  uint64_t iters = 1;
+  for (;;) {
+    auto start = std::chrono::steady_clock::now();
+    double cpuStart = cpuNow();
+    for (uint64_t i = 0; i < iters; i++) fn(i);
+    double cpu = cpuNow() - cpuStart;
+    double real = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    if (real >= minTimeSec * 1e9 || iters >= (1ULL << 30)) {
+      results.push_back({name, iters, real / iters, cpu / iters});
+      return;
+    }
+    double scale = real > 0 ? minTimeSec * 1e9 * 1.4 / real : 10;
+    iters = (uint64_t)(iters * (scale < 2 ? 2 : scale > 10 ? 10 : scale));
+  }
+}
+
+static std::string sized(const char* name, uint32_t n) {
+  return std::string(name) + "/" + std::to_string(n);
+}
+
+// 1, a quarter, half and the full table.
+static std::vector<uint32_t> populations(uint32_t capacity) {
+  std::vector<uint32_t> out;
+  for (uint32_t n : {1U, capacity / 4, capacity / 2, capacity}) {
+    if (n >= 1 && (out.empty() || n > out.back())) out.push_back(n);
+  }
+  return out;
+}
+
+// ---- inputs ----
+
+struct Frame {
+  wifi_pkt_rx_ctrl_t rx;
+  uint8_t payload[128];
+};
+
+static void buildFrame(Frame& f, uint8_t fc0, uint8_t fc1, const char* ssid, uint8_t ch) {
+  memset(&f, 0, sizeof(f));
+  f.payload[0] = fc0;
+  f.payload[1] = fc1;
+  for (int i = 0; i < 6; i++) {
+    f.payload[4 + i] = (fc0 == 0x40 || fc0 == 0xC0) ? 0xFF : 0x10 + i;
+    f.payload[10 + i] = 0x20 + i;
+    f.payload[16 + i] = 0x20 + i;
+  }
+  uint8_t len = ssid ? strlen(ssid) : 0;
+  f.payload[24] = 0;
+  f.payload[25] = len;
+  if (len) memcpy(&f.payload[26], ssid, len);
+  f.rx.channel = ch;
+  f.rx.rssi = -55;
+  f.rx.rate = WIFI_PHY_RATE_24M;
+  f.rx.sig_len = 26 + len + 4;
+}
+
+static int8_t rssiPattern(uint32_t k) { return -40 - (int8_t)((k * 37) % 50); }
+
+static void fillAps(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    wifi_ap_record_t& ap = apList[i];
+    memset(&ap, 0, sizeof(ap));
+    snprintf((char*)ap.ssid, sizeof(ap.ssid), "Net%02u", i % 12);
+    for (int b = 0; b < 6; b++) ap.bssid[b] = 0x30 + i + b;
+    ap.primary = 1 + (i * 5) % MAX_CHANNEL;
+    ap.rssi = rssiPattern(i);
+    ap.authmode = (i % 5 == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+    ap.phy_11n = 1;
+  }
+  apCount = n;
+}
+
+static void fillBLE(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    char addr[18];
+    snprintf(addr, sizeof(addr), "c4:7c:8d:6a:%02x:%02x", i >> 8, i & 0xFF);
+    BLEDeviceInfo& d = bleDevices[i];
+    d.address = addr;
+    d.name = (i % 3 == 0) ? "Unknown" : "Tag";
+    d.hasName = i % 3 != 0;
+    d.rssi = rssiPattern(i);
+    d.isActive = true;
+    d.lastSeen = millis();
+    d.advType = i % 4 == 0;
+  }
+  bleDeviceCount = n;
+}
+
+static void fillMonitored(uint32_t n, uint8_t type) {
+  clearDeviceMonitor();
+  for (uint32_t i = 0; i < n; i++) {
+    if (type == 0) {
+      uint8_t mac[6] = {0x3C, 0x5A, 0xB4, 0x00, (uint8_t)(i >> 8), (uint8_t)i};
+      addOrUpdateWiFiClient(mac, rssiPattern(i), 1 + i % MAX_CHANNEL);
+    } else {
+      char addr[18];
+      snprintf(addr, sizeof(addr), "de:ad:be:ef:%02x:%02x", i >> 8, i & 0xFF);
+      addOrUpdateBLEDevice(addr, i % 2 ? "Band" : "", rssiPattern(i));
+    }
+  }
+}
+
+static void fillHidden(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    snprintf(hiddenList[i].ssid, sizeof(hiddenList[i].ssid), "Hidden%02u", i);
+    hiddenList[i].rssi = rssiPattern(i);
+    hiddenList[i].channel = 6;
+    hiddenList[i].active = true;
+  }
+  hiddenCount = n;
+}
+
+// ---- suites ----
+
+static void benchSniffer() {
+  Frame beacon, probe, data, deauth;
+  buildFrame(beacon, 0x80, 0x00, "Net01", 6);
+  buildFrame(data, 0x08, 0x01, nullptr, 6);
+  buildFrame(deauth, 0xC0, 0x00, nullptr, 6);
+  data.rx.sig_len = sizeof(data.payload);
+
+  enterSnifferMode(6);
+  bench("sniffer/beacon", [&](uint64_t) { hostDeliverFrame(&beacon, WIFI_PKT_MGMT); });
+  // Flood traffic: a new BSSID and SSID every frame, laid out as a real
+  // beacon so the SSID element after the fixed fields is hashed too
+  Frame flood;
+  buildFrame(flood, 0x80, 0x00, nullptr, 6);
+  flood.payload[37] = 8;
+  memcpy(&flood.payload[38], "Spam0000", 8);
+  flood.rx.sig_len = 38 + 8 + 4;
+  bench("sniffer/beacon_flood", [&](uint64_t i) {
+    flood.payload[14] = flood.payload[20] = flood.payload[44] = i >> 8;
+    flood.payload[15] = flood.payload[21] = flood.payload[45] = i;
+    hostDeliverFrame(&flood, WIFI_PKT_MGMT);
+  });
+  bench("sniffer/data", [&](uint64_t) { hostDeliverFrame(&data, WIFI_PKT_DATA); });
+  // A new transmitter every frame misses the talker tables each time
+  Frame churn = data;
+  bench("sniffer/data_churn", [&](uint64_t i) {
+    churn.payload[14] = i >> 8;
+    churn.payload[15] = i;
+    hostDeliverFrame(&churn, WIFI_PKT_DATA);
+  });
+  // Every frame a retried copy of the one before
+  Frame retry = data;
+  retry.payload[1] |= 0x08;
+  bench("sniffer/data_retry", [&](uint64_t) { hostDeliverFrame(&retry, WIFI_PKT_DATA); });
+  bench("sniffer/deauth", [&](uint64_t) { hostDeliverFrame(&deauth, WIFI_PKT_MGMT); });
+
+  // A probe for the last remembered SSID walks the whole hidden list once
+  // the loop drains it; timed with the drain so both halves are counted.
+  for (uint32_t n : populations(MAX_HIDDEN_SSIDS)) {
+    fillHidden(n);
+    char ssid[MAX_SSID_LEN + 1];
+    snprintf(ssid, sizeof(ssid), "Hidden%02u", n - 1);
+    buildFrame(probe, 0x40, 0x00, ssid, 6);
+    bench(sized("sniffer/probe_req", n), [&](uint64_t) {
+      hostDeliverFrame(&probe, WIFI_PKT_MGMT);
+      drainIngest();
+    });
+  }
+  hiddenCount = 0;
+  stopAllWifi();
+
+  for (uint32_t n : populations(deviceCapacity)) {
+    fillMonitored(n, 0);
+    bench(sized("deviceMonitorSniffer/data", n), [&](uint64_t) {
+      deviceMonitorSniffer(&data, WIFI_PKT_DATA);
+      drainIngest();
+    });
+  }
+}
+
+static void benchDeviceTables() {
+  for (uint32_t n : populations(deviceCapacity)) {
+    fillMonitored(n, 0);
+    uint8_t last[6] = {0x3C, 0x5A, 0xB4, 0x00, (uint8_t)((n - 1) >> 8), (uint8_t)(n - 1)};
+    bench(sized("addOrUpdateWiFiClient/hit", n), [&](uint64_t) { addOrUpdateWiFiClient(last, -60, 6); });
+
+    fillMonitored(n, 1);
+    char addr[18];
+    snprintf(addr, sizeof(addr), "de:ad:be:ef:%02x:%02x", (n - 1) >> 8, (n - 1) & 0xFF);
+    bench(sized("addOrUpdateBLEDevice/hit", n), [&](uint64_t) { addOrUpdateBLEDevice(addr, "Band", -60); });
+  }
+
+  // Full table: every new client evicts the least recently seen one.
+  fillMonitored(deviceCapacity, 0);
+  bench(sized("addOrUpdateWiFiClient/evict", deviceCapacity), [&](uint64_t i) {
+    uint8_t mac[6] = {0x3C, 0x5A, 0xB5, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+    addOrUpdateWiFiClient(mac, -60, 6);
+  });
+  clearDeviceMonitor();
+
+  uint8_t known[6] = {vendors[vendorCount - 1].oui[0], vendors[vendorCount - 1].oui[1],
+                      vendors[vendorCount - 1].oui[2], 0x01, 0x02, 0x03};
+  uint8_t unknown[6] = {0x02, 0x00, 0x00, 0x01, 0x02, 0x03};
+  bench("getVendor/last", [&](uint64_t) { getVendor(known); });
+  bench("getVendor/miss", [&](uint64_t) { getVendor(unknown); });
+}
+
+// Rogue checks on scans far larger than apList: networks of five APs each,
+// every tenth network with an open clone, untrained and then trained.
+static void benchRogueScan() {
+  for (uint32_t n : populations(ROGUE_BENCH_APS)) {
+    std::vector<wifi_ap_record_t> scan(n);
+    for (uint32_t i = 0; i < n; i++) {
+      wifi_ap_record_t& ap = scan[i];
+      memset(&ap, 0, sizeof(ap));
+      uint32_t net = i / 5;
+      snprintf((char*)ap.ssid, sizeof(ap.ssid), "Corp%03u", net);
+      ap.bssid[0] = 0x02;
+      ap.bssid[4] = i >> 8;
+      ap.bssid[5] = i;
+      ap.primary = 1 + (i * 5) % MAX_CHANNEL;
+      bool clone = net % 10 == 0 && i % 5 == 4;
+      ap.authmode = clone ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+    }
+    bench(sized("checkRogueAPs/untrained", n), [&](uint64_t) { checkRogueAPs(scan.data(), n); });
+
+    setRogueTraining(true);
+    checkRogueAPs(scan.data(), n);
+    setRogueTraining(false);
+    bench(sized("checkRogueAPs/trained", n), [&](uint64_t) { checkRogueAPs(scan.data(), n); });
+    clearTrustedAPs();
+  }
+}
+
+static void benchAnalysis() {
+  enterScanMode();
+  for (uint32_t n : populations(MAX_APS)) {
+    fillAps(n);
+    bench(sized("detectRogueAPs", n), [&](uint64_t) { detectRogueAPs(); });
+    bench(sized("sortApsByRssi", n), [&](uint64_t i) {
+      for (uint32_t k = 0; k < n; k++) apList[k].rssi = rssiPattern(k + i);
+      sortApsByRssi();
+    });
+    fillAps(n);
+    bench(sized("getQualityGrade", n), [&](uint64_t i) { getQualityGrade(&apList[i % n]); });
+    bench(sized("bestAPIndex", n), [&](uint64_t) { bestAPIndex(); });
+    bench(sized("countOverlappingAPs", n), [&](uint64_t i) { countOverlappingAPs(1 + i % MAX_CHANNEL); });
+    bench(sized("updateRSSIHistory", n), [&](uint64_t) { updateRSSIHistory(); });
+    Baseline snap;
+    bench(sized("takeSnapshot", n), [&](uint64_t) { takeSnapshot(&snap); });
+  }
+
+  benchRogueScan();
+
+  for (uint32_t n : populations(MAX_BLE_DEVICES)) {
+    fillBLE(n);
+    bench(sized("sortBLEByRSSI", n), [&](uint64_t i) {
+      for (uint32_t k = 0; k < n; k++) bleDevices[k].rssi = rssiPattern(k + i);
+      sortBLEByRSSI();
+    });
+  }
+}
+
+struct DrawCase {
+  const char* name;
+  void (*fn)();
+  uint8_t* view;
+  uint8_t views;
+};
+
+static void drawPlaceholderCase() { drawPlaceholder("Placeholder", "Coming soon"); }
+
+static const DrawCase drawCases[] = {
+  {"drawMenu", drawMenu, nullptr, 1},
+  {"drawSecurityMenu", drawSecurityMenu, nullptr, 1},
+  {"drawInsightsMenu", drawInsightsMenu, nullptr, 1},
+  {"drawHistoryMenu", drawHistoryMenu, nullptr, 1},
+  {"drawSystemMenu", drawSystemMenu, nullptr, 1},
+  {"drawAutoWatch", drawAutoWatch, &autoModeView, 4},
+  {"drawRFHealth", drawRFHealth, &rfHealthView, 3},
+  {"drawMonitor", drawMonitor, &monitorView, 2},
+  {"drawAnalyzer", drawAnalyzer, nullptr, 1},
+  {"drawDeviceMonitor", drawDeviceMonitor, nullptr, 1},
+  {"drawDeviceDetail", drawDeviceDetail, nullptr, 1},
+  {"drawApList", drawApList, nullptr, 1},
+  {"drawApDetail", drawApDetail, &apDetailView, 2},
+  {"drawAPWalkTest", drawAPWalkTest, &walkTestView, 2},
+  {"drawCompare", drawCompare, nullptr, 1},
+  {"drawBLEScan", drawBLEScan, nullptr, 1},
+  {"drawBLEDetail", drawBLEDetail, nullptr, 1},
+  {"drawBLEWalkTest", drawBLEWalkTest, &walkTestView, 2},
+  {"drawDeauthWatch", drawDeauthWatch, nullptr, 1},
+  {"drawRogueAPWatch", drawRogueAPWatch, nullptr, 1},
+  {"drawBLETrackerWatch", drawBLETrackerWatch, nullptr, 1},
+  {"drawAlertSettings", drawAlertSettings, nullptr, 1},
+  {"drawWhyIsItSlow", drawWhyIsItSlow, &whySlowView, 2},
+  {"drawChannelRecommendation", drawChannelRecommendation, nullptr, 1},
+  {"drawEnvironmentChange", drawEnvironmentChange, nullptr, 1},
+  {"drawEventLog", drawEventLog, nullptr, 1},
+  {"drawBaselineCompare", drawBaselineCompare, nullptr, 1},
+  {"drawBatteryPower", drawBatteryPower, nullptr, 1},
+  {"drawDisplaySettings", drawDisplaySettings, nullptr, 1},
+  {"drawRadioControl", drawRadioControl, nullptr, 1},
+  {"drawDiagnostics", drawDiagnostics, &diagView, 2},
+  {"drawAbout", drawAbout, nullptr, 1},
+  {"drawHiddenSSID", drawHiddenSSID, nullptr, 1},
+  {"drawStats", drawStats, nullptr, 1},
+  {"drawQuickSnapshot", drawQuickSnapshot, nullptr, 1},
+  {"drawRSSIMeter", drawRSSIMeter, nullptr, 1},
+  {"drawChannelScorecard", drawChannelScorecard, nullptr, 1},
+  {"drawExport", drawExport, nullptr, 1},
+  {"drawPowerMode", drawPowerMode, nullptr, 1},
+  {"drawPlaceholder", drawPlaceholderCase, nullptr, 1},
+};
+
+// Every screen renders with all of its tables holding n entries.
+static void benchDraw() {
+  for (uint32_t n : populations(MAX_APS)) {
+    fillAps(n);
+    fillBLE(n < MAX_BLE_DEVICES ? n : MAX_BLE_DEVICES);
+    fillMonitored(n, 0);
+    fillHidden(n < MAX_HIDDEN_SSIDS ? n : MAX_HIDDEN_SSIDS);
+    detectRogueAPs();
+    updateRSSIHistory();
+
+    for (const DrawCase& c : drawCases) {
+      for (uint8_t v = 0; v < c.views; v++) {
+        std::string name = c.name;
+        if (c.view) {
+          *c.view = v;
+          name += "/view" + std::to_string(v);
+        }
+        bench(sized(name.c_str(), n), [&](uint64_t) { c.fn(); });
+      }
+      if (c.view) *c.view = 0;
+    }
+  }
+}
+
+// ---- output ----
+
+static void printText() {
+  for (const BenchResult& r : results) {
+    printf("%-40s %12.1f ns %12.1f ns cpu %12llu\n", r.name.c_str(), r.realNs, r.cpuNs,
+           (unsigned long long)r.iters);
+  }
+}
+
+static void printJson(const char* exe) {
+  char host[64] = "";
+  gethostname(host, sizeof(host) - 1);
+  char date[32];
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+  printf("{\n  \"context\": {\n");
+  printf("    \"date\": \"%s\",\n", date);
+  printf("    \"host_name\": \"%s\",\n", host);
+  printf("    \"executable\": \"%s\",\n", exe);
+  printf("    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+  printf("    \"firmware_version\": \"%s\",\n", FW_VERSION);
+#ifdef NDEBUG
+  printf("    \"library_build_type\": \"release\"\n");
+#else
+  printf("    \"library_build_type\": \"debug\"\n");
+#endif
+  printf("  },\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    printf("    {\"name\": \"%s\", \"run_name\": \"%s\", \"run_type\": \"iteration\", "
+           "\"repetitions\": 1, \"threads\": 1, \"iterations\": %llu, "
+           "\"real_time\": %.2f, \"cpu_time\": %.2f, \"time_unit\": \"ns\"}%s\n",
+           r.name.c_str(), r.name.c_str(), (unsigned long long)r.iters, r.realNs, r.cpuNs,
+           i + 1 < results.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  bool json = true;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--format=json") json = true;
+    else if (a == "--format=text") json = false;
+    else if (a.rfind("--filter=", 0) == 0) filter = argv[i] + 9;
+    else if (a.rfind("--min-time=", 0) == 0) minTimeSec = atof(argv[i] + 11);
+    else {
+      fprintf(stderr, "usage: %s [--format=json|text] [--filter=SUBSTR] [--min-time=SEC]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  setup();
+  benchSniffer();
+  benchDeviceTables();
+  benchAnalysis();
+  benchDraw();
+
+  if (json) printJson(argv[0]);
+  else printText();
+  return 0;
+}
@@ -0,0 +1,474 @@
+// Replays a pcap or pcapng capture through the firmware's promiscuous
+// callbacks. Each 802.11 frame (radiotap or bare link type) becomes a
+// wifi_promiscuous_pkt_t and is handed to sniffer() and
+// deviceMonitorSniffer(). The virtual clock follows the capture timestamps
+// so time-based logic sees the recorded timing; by default frames are fed
+// as fast as possible, --realtime[=N] paces them at N times recorded speed.
+// BSSIDs whose beacons run on two TSF clocks are listed; esp32util_sim
+// --pcap writes captures with a cloned AP and a restarting one to try it on.
+//
+//   esp32util_replay [--realtime[=N]] capture.pcap
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "wifi_scanner.h"
+#include "device_monitor.h"
+#include "sniffer_stats.h"
+#include "ingest.h"
+#include "deauth_detector.h"
+#include "seq_watch.h"
+#include "tsf_watch.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
+#include "host_env.h"
+
+void setup();
+void IRAM_ATTR deviceMonitorSniffer(void* buf, wifi_promiscuous_pkt_type_t type);
+
+#define LINKTYPE_IEEE802_11 105
+#define LINKTYPE_RADIOTAP 127
+
+#define FRAME_BUF_SIZE 4096
+
+struct CapturedFrame {
+  uint64_t tsUs;
+  uint32_t linkType;
+  const uint8_t* data;
+  uint32_t capLen;
+};
+
+struct ReplayTotals {
+  uint32_t frames = 0;
+  uint32_t mgmt = 0;
+  uint32_t data = 0;
+  uint32_t skipped = 0;
+  uint32_t badFcs = 0;
+  uint32_t attacks = 0;
+};
+
+// ---- capture file readers ----
+
+static uint16_t rd16(const uint8_t* p, bool swap) {
+  uint16_t v = p[0] | (p[1] << 8);
+  return swap ? (uint16_t)((v >> 8) | (v << 8)) : v;
+}
+
+static uint32_t rd32(const uint8_t* p, bool swap) {
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  return swap ? __builtin_bswap32(v) : v;
+}
+
+class CaptureReader {
+ public:
+  bool open(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf_.resize(size > 0 ? size : 0);
+    bool ok = fread(buf_.data(), 1, buf_.size(), f) == buf_.size();
+    fclose(f);
+    if (!ok || buf_.size() < 24) return false;
+
+    uint32_t magic = rd32(&buf_[0], false);
+    if (magic == 0xA1B2C3D4 || magic == 0xA1B23C4D) {
+      pcapng_ = false;
+      swap_ = false;
+    } else if (magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1) {
+      pcapng_ = false;
+      swap_ = true;
+    } else if (magic == 0x0A0D0D0A) {
+      pcapng_ = true;
+      return true;
+    } else {
+      return false;
+    }
+
+    uint32_t m = rd32(&buf_[0], swap_);
+    nanoRes_ = (m == 0xA1B23C4D);
+    linkType_ = rd32(&buf_[20], swap_);
+    pos_ = 24;
+    return true;
+  }
+
+  bool next(CapturedFrame& out) {
+    return pcapng_ ? nextPcapng(out) : nextPcap(out);
+  }
+
+  const char* format() const { return pcapng_ ? "pcapng" : "pcap"; }
+
+ private:
+  bool nextPcap(CapturedFrame& out) {
+    if (pos_ + 16 > buf_.size()) return false;
+    const uint8_t* h = &buf_[pos_];
+    uint64_t sec = rd32(h, swap_);
+    uint64_t frac = rd32(h + 4, swap_);
+    uint32_t capLen = rd32(h + 8, swap_);
+    if (pos_ + 16 + capLen > buf_.size()) return false;
+
+    out.tsUs = sec * 1000000 + (nanoRes_ ? frac / 1000 : frac);
+    out.linkType = linkType_;
+    out.data = h + 16;
+    out.capLen = capLen;
+    pos_ += 16 + capLen;
+    return true;
+  }
+
+  // Section header, interface description, enhanced and simple packet
+  // blocks are understood; everything else is skipped.
+  bool nextPcapng(CapturedFrame& out) {
+    while (pos_ + 12 <= buf_.size()) {
+      const uint8_t* b = &buf_[pos_];
+      uint32_t type = rd32(b, swap_);
+
+      if (type == 0x0A0D0D0A) {
+        uint32_t bom = rd32(b + 8, false);
+        swap_ = (bom == 0x4D3C2B1A);
+        ifaces_.clear();
+      }
+
+      uint32_t len = rd32(b + 4, swap_);
+      if (len < 12 || pos_ + len > buf_.size()) return false;
+      pos_ += len;
+
+      if (type == 0x00000001 && len >= 20) {
+        Iface ifc;
+        ifc.linkType = rd16(b + 8, swap_);
+        ifc.unitsPerSec = 1000000;
+        parseIfaceOptions(b + 16, b + len - 4, ifc);
+        ifaces_.push_back(ifc);
+      } else if (type == 0x00000006 && len >= 32) {
+        uint32_t id = rd32(b + 8, swap_);
+        if (id >= ifaces_.size()) continue;
+        uint64_t ts = ((uint64_t)rd32(b + 12, swap_) << 32) | rd32(b + 16, swap_);
+        uint32_t capLen = rd32(b + 20, swap_);
+        if (28 + capLen > len) continue;
+        out.tsUs = toMicros(ts, ifaces_[id].unitsPerSec);
+        out.linkType = ifaces_[id].linkType;
+        out.data = b + 28;
+        out.capLen = capLen;
+        return true;
+      } else if (type == 0x00000003 && len >= 16 && !ifaces_.empty()) {
+        uint32_t origLen = rd32(b + 8, swap_);
+        uint32_t capLen = min(origLen, len - 16);
+        out.tsUs = lastTs_;
+        out.linkType = ifaces_[0].linkType;
+        out.data = b + 12;
+        out.capLen = capLen;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct Iface {
+    uint32_t linkType;
+    uint64_t unitsPerSec;
+  };
+
+  void parseIfaceOptions(const uint8_t* p, const uint8_t* end, Iface& ifc) {
+    while (p + 4 <= end) {
+      uint16_t code = rd16(p, swap_);
+      uint16_t olen = rd16(p + 2, swap_);
+      if (code == 0) break;
+      if (code == 9 && olen >= 1) {
+        uint8_t r = p[4];
+        uint64_t units = 1;
+        if (r & 0x80) {
+          for (int i = 0; i < (r & 0x7F); i++) units *= 2;
+        } else {
+          for (int i = 0; i < r; i++) units *= 10;
+        }
+        ifc.unitsPerSec = units;
+      }
+      p += 4 + ((olen + 3) & ~3);
+    }
+  }
+
+  uint64_t toMicros(uint64_t ts, uint64_t unitsPerSec) {
+    if (unitsPerSec == 1000000) lastTs_ = ts;
+    else lastTs_ = ts / unitsPerSec * 1000000 + (ts % unitsPerSec) * 1000000 / unitsPerSec;
+    return lastTs_;
+  }
+
+  std::vector<uint8_t> buf_;
+  size_t pos_ = 0;
+  bool pcapng_ = false;
+  bool swap_ = false;
+  bool nanoRes_ = false;
+  uint32_t linkType_ = 0;
+  uint64_t lastTs_ = 0;
+  std::vector<Iface> ifaces_;
+};
+
+// ---- radiotap to rx_ctrl ----
+
+struct RadioInfo {
+  int8_t rssi = -70;
+  int8_t noise = -95;
+  uint8_t rate500k = 0;
+  uint16_t freq = 0;
+  bool fcsIncluded = false;
+  bool badFcs = false;
+  bool ht = false;
+  uint8_t mcs = 0;
+  bool ht40 = false;
+  bool sgi = false;
+};
+
+// Alignment and size of radiotap fields 0..19; parsing stops at the first
+// present field beyond that, since later sizes are not needed for rx_ctrl.
+static const uint8_t rtAlign[] = {8, 1, 1, 2, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 2, 2, 1, 1, 4, 1};
+static const uint8_t rtSize[] = {8, 1, 1, 4, 2, 1, 1, 2, 2, 2, 1, 1, 1, 1, 2, 2, 1, 1, 8, 3};
+
+static int parseRadiotap(const uint8_t* p, uint32_t len, RadioInfo& ri) {
+  if (len < 8 || p[0] != 0) return -1;
+  uint16_t hdrLen = rd16(p + 2, false);
+  if (hdrLen > len) return -1;
+
+  uint32_t present = rd32(p + 4, false);
+  uint32_t off = 8;
+  uint32_t word = present;
+  while ((word & 0x80000000) && off + 4 <= hdrLen) {
+    word = rd32(p + off, false);
+    off += 4;
+  }
+
+  for (int bit = 0; bit < 20; bit++) {
+    if (!(present & (1UL << bit))) continue;
+    off = (off + rtAlign[bit] - 1) & ~(uint32_t)(rtAlign[bit] - 1);
+    if (off + rtSize[bit] > hdrLen) break;
+    const uint8_t* f = p + off;
+    switch (bit) {
+      case 1:
+        ri.fcsIncluded = f[0] & 0x10;
+        ri.badFcs = f[0] & 0x40;
+        break;
+      case 2: ri.rate500k = f[0]; break;
+      case 3: ri.freq = rd16(f, false); break;
+      case 5: ri.rssi = (int8_t)f[0]; break;
+      case 6: ri.noise = (int8_t)f[0]; break;
+      case 19:
+        ri.ht = true;
+        if (f[0] & 0x01) ri.ht40 = (f[1] & 0x03) == 1;
+        if (f[0] & 0x04) ri.sgi = f[1] & 0x04;
+        if (f[0] & 0x02) ri.mcs = f[2];
+        break;
+    }
+    off += rtSize[bit];
+  }
+  return hdrLen;
+}
+
+static uint8_t legacyRateCode(uint8_t rate500k) {
+  switch (rate500k) {
+    case 2: return WIFI_PHY_RATE_1M_L;
+    case 4: return WIFI_PHY_RATE_2M_L;
+    case 11: return WIFI_PHY_RATE_5M_L;
+    case 22: return WIFI_PHY_RATE_11M_L;
+    case 12: return WIFI_PHY_RATE_6M;
+    case 18: return WIFI_PHY_RATE_9M;
+    case 24: return WIFI_PHY_RATE_12M;
+    case 36: return WIFI_PHY_RATE_18M;
+    case 48: return WIFI_PHY_RATE_24M;
+    case 72: return WIFI_PHY_RATE_36M;
+    case 96: return WIFI_PHY_RATE_48M;
+    case 108: return WIFI_PHY_RATE_54M;
+  }
+  return WIFI_PHY_RATE_1M_L;
+}
+
+static uint8_t freqToChannel(uint16_t freq) {
+  if (freq == 2484) return 14;
+  if (freq >= 2412 && freq <= 2472) return (freq - 2407) / 5;
+  return 0;
+}
+
+// Fills an ESP-style promiscuous packet; returns the packet type, or -1 to
+// skip the frame (unparseable, or a control frame the default promiscuous
+// filter would not deliver).
+static int buildPacket(const CapturedFrame& cf, uint8_t* buf, ReplayTotals& totals) {
+  RadioInfo ri;
+  const uint8_t* frame = cf.data;
+  uint32_t len = cf.capLen;
+
+  if (cf.linkType == LINKTYPE_RADIOTAP) {
+    int hdr = parseRadiotap(cf.data, cf.capLen, ri);
+    if (hdr < 0) return -1;
+    frame += hdr;
+    len -= hdr;
+  } else if (cf.linkType != LINKTYPE_IEEE802_11) {
+    return -1;
+  }
+  if (len < 10) return -1;
+
+  uint8_t type = (frame[0] >> 2) & 0x03;
+  if (type == 1 || type == 3) return -1;
+
+  // Captures may hold frames far larger than the radio ever delivers
+  // (A-MSDU, 64k snaplen, corrupt records); keep what fits the buffer
+  uint32_t copyLen = min(len, (uint32_t)(FRAME_BUF_SIZE - sizeof(wifi_pkt_rx_ctrl_t) - 8));
+  memset(buf, 0, sizeof(wifi_pkt_rx_ctrl_t) + copyLen + 8);
+  wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)buf;
+  wifi_pkt_rx_ctrl_t& rx = pkt->rx_ctrl;
+
+  memcpy(pkt->payload, frame, copyLen);
+
+  rx.rssi = ri.rssi;
+  rx.noise_floor = ri.noise;
+  rx.channel = ri.freq ? freqToChannel(ri.freq) : hostRadioChannel();
+  rx.timestamp = (uint32_t)cf.tsUs;
+  rx.sig_len = min(copyLen + (ri.fcsIncluded ? 0 : 4), 4095U);
+  rx.rx_state = ri.badFcs ? 1 : 0;
+  if (ri.ht) {
+    rx.sig_mode = 1;
+    rx.mcs = ri.mcs;
+    rx.cwb = ri.ht40;
+    rx.sgi = ri.sgi;
+  } else {
+    rx.rate = legacyRateCode(ri.rate500k);
+  }
+
+  if (ri.badFcs) totals.badFcs++;
+  return type == 0 ? WIFI_PKT_MGMT : WIFI_PKT_DATA;
+}
+
+// ---- report ----
+
+static void printReport(const ReplayTotals& t, uint64_t spanUs, double wallSec) {
+  printf("frames         %u replayed (%u mgmt, %u data), %u skipped, %u bad FCS\n",
+         t.frames, t.mgmt, t.data, t.skipped, t.badFcs);
+  printf("capture span   %.3f s\n", spanUs / 1e6);
+  printf("throughput     %.0f frames/s (%.3f s wall)\n", wallSec > 0 ? t.frames / wallSec : 0.0, wallSec);
+  printf("deauth         %u deauth + %u disassoc frames, %u attack onsets\n", totalDeauthDetected,
+         totalDisassocDetected, t.attacks);
+  printf("hidden SSIDs   %u\n", hiddenCount);
+  for (int i = 0; i < hiddenCount; i++) {
+    printf("  %-32s ch%-2u %d dBm\n", hiddenList[i].ssid, hiddenList[i].channel, hiddenList[i].rssi);
+  }
+  printf("devices        %u monitored\n", monitoredDeviceCount);
+
+  uint16_t timed = 0;
+  for (uint16_t i = 0; i < TSF_CLOCKS; i++) {
+    const TsfClock* k = tsfClockAt(i);
+    if (k && k->run >= TSF_ESTABLISHED) timed++;
+  }
+  printf("beacon clocks  %u BSSIDs timed\n", timed);
+  for (uint16_t i = 0; i < TSF_CLOCKS; i++) {
+    const TsfClock* k = tsfClockAt(i);
+    if (!k || !tsfCloned(k->bssid)) continue;
+    const uint8_t* b = k->bssid;
+    printf("  %02X:%02X:%02X:%02X:%02X:%02X two clocks: %u switches, drift %d ppm, jitter %u us%s\n",
+           b[0], b[1], b[2], b[3], b[4], b[5], k->switches, (int)(k->drift / 16), k->jitter / 16,
+           seqCloned(b) ? ", sequence cloned too" : "");
+  }
+
+  updateCsaWatch();
+  printf("channel switch %u announced, %u suspect\n", csaHeard, csaDetected);
+  for (uint8_t i = 0; i < CSA_TRACKS; i++) {
+    const CsaTrack* k = csaTrackAt(i);
+    if (!k) continue;
+    const uint8_t* b = k->bssid;
+    printf("  %02X:%02X:%02X:%02X:%02X:%02X ch%u -> ch%u heard %u, %u plain beacons%s\n", b[0], b[1], b[2], b[3],
+           b[4], b[5], k->channel, k->newChannel, k->heard, k->plain, k->reported ? ", suspect" : "");
+  }
+
+  updateEapolWatch();
+  printf("eapol          %u frames, %u handshakes completed, %u auth-failure storms\n", eapolFrames,
+         eapolHandshakes, authStorms);
+  for (uint16_t i = 0; i < EAPOL_PAIRS; i++) {
+    const EapolPair* e = eapolPairAt(i);
+    if (!e || !e->reported) continue;
+    printf("  %02X:%02X:%02X:%02X:%02X:%02X > %02X:%02X:%02X:%02X:%02X:%02X %u handshakes, %u completed, %u failed\n",
+           e->client[0], e->client[1], e->client[2], e->client[3], e->client[4], e->client[5], e->bssid[0],
+           e->bssid[1], e->bssid[2], e->bssid[3], e->bssid[4], e->bssid[5], e->attempts, e->completed,
+           eapolFailures(*e));
+  }
+
+  ChannelCounters c;
+  readChannelCounters(&c);
+  printf("ch   frames   beacon     data   deauth  airtime%%\n");
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    if (c.total[ch] == 0) continue;
+    double busy = spanUs ? 100.0 * c.airtimeUs[ch] / spanUs : 0.0;
+    printf("%2d %8u %8u %8u %8u %8.2f\n", ch, c.total[ch], c.beacon[ch], c.data[ch], c.deauth[ch], busy);
+  }
+
+  const SnifferStats& s = snifferStats[CB_SNIFFER];
+  printf("sniffer()      discard %u, rx errors %u, ring drops %u\n", s.discarded, s.rxErrors, s.ringDrops);
+}
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  double speed = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--realtime") speed = 1;
+    else if (a.rfind("--realtime=", 0) == 0) speed = atof(a.c_str() + 11);
+    else path = argv[i];
+  }
+  if (!path) {
+    fprintf(stderr, "usage: %s [--realtime[=N]] capture.pcap|capture.pcapng\n", argv[0]);
+    return 2;
+  }
+
+  CaptureReader reader;
+  if (!reader.open(path)) {
+    fprintf(stderr, "%s: not a readable pcap/pcapng file\n", path);
+    return 1;
+  }
+
+  setup();
+  enterSnifferMode(1);
+  resetSnifferStats();
+
+  static uint8_t buf[FRAME_BUF_SIZE];
+  ReplayTotals totals;
+  CapturedFrame cf;
+  uint64_t firstTs = 0, lastTs = 0;
+  uint64_t clockBase = hostMicros();
+  bool prevAttack = attackActive;
+  auto wallStart = std::chrono::steady_clock::now();
+
+  while (reader.next(cf)) {
+    if (totals.frames == 0 && totals.skipped == 0) firstTs = cf.tsUs;
+    if (cf.tsUs < lastTs) cf.tsUs = lastTs;
+    lastTs = cf.tsUs;
+
+    hostSetMicros(clockBase + (cf.tsUs - firstTs));
+    if (speed > 0) {
+      auto due = wallStart + std::chrono::microseconds((uint64_t)((cf.tsUs - firstTs) / speed));
+      std::this_thread::sleep_until(due);
+    }
+
+    updateDeauthRate();
+    updateCsaWatch();
+    updateEapolWatch();
+    updateSnifferStats();
+    if (attackActive && !prevAttack) totals.attacks++;
+    prevAttack = attackActive;
+
+    int type = buildPacket(cf, buf, totals);
+    if (type < 0) {
+      totals.skipped++;
+      continue;
+    }
+
+    sniffer(buf, (wifi_promiscuous_pkt_type_t)type);
+    deviceMonitorSniffer(buf, (wifi_promiscuous_pkt_type_t)type);
+    drainIngest();
+    totals.frames++;
+    if (type == WIFI_PKT_MGMT) totals.mgmt++;
+    else totals.data++;
+  }
+
+  double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  printf("file           %s (%s)\n", path, reader.format());
+  printReport(totals, lastTs - firstTs, wallSec);
+  return 0;
+}
@@ -0,0 +1,29 @@
+// Host shim for the NeoPixel driver; remembers the last colour shown.
+#ifndef HOST_ADAFRUIT_NEOPIXEL_H
+#define HOST_ADAFRUIT_NEOPIXEL_H
+
+#include <stdint.h>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type) : n_(n) { (void)pin; (void)type; }
+  void begin() {}
+  void show() { shown = pixel; }
+  void setPixelColor(uint16_t n, uint32_t c) { if (n < n_) pixel = c; }
+  void setBrightness(uint8_t b) { brightness = b; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+  uint32_t pixel = 0;
+  uint32_t shown = 0;
+  uint8_t brightness = 255;
+
+ private:
+  uint16_t n_;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// Host shim for the Arduino BLE stack: scans deliver whatever the host
+// environment queues through hostQueueBLEAdvert().
+#ifndef HOST_BLEDEVICE_H
+#define HOST_BLEDEVICE_H
+
+#include <string>
+#include "Arduino.h"
+
+class BLEAddress {
+ public:
+  BLEAddress() {}
+  explicit BLEAddress(const std::string& s) : s_(s) {}
+  std::string toString() const { return s_; }
+ private:
+  std::string s_;
+};
+
+class BLEAdvertisedDevice {
+ public:
+  BLEAddress getAddress() const { return address; }
+  int getRSSI() const { return rssi; }
+  bool haveName() const { return !name.empty(); }
+  std::string getName() const { return name; }
+  bool haveManufacturerData() const { return !manufacturerData.empty(); }
+  std::string getManufacturerData() const { return manufacturerData; }
+
+  BLEAddress address;
+  int rssi = -100;
+  std::string name;
+  std::string manufacturerData;
+};
+
+class BLEAdvertisedDeviceCallbacks {
+ public:
+  virtual ~BLEAdvertisedDeviceCallbacks() {}
+  virtual void onResult(BLEAdvertisedDevice advertisedDevice) = 0;
+};
+
+class BLEScanResults {};
+
+class BLEScan {
+ public:
+  void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks* cb) { callbacks = cb; }
+  void setActiveScan(bool) {}
+  void setInterval(uint16_t) {}
+  void setWindow(uint16_t) {}
+  BLEScanResults start(uint32_t duration, bool isContinue = false);
+  void stop() {}
+  void clearResults() {}
+
+  BLEAdvertisedDeviceCallbacks* callbacks = nullptr;
+};
+
+class BLEDevice {
+ public:
+  static void init(const std::string& name) { (void)name; }
+  static BLEScan* getScan();
+};
+
+#endif
@@ -0,0 +1,43 @@
+// Host shim for the NVS-backed Preferences store, kept in memory.
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false);
+  void end() {}
+  bool clear();
+  bool remove(const char* key);
+
+  uint8_t getUChar(const char* key, uint8_t def = 0) { return get<uint8_t>(key, def); }
+  int8_t getChar(const char* key, int8_t def = 0) { return get<int8_t>(key, def); }
+  bool getBool(const char* key, bool def = false) { return get<bool>(key, def); }
+  uint16_t getUShort(const char* key, uint16_t def = 0) { return get<uint16_t>(key, def); }
+  uint32_t getUInt(const char* key, uint32_t def = 0) { return get<uint32_t>(key, def); }
+
+  size_t putUChar(const char* key, uint8_t v) { return put(key, &v, sizeof(v)); }
+  size_t putChar(const char* key, int8_t v) { return put(key, &v, sizeof(v)); }
+  size_t putBool(const char* key, bool v) { return put(key, &v, sizeof(v)); }
+  size_t putUShort(const char* key, uint16_t v) { return put(key, &v, sizeof(v)); }
+  size_t putUInt(const char* key, uint32_t v) { return put(key, &v, sizeof(v)); }
+
+  size_t putBytes(const char* key, const void* value, size_t len) { return put(key, value, len); }
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+ private:
+  template <class T> T get(const char* key, T def) {
+    T v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+  }
+  size_t put(const char* key, const void* value, size_t len);
+  std::string ns_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// Host shim for U8g2: a page-mode software framebuffer standing in for the
+// SSD1306. Glyphs are drawn as deterministic pixel patterns so rendering cost
+// and layout bounds are exercised without the real font tables.
+#ifndef HOST_U8G2LIB_H
+#define HOST_U8G2LIB_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+#define U8G2_R0 0
+#define U8X8_PIN_NONE 255
+
+extern const uint8_t u8g2_font_4x6_tf[];
+extern const uint8_t u8g2_font_5x7_tf[];
+extern const uint8_t u8g2_font_6x10_tf[];
+
+class U8G2 : public Print {
+ public:
+  static const int WIDTH = 128;
+  static const int HEIGHT = 64;
+  static const int PAGE_ROWS = 8;
+
+  bool begin() { return true; }
+  void setContrast(uint8_t v) { contrast = v; }
+  void setPowerSave(uint8_t on) { powerSave = on; }
+
+  void firstPage();
+  uint8_t nextPage();
+
+  void setFont(const uint8_t* font) { font_ = font; }
+  void setDrawColor(uint8_t c) { color_ = c; }
+  void setCursor(int x, int y) { tx_ = x; ty_ = y; }
+
+  void drawPixel(int x, int y);
+  void drawHLine(int x, int y, int w);
+  void drawVLine(int x, int y, int h);
+  void drawLine(int x0, int y0, int x1, int y1);
+  void drawFrame(int x, int y, int w, int h);
+  void drawBox(int x, int y, int w, int h);
+  int drawStr(int x, int y, const char* s);
+
+  size_t write(const char* s, size_t n) override;
+
+  bool pixel(int x, int y) const;
+  uint32_t frameHash() const;
+
+  uint8_t framebuffer[WIDTH * HEIGHT / 8] = {0};
+  uint32_t pagesFlushed = 0;
+  uint8_t contrast = 0;
+  uint8_t powerSave = 0;
+
+ private:
+  int drawGlyph(int x, int y, char c);
+
+  uint8_t pageBuf_[WIDTH] = {0};
+  int page_ = 0;
+  const uint8_t* font_ = u8g2_font_5x7_tf;
+  uint8_t color_ = 1;
+  int tx_ = 0;
+  int ty_ = 0;
+};
+
+class U8G2_SSD1306_128X64_NONAME_1_HW_I2C : public U8G2 {
+ public:
+  U8G2_SSD1306_128X64_NONAME_1_HW_I2C(int rotation, uint8_t reset, uint8_t clock = U8X8_PIN_NONE,
+                                      uint8_t data = U8X8_PIN_NONE) {
+    (void)rotation; (void)reset; (void)clock; (void)data;
+  }
+};
+
+#endif
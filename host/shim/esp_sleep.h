@@ -0,0 +1,6 @@
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+void esp_deep_sleep_start();
+
+#endif
@@ -0,0 +1,175 @@
+#include "Arduino.h"
+#include "esp_wifi.h"
+#include "esp_sleep.h"
+#include "Preferences.h"
+#include "BLEDevice.h"
+#include <time.h>
+#include <vector>
+#include <map>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static uint64_t virtualMicros = 0;
+static HostTimeHook timeHook = nullptr;
+static bool inTimeHook = false;
+static bool actionDown = false;
+static bool backDown = false;
+
+static void advance(uint64_t us) {
+  uint64_t to = virtualMicros + us;
+  if (timeHook && !inTimeHook) {
+    inTimeHook = true;
+    timeHook(virtualMicros, to);
+    inTimeHook = false;
+  }
+  virtualMicros = to;
+}
+
+void hostSetMicros(uint64_t us) { virtualMicros = us; }
+void hostAdvanceMicros(uint64_t us) { advance(us); }
+uint64_t hostMicros() { return virtualMicros; }
+void hostSetTimeHook(HostTimeHook hook) { timeHook = hook; }
+
+uint32_t millis() { return (uint32_t)(virtualMicros / 1000); }
+uint32_t micros() { return (uint32_t)virtualMicros; }
+int64_t esp_timer_get_time() { return (int64_t)virtualMicros; }
+void delay(uint32_t ms) { advance((uint64_t)ms * 1000); }
+void yield() {}
+
+void hostSetButtons(bool action, bool back) {
+  actionDown = action;
+  backDown = back;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin == 2) return actionDown ? LOW : HIGH;
+  if (pin == 3) return backDown ? LOW : HIGH;
+  return HIGH;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+size_t HardwareSerial::write(const char* s, size_t n) {
+  if (getenv("HOST_SERIAL")) return fwrite(s, 1, n, stdout);
+  return n;
+}
+
+uint32_t EspClass::getFreeHeap() { return 200 * 1024; }
+
+uint32_t EspClass::getCycleCount() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 160000000ULL + (uint64_t)ts.tv_nsec * 16 / 100);
+}
+
+void esp_deep_sleep_start() {}
+
+// ---- Wi-Fi driver ----
+
+static std::vector<wifi_ap_record_t> scanResults;
+static wifi_promiscuous_cb_t promiscuousCb = nullptr;
+static bool promiscuousOn = false;
+static uint8_t radioChannel = 1;
+
+void hostSetScanResults(const wifi_ap_record_t* aps, uint16_t count) {
+  scanResults.assign(aps, aps + count);
+}
+
+bool hostPromiscuousEnabled() { return promiscuousOn && promiscuousCb; }
+uint8_t hostRadioChannel() { return radioChannel; }
+
+void hostDeliverFrame(void* buf, wifi_promiscuous_pkt_type_t type) {
+  if (hostPromiscuousEnabled()) promiscuousCb(buf, type);
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t*) { return ESP_OK; }
+esp_err_t esp_wifi_set_mode(wifi_mode_t) { return ESP_OK; }
+esp_err_t esp_wifi_start() { return ESP_OK; }
+esp_err_t esp_wifi_stop() { promiscuousOn = false; return ESP_OK; }
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t) {
+  radioChannel = primary;
+  return ESP_OK;
+}
+esp_err_t esp_wifi_set_promiscuous(bool en) { promiscuousOn = en; return ESP_OK; }
+esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb) { promiscuousCb = cb; return ESP_OK; }
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t*, bool) { return ESP_OK; }
+esp_err_t esp_wifi_scan_stop() { return ESP_OK; }
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number) {
+  *number = (uint16_t)scanResults.size();
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* records) {
+  uint16_t n = *number < scanResults.size() ? *number : (uint16_t)scanResults.size();
+  for (uint16_t i = 0; i < n; i++) records[i] = scanResults[i];
+  *number = n;
+  return ESP_OK;
+}
+
+// ---- Preferences ----
+
+static std::map<std::string, std::vector<uint8_t>> nvsStore;
+
+bool Preferences::begin(const char* name, bool) {
+  ns_ = name;
+  return true;
+}
+
+bool Preferences::clear() {
+  for (auto it = nvsStore.begin(); it != nvsStore.end();) {
+    if (it->first.compare(0, ns_.size() + 1, ns_ + "/") == 0) it = nvsStore.erase(it);
+    else ++it;
+  }
+  return true;
+}
+
+bool Preferences::remove(const char* key) { return nvsStore.erase(ns_ + "/" + key) > 0; }
+
+size_t Preferences::put(const char* key, const void* value, size_t len) {
+  const uint8_t* p = (const uint8_t*)value;
+  nvsStore[ns_ + "/" + key].assign(p, p + len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  auto it = nvsStore.find(ns_ + "/" + key);
+  return it == nvsStore.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  auto it = nvsStore.find(ns_ + "/" + key);
+  if (it == nvsStore.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+// ---- BLE ----
+
+static BLEScan bleScan;
+static std::vector<BLEAdvertisedDevice> bleQueue;
+static bool bleScanActive = false;
+
+BLEScan* BLEDevice::getScan() { return &bleScan; }
+
+bool hostBLEScanActive() { return bleScanActive; }
+
+void hostQueueBLEAdvert(const BLEAdvertisedDevice& dev) { bleQueue.push_back(dev); }
+
+void hostFlushBLEAdverts() {
+  std::vector<BLEAdvertisedDevice> pending;
+  pending.swap(bleQueue);
+  if (!bleScan.callbacks) return;
+  for (const BLEAdvertisedDevice& d : pending) bleScan.callbacks->onResult(d);
+}
+
+// Adverts queued before the scan and during its window are reported when
+// the blocking scan returns.
+BLEScanResults BLEScan::start(uint32_t duration, bool) {
+  bleScanActive = true;
+  advance((uint64_t)duration * 1000000);
+  bleScanActive = false;
+  hostFlushBLEAdverts();
+  return BLEScanResults();
+}
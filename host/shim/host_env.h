@@ -0,0 +1,36 @@
+// Controls the host builds use to drive the shimmed Arduino/ESP-IDF world:
+// a virtual clock, the injected scan results, the radio state and the BLE
+// advertisement queue.
+#ifndef HOST_ENV_H
+#define HOST_ENV_H
+
+#include <stdint.h>
+#include "esp_wifi.h"
+
+class BLEAdvertisedDevice;
+
+void hostSetMicros(uint64_t us);
+void hostAdvanceMicros(uint64_t us);
+uint64_t hostMicros();
+
+// Called whenever virtual time moves forward (delay(), a blocking BLE scan,
+// hostAdvanceMicros()) with the interval being skipped. A hook may step the
+// clock forward inside [from, to) with hostSetMicros() to deliver traffic at
+// its own timestamps, the way the Wi-Fi task keeps running while loop()
+// blocks.
+typedef void (*HostTimeHook)(uint64_t fromUs, uint64_t toUs);
+void hostSetTimeHook(HostTimeHook hook);
+
+void hostSetScanResults(const wifi_ap_record_t* aps, uint16_t count);
+
+bool hostPromiscuousEnabled();
+uint8_t hostRadioChannel();
+void hostDeliverFrame(void* buf, wifi_promiscuous_pkt_type_t type);
+
+bool hostBLEScanActive();
+void hostQueueBLEAdvert(const BLEAdvertisedDevice& dev);
+void hostFlushBLEAdverts();
+
+void hostSetButtons(bool actionDown, bool backDown);
+
+#endif
@@ -0,0 +1,24 @@
+// Forced ahead of every firmware source by the esp32util_target_types
+// check. It gives the fixed-width integers the types the ESP32 toolchain
+// gives them: int32_t is long and uint32_t unsigned long there, not int and
+// unsigned int as on Linux. A min() or max() that mixes them with int, or
+// a call that only resolves with the host's types, then fails to compile
+// here just as it does for the target. The objects are never linked: long
+// is 64 bits on the host, so the numbers they would compute are wrong.
+#ifndef HOST_TARGET_TYPES_H
+#define HOST_TARGET_TYPES_H
+
+// Keep glibc's own typedefs out
+#define _BITS_STDINT_INTN_H 1
+#define _BITS_STDINT_UINTN_H 1
+
+typedef signed char int8_t;
+typedef short int16_t;
+typedef long int32_t;
+typedef long long int64_t;
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned long uint32_t;
+typedef unsigned long long uint64_t;
+
+#endif
@@ -0,0 +1,94 @@
+#include "U8g2lib.h"
+
+// First two bytes of each "font" are the glyph cell width and height.
+const uint8_t u8g2_font_4x6_tf[] = {4, 6};
+const uint8_t u8g2_font_5x7_tf[] = {5, 7};
+const uint8_t u8g2_font_6x10_tf[] = {6, 10};
+
+void U8G2::firstPage() {
+  page_ = 0;
+  memset(pageBuf_, 0, sizeof(pageBuf_));
+}
+
+uint8_t U8G2::nextPage() {
+  memcpy(&framebuffer[page_ * WIDTH], pageBuf_, WIDTH);
+  pagesFlushed++;
+  page_++;
+  if (page_ >= HEIGHT / PAGE_ROWS) return 0;
+  memset(pageBuf_, 0, sizeof(pageBuf_));
+  return 1;
+}
+
+void U8G2::drawPixel(int x, int y) {
+  if (x < 0 || x >= WIDTH) return;
+  int row = y - page_ * PAGE_ROWS;
+  if (row < 0 || row >= PAGE_ROWS) return;
+  if (color_) pageBuf_[x] |= (uint8_t)(1 << row);
+  else pageBuf_[x] &= (uint8_t)~(1 << row);
+}
+
+void U8G2::drawHLine(int x, int y, int w) {
+  for (int i = 0; i < w; i++) drawPixel(x + i, y);
+}
+
+void U8G2::drawVLine(int x, int y, int h) {
+  for (int i = 0; i < h; i++) drawPixel(x, y + i);
+}
+
+void U8G2::drawLine(int x0, int y0, int x1, int y1) {
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    drawPixel(x0, y0);
+    if (x0 == x1 && y0 == y1) break;
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void U8G2::drawFrame(int x, int y, int w, int h) {
+  if (w <= 0 || h <= 0) return;
+  drawHLine(x, y, w);
+  drawHLine(x, y + h - 1, w);
+  drawVLine(x, y, h);
+  drawVLine(x + w - 1, y, h);
+}
+
+void U8G2::drawBox(int x, int y, int w, int h) {
+  for (int i = 0; i < h; i++) drawHLine(x, y + i, w);
+}
+
+int U8G2::drawGlyph(int x, int y, char c) {
+  int w = font_[0], h = font_[1];
+  uint8_t bits = (uint8_t)c * 37u + 11u;
+  for (int gy = 0; gy < h - 1; gy++) {
+    for (int gx = 0; gx < w - 1; gx++) {
+      if ((bits >> ((gx + gy * 3) & 7)) & 1) drawPixel(x + gx, y - h + 2 + gy);
+    }
+  }
+  return w;
+}
+
+int U8G2::drawStr(int x, int y, const char* s) {
+  int start = x;
+  for (; *s; s++) x += drawGlyph(x, y, *s);
+  return x - start;
+}
+
+size_t U8G2::write(const char* s, size_t n) {
+  for (size_t i = 0; i < n; i++) tx_ += drawGlyph(tx_, ty_, s[i]);
+  return n;
+}
+
+bool U8G2::pixel(int x, int y) const {
+  if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return false;
+  return (framebuffer[(y / PAGE_ROWS) * WIDTH + x] >> (y % PAGE_ROWS)) & 1;
+}
+
+uint32_t U8G2::frameHash() const {
+  uint32_t h = 2166136261u;
+  for (uint8_t b : framebuffer) h = (h ^ b) * 16777619u;
+  return h;
+}
@@ -0,0 +1,1420 @@
+// Synthetic RF environment for scale testing. Generates N access points
+// beaconing on their channels (weak ones losing some beacons), M associated clients sending data and probe
+// requests, K BLE advertisers with rotating random addresses, and scripted
+// incidents (an evil twin, a second radio cloning an AP's beacons, an AP
+// restarting, a beacon flood, a Karma AP answering probes for every SSID,
+// an AP deauthing its own clients, a forged deauth and disassoc burst, an
+// AP switching channel, a forged channel switch announcement, a client
+// with the wrong passphrase retrying its handshake, clients roaming to
+// another AP). Traffic is fed
+// to the firmware through the same entry points the radio uses: the scan
+// result mock, the promiscuous callback (only while the radio sits on the
+// frame's channel) and the BLE scan callback (only while a scan is open).
+//
+// Each phase boots a fresh firmware in a child process, navigates to its
+// screen with button presses and runs it for a fixed stretch of virtual
+// time, then scores what the screen found against the generated truth.
+// --pcap PREFIX also writes what each phase heard to PREFIX-<phase>.pcap,
+// for esp32util_replay.
+//
+//   esp32util_sim [--aps N] [--clients M] [--ble K] [--seed S]
+//                 [--phase-sec T] [--flood-bssids F] [--deauth-rate R]
+//                 [--pcap PREFIX]
+//   esp32util_sim --sweep[=10,100,1000,3000] [options]
+#include <cmath>
+#include <queue>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "wifi_scanner.h"
+#include "ble_scanner.h"
+#include "device_monitor.h"
+#include "security.h"
+#include "flood_detector.h"
+#include "cardinality.h"
+#include "assoc_graph.h"
+#include "beacon_loss.h"
+#include "retries.h"
+#include "deauth_detector.h"
+#include "seq_watch.h"
+#include "tsf_watch.h"
+#include "karma_detector.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
+#include "menu.h"
+#include "screens.h"
+#include "host_env.h"
+
+void setup();
+void loop();
+
+#define BEACON_INTERVAL_US 102400
+#define SCAN_REFRESH_US 1000000
+#define FLOOD_CHANNEL 6
+#define FLOOD_SEC 18  // outlasts Auto Watch's 17 s maximum revisit interval
+#define DEAUTH_SEC 10
+#define KICK_SEC 3      // an AP deauths its own clients...
+#define KICK_RATE 20    // ...this many a second, under the bound for an AP's own deauths
+#define ATTACK_SEQ 3000 // where the attacker's sequence counter starts
+#define CLONE_UPTIME_SEC 5400  // the cloning radio's TSF, and its crystal
+#define CLONE_PPM 9
+#define KARMA_CHANNEL 11
+#define KARMA_LOUD 5    // collected SSIDs a loud-mode Mana AP offers on each probe
+#define KARMA_PROBE_US 250000  // phones near it scanning its channel, one probe each this often
+#define SWITCH_COUNT 10 // beacons an AP announces its channel switch in
+#define FAKE_CSA_SEC 8  // forged announcements in AP 0's name...
+#define FAKE_CSA_COUNT 3  // ...always this many beacons to go
+#define WRONG_KEY_CLIENT 0       // its AP answers message 2 with a new message 1, never message 3
+#define EAPOL_STEP_US 4000       // between the messages of a handshake
+#define EAPOL_RETRY_US 200000    // the AP's retry of message 1...
+#define EAPOL_TRIES 4            // ...this many times before the client gives up...
+#define EAPOL_BACKOFF_US 500000  // ...and associates again after this long
+#define ROAM_EVERY 5  // every fifth client moves to another AP during Device Monitor
+#define FRAME_BUF_SIZE 1700
+
+struct SimConfig {
+  uint32_t aps = 40;
+  uint32_t clients = 60;
+  uint32_t ble = 30;
+  uint64_t seed = 1;
+  uint32_t phaseSec = 30;
+  uint32_t floodBssids = 200;
+  uint32_t deauthRate = 100;
+  uint32_t rotateSec = 20;
+  double dataPerSec = 4.0;
+  double probeEverySec = 8.0;
+  const char* pcapPrefix = nullptr;
+};
+
+enum SimPhase { PHASE_AUTO_WATCH, PHASE_DEVICE_MONITOR, PHASE_DEAUTH_WATCH, PHASE_COUNT };
+static const char* phaseNames[PHASE_COUNT] = { "auto-watch", "device-monitor", "deauth-watch" };
+
+// Written by the child over a pipe, so plain data only.
+struct PhaseResult {
+  uint64_t events;
+  uint64_t frames;
+  uint64_t adverts;
+  uint64_t virtualMs;
+  double cpuSec;
+  long maxRssKb;
+
+  uint16_t apListed, apTopHits, apTopExpected;
+  bool twinFlagged, cloneFlagged, clockFlagged;
+  uint16_t cloneFalse, clockFalse;
+  uint16_t tsfTimed;
+  float tsfDriftErr, tsfJitter;
+  bool karmaFlagged;
+  uint16_t karmaFalse;
+  uint32_t probeResponses, karmaResponses;
+  uint16_t hiddenFound, hiddenTrue, hiddenExpected;
+  uint16_t bleEntries, bleStale, bleExpected;
+  uint32_t wifiSeenEst, wifiSeenTrue, bleSeenEst, bleSeenTrue;
+  uint32_t floodBeacons;
+  uint16_t lossMeasured, lossListed;
+  float lossMeanErr, lossMaxTrue;
+  uint16_t widthRight, loadParsed, loadSent;
+  uint32_t duplicates, retransmissions;
+  uint16_t retryChannels;
+  float retryMeanErr;
+  int32_t floodLatencyMs;
+  uint16_t floodFalseAlarms;
+
+  uint16_t wifiDevices, wifiDevicesTrue, wifiExpected, bleDevicesMonitored;
+  uint16_t deviceSlots;
+  uint32_t deviceEvictions;
+  uint16_t assocMapped, assocRight, roamsExpected, roamsFound, roamsFalse;
+
+  int32_t deauthLatencyMs;
+  uint16_t falseAlarms;
+  uint32_t forgedFlagged, forgedHeard, kicksGenuine, kicksHeard;
+  uint32_t disassocCounted, disassocHeard;
+  bool csaFlagged, switchFlagged;
+  uint16_t csaFalse;
+  uint32_t csaForgedHeard, switchHeard;
+  bool authFlagged;
+  uint16_t authFalse;
+  uint32_t handshakesCounted, handshakesHeard;
+};
+
+// ---- generator ----
+
+struct Rng {
+  uint64_t s;
+  uint64_t next() {
+    uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+  uint32_t below(uint32_t n) { return (uint32_t)(uniform() * n); }
+  uint64_t expUs(double meanSec) { return 1 + (uint64_t)(-log(1.0 - uniform()) * meanSec * 1e6); }
+};
+
+struct SimAP {
+  uint8_t bssid[6];
+  char ssid[MAX_SSID_LEN + 1];
+  uint8_t channel;
+  int8_t rssi;
+  wifi_auth_mode_t auth;
+  uint8_t lossPct;  // beacons lost on the way to the sniffer
+  int8_t secondary;  // HT Operation: +1 / -1 for 40 MHz, 0 for 20 MHz
+  bool bssLoad;      // sends a BSS Load element
+  uint8_t utilization;
+  uint16_t stations;
+  bool hidden;
+  bool probed;
+  uint64_t activeFrom;
+  uint64_t activeUntil;
+  uint16_t seq;
+  int64_t tsfZero;  // virtual time its TSF read 0
+  int16_t ppm;      // its crystal against ours
+  uint8_t csaChannel;  // announcing a switch there, 0 = not switching
+  uint8_t csaCount;    // beacons to go
+};
+
+struct SimClient {
+  uint8_t mac[6];
+  uint32_t ap;
+  int8_t rssi;
+  uint16_t seq;
+  bool roamed;
+  uint8_t eapolStep;  // last handshake message sent, 0 between handshakes
+  uint8_t eapolTries;
+};
+
+struct SimAdvertiser {
+  int8_t rssi;
+  uint32_t intervalUs;
+  uint64_t rotateOffsetUs;
+  bool named;
+  bool apple;
+};
+
+enum SimEventKind { EV_BEACON, EV_DATA, EV_PROBE, EV_ADVERT, EV_DEAUTH, EV_SCAN_REFRESH, EV_ROAM, EV_CLONE, EV_RESTART,
+                    EV_SWITCH, EV_FAKE_CSA, EV_EAPOL,
+                    EV_KARMA_PROBE };
+
+struct SimEvent {
+  uint64_t t;
+  uint8_t kind;
+  uint32_t id;
+  bool operator>(const SimEvent& o) const { return t > o.t; }
+};
+
+struct SimWorld {
+  SimConfig cfg;
+  Rng rng;
+  Rng lossRng;  // kept apart so beacon loss leaves the rest of the scenario unchanged
+  std::vector<SimAP> aps;        // [0, N) real, N the evil twin, then flood BSSIDs
+  std::vector<SimClient> clients;
+  std::vector<SimAdvertiser> advertisers;
+  std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> queue;
+  std::unordered_map<std::string, uint64_t> issuedAddrs;  // address -> advertiser << 32 | epoch
+  std::unordered_set<uint64_t> heardTx;  // transmitters of frames sent on the tuned channel, scanned BSSIDs
+
+  uint64_t floodStart = UINT64_MAX, floodEnd = 0;
+  uint64_t deauthStart = UINT64_MAX, deauthEnd = 0;
+  uint64_t kickEnd = 0;
+  uint32_t switcher = UINT32_MAX;
+  uint64_t fakeCsaEnd = 0;
+  uint16_t attackSeq = ATTACK_SEQ;  // forged frames count on their own
+  uint32_t restarted = UINT32_MAX;
+  uint64_t karmaStart = UINT64_MAX;
+  uint8_t karmaBssid[6];
+  uint16_t karmaSeq = 0;
+  uint32_t karmaNext = 0;  // next collected SSID it offers
+  uint32_t karmaProber = 0;  // next client to probe on its channel
+  FILE* pcap = nullptr;
+
+  uint64_t events = 0;
+  uint64_t frames = 0;
+  uint64_t adverts = 0;
+  uint32_t floodBeacons = 0;
+  uint32_t retransmissions = 0;
+  uint32_t forgedSent = 0, forgedHeard = 0, kicksHeard = 0, disassocHeard = 0;
+  uint32_t csaForgedHeard = 0, switchHeard = 0;
+  uint32_t handshakesHeard = 0;  // every message of a complete handshake heard
+  uint32_t probeResponses = 0, karmaResponses = 0;
+  uint32_t sequenced[MAX_CHANNEL + 1] = {};
+  uint32_t retried[MAX_CHANNEL + 1] = {};
+};
+
+static SimWorld world;
+static uint8_t frameBuf[FRAME_BUF_SIZE];
+
+static uint32_t twinIndex() { return world.cfg.aps; }
+static uint32_t floodIndex(uint32_t i) { return world.cfg.aps + 1 + i; }
+
+static void schedule(uint64_t t, SimEventKind kind, uint32_t id) {
+  world.queue.push(SimEvent{t, (uint8_t)kind, id});
+}
+
+static void makeMac(uint8_t* mac, uint8_t prefix, uint32_t id) {
+  mac[0] = prefix;
+  mac[1] = 0x5A;
+  mac[2] = (uint8_t)(id >> 24);
+  mac[3] = (uint8_t)(id >> 16);
+  mac[4] = (uint8_t)(id >> 8);
+  mac[5] = (uint8_t)id;
+}
+
+static uint8_t pickChannel(Rng& r) {
+  static const uint8_t common[] = {1, 6, 11};
+  return r.uniform() < 0.7 ? common[r.below(3)] : (uint8_t)(1 + r.below(MAX_CHANNEL));
+}
+
+static void buildWorld(const SimConfig& cfg) {
+  world.cfg = cfg;
+  world.rng.s = cfg.seed;
+  world.lossRng.s = cfg.seed ^ 0x5DEECE66DULL;
+  Rng& r = world.rng;
+
+  uint32_t total = cfg.aps + 1 + cfg.floodBssids;
+  world.aps.resize(total);
+  for (uint32_t i = 0; i < total; i++) {
+    SimAP& ap = world.aps[i];
+    memset(&ap, 0, sizeof(ap));
+    makeMac(ap.bssid, 0x02, i);
+    ap.channel = pickChannel(r);
+    ap.rssi = (int8_t)(-92 + (int)r.below(60));
+    ap.auth = r.uniform() < 0.1 ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+    ap.hidden = i > 0 && i < cfg.aps && r.uniform() < 0.1;
+    ap.activeUntil = UINT64_MAX;
+    snprintf(ap.ssid, sizeof(ap.ssid), ap.hidden ? "Hidden%04u" : "Net%04u", i);
+  }
+
+  // AP 0 is the network being impersonated: an encrypted network cloned by
+  // an open AP that sits close to the victim, as an attacker would.
+  if (cfg.aps > 0) {
+    world.aps[0].rssi = -38;
+    world.aps[0].auth = WIFI_AUTH_WPA2_PSK;
+  }
+  SimAP& twin = world.aps[twinIndex()];
+  strcpy(twin.ssid, cfg.aps > 0 ? world.aps[0].ssid : "Net0000");
+  twin.channel = cfg.aps > 0 ? world.aps[0].channel : 1;
+  twin.rssi = -41;
+  twin.auth = WIFI_AUTH_OPEN;
+  // Every fourth AP bonds two channels and every third reports its load;
+  // taken from the index so the random streams stay as they were
+  for (uint32_t i = 0; i < total; i++) {
+    SimAP& ap = world.aps[i];
+    ap.lossPct = ap.rssi < -70 ? std::min(80, (-70 - ap.rssi) * 3) : 0;
+    ap.secondary = i % 4 == 1 ? (ap.channel <= 7 ? 1 : -1) : 0;
+    ap.bssLoad = i % 3 == 0;
+    ap.utilization = (uint8_t)(20 + i * 37 % 200);
+    ap.stations = (uint16_t)(i % 40);
+    ap.tsfZero = -(int64_t)(600 + i * 7919 % 86400) * 1000000;
+    ap.ppm = (int16_t)(i * 13 % 41) - 20;
+  }
+
+  for (uint32_t i = 0; i < cfg.floodBssids; i++) {
+    SimAP& ap = world.aps[floodIndex(i)];
+    snprintf(ap.ssid, sizeof(ap.ssid), "FREE-%04X", (unsigned)r.below(0x10000));
+    ap.channel = FLOOD_CHANNEL;
+    ap.activeFrom = UINT64_MAX;
+    ap.activeUntil = 0;
+  }
+
+  makeMac(world.karmaBssid, 0x0A, 0);
+
+  world.clients.resize(cfg.aps ? cfg.clients : 0);
+  for (uint32_t i = 0; i < world.clients.size(); i++) {
+    SimClient& c = world.clients[i];
+    makeMac(c.mac, 0x06, i);
+    c.ap = r.below(cfg.aps);
+    c.rssi = (int8_t)(-90 + (int)r.below(55));
+    c.seq = 0;
+    c.roamed = false;
+    c.eapolStep = 0;
+    c.eapolTries = 0;
+    world.aps[c.ap].probed |= world.aps[c.ap].hidden;
+  }
+
+  world.advertisers.resize(cfg.ble);
+  for (uint32_t i = 0; i < cfg.ble; i++) {
+    SimAdvertiser& a = world.advertisers[i];
+    a.rssi = (int8_t)(-95 + (int)r.below(60));
+    a.intervalUs = 100000 + r.below(900000);
+    a.rotateOffsetUs = r.uniform() * cfg.rotateSec * 1e6;
+    a.named = r.uniform() < 0.3;
+    a.apple = r.uniform() < 0.25;
+  }
+}
+
+static void startTraffic(uint64_t now) {
+  Rng& r = world.rng;
+  for (uint32_t i = 0; i <= twinIndex(); i++) {
+    schedule(now + r.below(BEACON_INTERVAL_US), EV_BEACON, i);
+  }
+  for (uint32_t i = 0; i < world.clients.size(); i++) {
+    schedule(now + r.expUs(1.0 / world.cfg.dataPerSec), EV_DATA, i);
+    schedule(now + r.expUs(world.cfg.probeEverySec), EV_PROBE, i);
+  }
+  for (uint32_t i = 0; i < world.advertisers.size(); i++) {
+    schedule(now + r.below(world.advertisers[i].intervalUs), EV_ADVERT, i);
+  }
+  schedule(now, EV_SCAN_REFRESH, 0);
+}
+
+static void startFlood(uint64_t at) {
+  world.floodStart = at;
+  world.floodEnd = at + FLOOD_SEC * 1000000ULL;
+  for (uint32_t i = 0; i < world.cfg.floodBssids; i++) {
+    SimAP& ap = world.aps[floodIndex(i)];
+    ap.activeFrom = world.floodStart;
+    ap.activeUntil = world.floodEnd;
+    schedule(at + world.rng.below(BEACON_INTERVAL_US), EV_BEACON, floodIndex(i));
+  }
+}
+
+static void startRoaming(uint64_t at) {
+  if (world.cfg.aps < 2) return;
+  for (uint32_t i = 0; i < world.clients.size(); i += ROAM_EVERY) {
+    schedule(at + world.rng.below(1000000), EV_ROAM, i);
+  }
+}
+
+static void startDeauth(uint64_t at) {
+  world.deauthStart = at;
+  world.deauthEnd = at + DEAUTH_SEC * 1000000ULL;
+  schedule(at, EV_DEAUTH, 0);
+}
+
+// A burst the strongest other AP sends itself, e.g. when it restarts; not
+// an attack
+static void startKick(uint64_t at) {
+  if (world.cfg.aps < 2) return;
+  uint32_t kicker = 1;
+  for (uint32_t i = 2; i < world.cfg.aps; i++) {
+    if (world.aps[i].rssi > world.aps[kicker].rssi) kicker = i;
+  }
+  world.kickEnd = at + KICK_SEC * 1000000ULL;
+  schedule(at, EV_DEAUTH, kicker);
+}
+
+// The strongest AP other than 0 announces a move to another channel, and
+// makes it
+static void startSwitch(uint64_t at) {
+  if (world.cfg.aps < 2) return;
+  uint32_t id = 1;
+  for (uint32_t i = 2; i < world.cfg.aps; i++) {
+    if (world.aps[i].rssi > world.aps[id].rssi) id = i;
+  }
+  world.switcher = id;
+  schedule(at, EV_SWITCH, id);
+}
+
+// An attacker tells AP 0's clients it is moving, in beacons and action
+// frames, while AP 0 stays where it is
+static void startFakeCsa(uint64_t at) {
+  if (world.cfg.aps == 0) return;
+  world.fakeCsaEnd = at + FAKE_CSA_SEC * 1000000ULL;
+  schedule(at, EV_FAKE_CSA, 0);
+}
+
+// Every client runs one 4-way handshake at a time taken from its index,
+// spread over span; the wrong-key client starts at once and keeps retrying
+static void startHandshakes(uint64_t at, uint64_t span) {
+  for (uint32_t i = 0; i < world.clients.size(); i++) {
+    uint64_t t = i == WRONG_KEY_CLIENT ? at : at + span * (i * 7919 % 1000) / 1000;
+    schedule(t, EV_EAPOL, i);
+  }
+}
+
+// Beacons with AP 0's BSSID from a second radio
+static void startClone(uint64_t at) {
+  if (world.cfg.aps == 0) return;
+  schedule(at, EV_CLONE, 0);
+}
+
+// The strongest AP other than 0 restarts, so its TSF starts over from 0
+static void startRestart(uint64_t at) {
+  if (world.cfg.aps < 2) return;
+  uint32_t id = 1;
+  for (uint32_t i = 2; i < world.cfg.aps; i++) {
+    if (world.aps[i].rssi > world.aps[id].rssi) id = i;
+  }
+  schedule(at, EV_RESTART, id);
+}
+
+// From then on a Karma AP on KARMA_CHANNEL answers every probe it hears,
+// and the clients near it keep probing there, so a hopping radio hears it
+// on each visit
+static void startKarma(uint64_t at) {
+  if (world.cfg.aps == 0) return;
+  world.karmaStart = at;
+  if (!world.clients.empty()) schedule(at, EV_KARMA_PROBE, 0);
+}
+
+// ---- delivery ----
+
+static uint64_t tsfAt(int64_t zero, int ppm, uint64_t now) {
+  int64_t up = (int64_t)now - zero;
+  return (uint64_t)(up + up / 1000000 * ppm);
+}
+
+// Bare 802.11 frames without FCS, stamped with virtual time
+static void openPcap(SimPhase phase) {
+  std::string path = std::string(world.cfg.pcapPrefix) + "-" + phaseNames[phase] + ".pcap";
+  world.pcap = fopen(path.c_str(), "wb");
+  if (!world.pcap) return;
+  uint32_t hdr[6] = {0xA1B2C3D4, 2 | (4 << 16), 0, 0, 65535, 105};
+  fwrite(hdr, sizeof(hdr), 1, world.pcap);
+}
+
+static bool onAir(uint8_t ch) {
+  return hostPromiscuousEnabled() && hostRadioChannel() == ch;
+}
+
+static uint8_t* beginFrame(uint8_t fc0, uint8_t fc1, const uint8_t* a1, const uint8_t* a2,
+                           const uint8_t* a3, uint16_t& seq) {
+  wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)frameBuf;
+  uint8_t* f = pkt->payload;
+  memset(f, 0, 24);
+  f[0] = fc0;
+  f[1] = fc1;
+  memcpy(f + 4, a1, 6);
+  memcpy(f + 10, a2, 6);
+  memcpy(f + 16, a3, 6);
+  f[22] = (uint8_t)(seq << 4);
+  f[23] = (uint8_t)(seq >> 4);
+  seq = (seq + 1) & 0x0FFF;
+  return f;
+}
+
+// len is the MAC frame without FCS; mcs < 0 sends at 1 Mbps DSSS.
+static void sendFrame(wifi_promiscuous_pkt_type_t type, uint8_t ch, int8_t rssi, uint16_t len, int mcs) {
+  wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)frameBuf;
+  wifi_pkt_rx_ctrl_t& rx = pkt->rx_ctrl;
+  memset(&rx, 0, sizeof(rx));
+  rx.rssi = rssi + (int)world.rng.below(5) - 2;
+  rx.noise_floor = -95;
+  rx.channel = ch;
+  rx.timestamp = (uint32_t)hostMicros();
+  rx.sig_len = len + 4;
+  if (mcs >= 0) {
+    rx.sig_mode = 1;
+    rx.mcs = mcs;
+  } else {
+    rx.rate = WIFI_PHY_RATE_1M_L;
+  }
+  world.frames++;
+  if (type != WIFI_PKT_CTRL) {
+    world.sequenced[ch]++;
+    if (pkt->payload[1] & 0x08) world.retried[ch]++;
+    uint64_t k = 0;
+    for (int i = 10; i < 16; i++) k = (k << 8) | pkt->payload[i];
+    world.heardTx.insert(k);
+  }
+  if (world.pcap) {
+    uint64_t t = hostMicros();
+    uint32_t rec[4] = {(uint32_t)(t / 1000000), (uint32_t)(t % 1000000), len, len};
+    fwrite(rec, sizeof(rec), 1, world.pcap);
+    fwrite(pkt->payload, len, 1, world.pcap);
+  }
+  hostDeliverFrame(pkt, type);
+}
+
+static const uint8_t BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static void sendBeacon(SimAP& ap, uint16_t& seq, uint64_t tsf) {
+  uint8_t* f = beginFrame(0x80, 0x00, BROADCAST, ap.bssid, ap.bssid, seq);
+  uint8_t* ie = f + 24;
+  memset(ie, 0, 12);
+  for (int i = 0; i < 8; i++) ie[i] = (uint8_t)(tsf >> (8 * i));
+  ie[8] = (uint8_t)(BEACON_INTERVAL_US / 1024);
+  ie[10] = ap.auth == WIFI_AUTH_OPEN ? 0x01 : 0x11;
+  ie += 12;
+  uint8_t ssidLen = ap.hidden ? 0 : (uint8_t)strlen(ap.ssid);
+  *ie++ = 0;
+  *ie++ = ssidLen;
+  memcpy(ie, ap.ssid, ssidLen);
+  ie += ssidLen;
+  static const uint8_t rates[] = {1, 8, 0x82, 0x84, 0x8B, 0x96, 0x0C, 0x12, 0x18, 0x24};
+  memcpy(ie, rates, sizeof(rates));
+  ie += sizeof(rates);
+  *ie++ = 3;
+  *ie++ = 1;
+  *ie++ = ap.channel;
+  if (ap.csaChannel) {
+    uint8_t csa[] = {37, 3, 1, ap.csaChannel, ap.csaCount};
+    memcpy(ie, csa, sizeof(csa));
+    ie += sizeof(csa);
+  }
+  if (ap.bssLoad) {
+    uint8_t load[] = {11, 5, (uint8_t)ap.stations, (uint8_t)(ap.stations >> 8), ap.utilization, 0, 0};
+    memcpy(ie, load, sizeof(load));
+    ie += sizeof(load);
+  }
+  *ie++ = 61;
+  *ie++ = 22;
+  memset(ie, 0, 22);
+  ie[0] = ap.channel;
+  if (ap.secondary) ie[1] = 0x04 | (ap.secondary > 0 ? 1 : 3);
+  ie += 22;
+  sendFrame(WIFI_PKT_MGMT, ap.channel, ap.rssi, (uint16_t)(ie - f), -1);
+}
+
+// Weak links lose more ACKs; each retry goes out as an exact copy of the
+// frame still in the buffer
+static void resendLast(wifi_promiscuous_pkt_type_t type, uint8_t ch, int8_t rssi, uint16_t len, int mcs) {
+  frameBuf[offsetof(wifi_promiscuous_pkt_t, payload) + 1] |= 0x08;  // Retry
+  sendFrame(type, ch, rssi, len, mcs);
+  world.retransmissions++;
+}
+
+static void sendRetries(wifi_promiscuous_pkt_type_t type, uint8_t ch, int8_t rssi, uint16_t len, int mcs) {
+  uint32_t retryPct = rssi < -75 ? 40 : 8;
+  for (int n = 0; n < 3 && world.lossRng.below(100) < retryPct; n++) resendLast(type, ch, rssi, len, mcs);
+}
+
+static void sendData(SimClient& c) {
+  SimAP& ap = world.aps[c.ap];
+  bool up = world.rng.uniform() < 0.5;
+  uint8_t* f = up ? beginFrame(0x08, 0x01, ap.bssid, c.mac, ap.bssid, c.seq)
+                  : beginFrame(0x08, 0x02, c.mac, ap.bssid, ap.bssid, ap.seq);
+  static const uint8_t ipv4[] = {0xAA, 0xAA, 0x03, 0, 0, 0, 0x08, 0x00};
+  memcpy(f + 24, ipv4, sizeof(ipv4));
+  uint16_t len = 24 + 40 + world.rng.below(1460);
+  int mcs = world.rng.below(8);
+  int8_t rssi = up ? c.rssi : ap.rssi;
+  sendFrame(WIFI_PKT_DATA, ap.channel, rssi, len, mcs);
+  sendRetries(WIFI_PKT_DATA, ap.channel, rssi, len, mcs);
+}
+
+// Message 1-4 of a WPA2 4-way handshake; nonces, MICs and key data are
+// left zero
+static bool sendEapol(SimClient& c, uint8_t msg) {
+  SimAP& ap = world.aps[c.ap];
+  if (!onAir(ap.channel)) return false;
+  bool fromAp = msg == 1 || msg == 3;
+  uint8_t* f = fromAp ? beginFrame(0x08, 0x02, c.mac, ap.bssid, ap.bssid, ap.seq)
+                      : beginFrame(0x08, 0x01, ap.bssid, c.mac, ap.bssid, c.seq);
+  static const uint16_t keyInfo[4] = {0x008A, 0x010A, 0x13CA, 0x030A};
+  static const uint8_t keyData[4] = {0, 22, 56, 0};
+  uint16_t body = 95 + keyData[msg - 1];
+  uint8_t* p = f + 24;
+  static const uint8_t snap[] = {0xAA, 0xAA, 0x03, 0, 0, 0, 0x88, 0x8E};
+  memcpy(p, snap, sizeof(snap));
+  p += sizeof(snap);
+  memset(p, 0, 4 + body);
+  p[0] = 2;
+  p[1] = 3;
+  p[2] = (uint8_t)(body >> 8);
+  p[3] = (uint8_t)body;
+  p[4] = 2;
+  p[5] = (uint8_t)(keyInfo[msg - 1] >> 8);
+  p[6] = (uint8_t)keyInfo[msg - 1];
+  p[8] = 16;
+  p[16] = c.eapolTries + 1;  // replay counter
+  p[4 + 94] = keyData[msg - 1];
+  sendFrame(WIFI_PKT_DATA, ap.channel, fromAp ? ap.rssi : c.rssi, (uint16_t)(24 + 8 + 4 + body), -1);
+  return true;
+}
+
+// Clients of hidden networks have to name them; everyone else sends a
+// wildcard probe. Probes go out on whatever channel the client is scanning.
+static void sendProbe(SimClient& c, uint8_t ch) {
+  SimAP& ap = world.aps[c.ap];
+  uint8_t* f = beginFrame(0x40, 0x00, BROADCAST, c.mac, BROADCAST, c.seq);
+  uint8_t ssidLen = ap.hidden ? (uint8_t)strlen(ap.ssid) : 0;
+  f[24] = 0;
+  f[25] = ssidLen;
+  memcpy(f + 26, ap.ssid, ssidLen);
+  sendFrame(WIFI_PKT_MGMT, ch, c.rssi, 26 + ssidLen, -1);
+}
+
+// A switching AP repeats its announcement in probe responses. Returns the
+// frame's length, the frame itself staying in the buffer.
+static uint16_t sendProbeResponse(const uint8_t* bssid, const uint8_t* client, const char* ssid, uint8_t ch,
+                                  int8_t rssi, uint16_t& seq, uint64_t tsf, uint8_t csaChannel = 0,
+                                  uint8_t csaCount = 0) {
+  uint8_t* f = beginFrame(0x50, 0x00, client, bssid, bssid, seq);
+  uint8_t* ie = f + 24;
+  memset(ie, 0, 12);
+  for (int i = 0; i < 8; i++) ie[i] = (uint8_t)(tsf >> (8 * i));
+  ie[8] = (uint8_t)(BEACON_INTERVAL_US / 1024);
+  ie[10] = 0x11;
+  ie += 12;
+  uint8_t ssidLen = (uint8_t)strlen(ssid);
+  *ie++ = 0;
+  *ie++ = ssidLen;
+  memcpy(ie, ssid, ssidLen);
+  ie += ssidLen;
+  *ie++ = 3;
+  *ie++ = 1;
+  *ie++ = ch;
+  if (csaChannel) {
+    uint8_t csa[] = {37, 3, 1, csaChannel, csaCount};
+    memcpy(ie, csa, sizeof(csa));
+    ie += sizeof(csa);
+  }
+  uint16_t len = (uint16_t)(ie - f);
+  sendFrame(WIFI_PKT_MGMT, ch, rssi, len, -1);
+  world.probeResponses++;
+  return len;
+}
+
+// A probe naming a network is answered by that network only; a wildcard
+// one by every visible AP on the channel. The Karma AP answers for the
+// name asked, plus a few of the SSIDs it has collected.
+static void answerProbe(SimClient& c, uint8_t ch, uint64_t now) {
+  SimAP& wanted = world.aps[c.ap];
+  bool directed = wanted.hidden;
+  for (uint32_t i = 0; i <= twinIndex(); i++) {
+    SimAP& ap = world.aps[i];
+    if (ap.channel != ch || (directed ? &ap != &wanted : ap.hidden)) continue;
+    uint16_t len = sendProbeResponse(ap.bssid, c.mac, ap.ssid, ch, ap.rssi, ap.seq, tsfAt(ap.tsfZero, ap.ppm, now),
+                                     ap.csaChannel, ap.csaCount);
+    sendRetries(WIFI_PKT_MGMT, ch, ap.rssi, len, -1);
+  }
+
+  if (now < world.karmaStart || ch != KARMA_CHANNEL) return;
+  uint64_t tsf = tsfAt(-(int64_t)CLONE_UPTIME_SEC * 1000000, CLONE_PPM, now);
+  if (directed) {
+    sendProbeResponse(world.karmaBssid, c.mac, wanted.ssid, ch, -50, world.karmaSeq, tsf);
+    world.karmaResponses++;
+  }
+  for (int n = 0; n < KARMA_LOUD; n++) {
+    const SimAP& ap = world.aps[world.karmaNext++ % world.cfg.aps];
+    sendProbeResponse(world.karmaBssid, c.mac, ap.ssid, ch, -50, world.karmaSeq, tsf);
+    world.karmaResponses++;
+  }
+}
+
+static void sendDeauth(SimAP& ap, uint16_t& seq, bool disassoc) {
+  uint8_t* f = beginFrame(disassoc ? 0xA0 : 0xC0, 0x00, BROADCAST, ap.bssid, ap.bssid, seq);
+  f[24] = disassoc ? 8 : 7;
+  f[25] = 0;
+  sendFrame(WIFI_PKT_MGMT, ap.channel, ap.rssi, 26, -1);
+}
+
+// Spectrum management action frame carrying a CSA element
+static void sendCsaAction(SimAP& ap, uint16_t& seq, uint8_t channel, uint8_t count) {
+  uint8_t* f = beginFrame(0xD0, 0x00, BROADCAST, ap.bssid, ap.bssid, seq);
+  uint8_t body[] = {0, 4, 37, 3, 1, channel, count};
+  memcpy(f + 24, body, sizeof(body));
+  sendFrame(WIFI_PKT_MGMT, ap.channel, ap.rssi, 24 + sizeof(body), -1);
+}
+
+static std::string advertiserAddress(uint32_t id, uint64_t epoch) {
+  Rng r{world.cfg.seed ^ ((uint64_t)id << 24) ^ (epoch * 0x2545F4914F6CDD1DULL)};
+  uint64_t v = r.next();
+  char s[18];
+  snprintf(s, sizeof(s), "%02x:%02x:%02x:%02x:%02x:%02x",
+           (unsigned)(((v >> 40) & 0xFF) | 0xC0), (unsigned)((v >> 32) & 0xFF),
+           (unsigned)((v >> 24) & 0xFF), (unsigned)((v >> 16) & 0xFF),
+           (unsigned)((v >> 8) & 0xFF), (unsigned)(v & 0xFF));
+  return s;
+}
+
+static uint64_t advertiserEpoch(uint32_t id, uint64_t now) {
+  return (now + world.advertisers[id].rotateOffsetUs) / (world.cfg.rotateSec * 1000000ULL);
+}
+
+static void sendAdvert(uint32_t id, uint64_t now) {
+  const SimAdvertiser& a = world.advertisers[id];
+  uint64_t epoch = advertiserEpoch(id, now);
+  std::string addr = advertiserAddress(id, epoch);
+  world.issuedAddrs[addr] = ((uint64_t)id << 32) | epoch;
+
+  BLEAdvertisedDevice dev;
+  dev.address = BLEAddress(addr);
+  dev.rssi = a.rssi + (int)world.rng.below(7) - 3;
+  if (a.named) dev.name = "Dev" + std::to_string(id);
+  if (a.apple) dev.manufacturerData = std::string("\x4C\x00\x10\x05", 4);
+  world.adverts++;
+  hostQueueBLEAdvert(dev);
+}
+
+// What a scan would return right now: nearer APs are found more reliably,
+// and the driver reports them strongest first.
+static void refreshScanResults(uint64_t now) {
+  std::vector<wifi_ap_record_t> seen;
+  for (const SimAP& ap : world.aps) {
+    if (now < ap.activeFrom || now >= ap.activeUntil) continue;
+    double p = (ap.rssi + 95) / 30.0;
+    if (world.rng.uniform() >= p) continue;
+    wifi_ap_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.bssid, ap.bssid, 6);
+    if (!ap.hidden) memcpy(rec.ssid, ap.ssid, strlen(ap.ssid));
+    rec.primary = ap.channel;
+    rec.rssi = ap.rssi;
+    rec.authmode = ap.auth;
+    rec.phy_11b = rec.phy_11g = rec.phy_11n = 1;
+    seen.push_back(rec);
+  }
+  std::stable_sort(seen.begin(), seen.end(),
+                   [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) { return a.rssi > b.rssi; });
+  for (size_t i = 0; i < seen.size() && i < MAX_APS; i++) {
+    uint64_t k = 0;
+    for (int b = 0; b < 6; b++) k = (k << 8) | seen[i].bssid[b];
+    world.heardTx.insert(k);
+  }
+  hostSetScanResults(seen.data(), (uint16_t)std::min<size_t>(seen.size(), 0xFFFF));
+}
+
+static void dispatch(const SimEvent& e, uint64_t now) {
+  Rng& r = world.rng;
+  world.events++;
+  switch (e.kind) {
+    case EV_BEACON: {
+      SimAP& ap = world.aps[e.id];
+      if (now >= ap.activeUntil) break;
+      if (onAir(ap.channel) && world.lossRng.below(100) >= ap.lossPct) {
+        sendBeacon(ap, ap.seq, tsfAt(ap.tsfZero, ap.ppm, now));
+        if (e.id > twinIndex()) world.floodBeacons++;
+        if (ap.csaChannel) world.switchHeard++;
+      }
+      if (ap.csaChannel && ap.csaCount-- == 0) {
+        ap.channel = ap.csaChannel;
+        ap.csaChannel = 0;
+      }
+      schedule(e.t + BEACON_INTERVAL_US, EV_BEACON, e.id);
+      break;
+    }
+    case EV_DATA: {
+      SimClient& c = world.clients[e.id];
+      if (onAir(world.aps[c.ap].channel)) sendData(c);
+      schedule(now + r.expUs(1.0 / world.cfg.dataPerSec), EV_DATA, e.id);
+      break;
+    }
+    case EV_PROBE: {
+      uint8_t ch = 1 + r.below(MAX_CHANNEL);
+      if (onAir(ch)) {
+        sendProbe(world.clients[e.id], ch);
+        answerProbe(world.clients[e.id], ch, now);
+      }
+      schedule(now + r.expUs(world.cfg.probeEverySec), EV_PROBE, e.id);
+      break;
+    }
+    case EV_ADVERT:
+      if (hostBLEScanActive()) sendAdvert(e.id, now);
+      schedule(now + world.advertisers[e.id].intervalUs + r.below(10000), EV_ADVERT, e.id);
+      break;
+    case EV_DEAUTH: {
+      // id 0 forges AP 0's address, any other id is that AP itself
+      uint64_t end = e.id ? world.kickEnd : world.deauthEnd;
+      if (now >= end || world.cfg.aps <= e.id) break;
+      SimAP& ap = world.aps[e.id];
+      bool disassoc = !e.id && (world.forgedSent++ & 1);
+      if (onAir(ap.channel)) {
+        sendDeauth(ap, e.id ? ap.seq : world.attackSeq, disassoc);
+        if (e.id) world.kicksHeard++;
+        else world.forgedHeard++;
+        if (disassoc) world.disassocHeard++;
+      }
+      uint32_t rate = e.id ? KICK_RATE : std::max<uint32_t>(world.cfg.deauthRate, 1);
+      schedule(e.t + 1000000 / rate, EV_DEAUTH, e.id);
+      break;
+    }
+    case EV_CLONE:
+      if (onAir(world.aps[0].channel)) {
+        sendBeacon(world.aps[0], world.attackSeq,
+                   tsfAt(-(int64_t)CLONE_UPTIME_SEC * 1000000, CLONE_PPM, now));
+      }
+      schedule(e.t + BEACON_INTERVAL_US, EV_CLONE, 0);
+      break;
+    case EV_RESTART:
+      world.aps[e.id].tsfZero = now;
+      world.restarted = e.id;
+      break;
+    case EV_SWITCH: {
+      // Announced while the radio sits on the AP's channel, so the
+      // genuine switch is heard and judged at all
+      SimAP& ap = world.aps[e.id];
+      if (!onAir(ap.channel)) {
+        schedule(now + 10000, EV_SWITCH, e.id);
+        break;
+      }
+      ap.csaChannel = ap.channel % 11 + 1;
+      ap.csaCount = SWITCH_COUNT;
+      // A client probes it as the countdown starts and the AP misses the
+      // ACK for the answer, so the announcement is also heard as a copy
+      for (SimClient& c : world.clients) {
+        if (&world.aps[c.ap] != &ap) continue;
+        sendProbe(c, ap.channel);
+        uint16_t len = sendProbeResponse(ap.bssid, c.mac, ap.ssid, ap.channel, ap.rssi, ap.seq,
+                                         tsfAt(ap.tsfZero, ap.ppm, now), ap.csaChannel, ap.csaCount);
+        resendLast(WIFI_PKT_MGMT, ap.channel, ap.rssi, len, -1);
+        break;
+      }
+      break;
+    }
+    case EV_EAPOL: {
+      // A wrong passphrase gets message 1 again instead of message 3
+      SimClient& c = world.clients[e.id];
+      uint8_t msg = ++c.eapolStep;
+      bool heard = sendEapol(c, msg);
+      if (e.id == WRONG_KEY_CLIENT && msg == 2) {
+        c.eapolStep = 0;
+        c.eapolTries = (c.eapolTries + 1) % EAPOL_TRIES;
+        schedule(now + (c.eapolTries ? EAPOL_RETRY_US : EAPOL_BACKOFF_US), EV_EAPOL, e.id);
+      } else if (msg < 4) {
+        schedule(now + EAPOL_STEP_US, EV_EAPOL, e.id);
+      } else {
+        c.eapolStep = 0;
+        if (heard) world.handshakesHeard++;
+      }
+      break;
+    }
+    case EV_KARMA_PROBE: {
+      SimClient& c = world.clients[world.karmaProber++ % world.clients.size()];
+      if (onAir(KARMA_CHANNEL)) {
+        sendProbe(c, KARMA_CHANNEL);
+        answerProbe(c, KARMA_CHANNEL, now);
+      }
+      schedule(e.t + KARMA_PROBE_US, EV_KARMA_PROBE, 0);
+      break;
+    }
+    case EV_FAKE_CSA: {
+      // Beacons and action frames in turn, twice per beacon interval
+      if (now >= world.fakeCsaEnd) break;
+      SimAP fake = world.aps[0];
+      fake.csaChannel = fake.channel % 11 + 1;
+      fake.csaCount = FAKE_CSA_COUNT;
+      fake.rssi -= 3;
+      if (onAir(fake.channel)) {
+        if (world.csaForgedHeard++ & 1) {
+          sendCsaAction(fake, world.attackSeq, fake.csaChannel, fake.csaCount);
+        } else {
+          sendBeacon(fake, world.attackSeq, tsfAt(-(int64_t)CLONE_UPTIME_SEC * 1000000, CLONE_PPM, now));
+        }
+      }
+      schedule(e.t + BEACON_INTERVAL_US / 2, EV_FAKE_CSA, 0);
+      break;
+    }
+    case EV_SCAN_REFRESH:
+      refreshScanResults(now);
+      schedule(now + SCAN_REFRESH_US, EV_SCAN_REFRESH, 0);
+      break;
+    case EV_ROAM: {
+      SimClient& c = world.clients[e.id];
+      c.ap = (c.ap + 1 + r.below(world.cfg.aps - 1)) % world.cfg.aps;
+      c.roamed = true;
+      break;
+    }
+  }
+}
+
+// Runs every event due in the interval the firmware is about to skip over,
+// each at its own timestamp.
+static void simTimeHook(uint64_t fromUs, uint64_t toUs) {
+  while (!world.queue.empty() && world.queue.top().t < toUs) {
+    SimEvent e = world.queue.top();
+    world.queue.pop();
+    uint64_t now = std::max(e.t, fromUs);
+    hostSetMicros(now);
+    dispatch(e, now);
+  }
+}
+
+// ---- driving the firmware ----
+
+static bool prevAttack = false;
+static uint64_t firstOnsetUs = 0;
+static uint16_t falseAlarms = 0;
+static bool prevFlood = false;
+static uint64_t floodOnsetUs = 0;
+static uint16_t floodFalseAlarms = 0;
+
+static void step() {
+  loop();
+  if (attackActive && !prevAttack) {
+    uint64_t now = hostMicros();
+    if (now >= world.deauthStart && now <= world.deauthEnd + 2000000ULL) {
+      if (!firstOnsetUs) firstOnsetUs = now;
+    } else {
+      falseAlarms++;
+    }
+  }
+  prevAttack = attackActive;
+  if (beaconFloodActive && !prevFlood) {
+    uint64_t now = hostMicros();
+    if (now >= world.floodStart && now <= world.floodEnd + 2000000ULL) {
+      if (!floodOnsetUs) floodOnsetUs = now;
+    } else {
+      floodFalseAlarms++;
+    }
+  }
+  prevFlood = beaconFloodActive;
+}
+
+static void runFor(uint64_t us) {
+  uint64_t end = hostMicros() + us;
+  while (hostMicros() < end) step();
+}
+
+static void pressAction(uint32_t holdMs) {
+  hostSetButtons(true, false);
+  runFor((holdMs + 2 * DEBOUNCE_MS) * 1000ULL);
+  hostSetButtons(false, false);
+  for (int i = 0; i < 3; i++) step();
+}
+
+static void openMainMenuItem(uint8_t index) {
+  while (mainMenuIndex != index) pressAction(100);
+  pressAction(LONG_PRESS_MS + 100);
+}
+
+// ---- scoring ----
+
+static uint64_t macKey(const uint8_t* m) {
+  uint64_t k = 0;
+  for (int i = 0; i < 6; i++) k = (k << 8) | m[i];
+  return k;
+}
+
+static void scoreAutoWatch(PhaseResult& res, uint64_t now) {
+  std::vector<const SimAP*> truth;
+  for (uint32_t i = 0; i <= twinIndex() && i < world.aps.size(); i++) truth.push_back(&world.aps[i]);
+  std::stable_sort(truth.begin(), truth.end(), [](const SimAP* a, const SimAP* b) { return a->rssi > b->rssi; });
+  if (truth.size() > MAX_APS) truth.resize(MAX_APS);
+
+  std::unordered_set<uint64_t> listed;
+  for (int i = 0; i < apCount; i++) listed.insert(macKey(apList[i].bssid));
+  res.apListed = apCount;
+  res.apTopExpected = truth.size();
+  for (const SimAP* ap : truth) res.apTopHits += listed.count(macKey(ap->bssid));
+
+  if (world.cfg.aps > 0) {
+    for (int i = 0; i < rogueCount; i++) {
+      const RogueAP& rogue = rogueList[i];
+      bool victim = memcmp(rogue.bssid, world.aps[0].bssid, 6) == 0;
+      if (rogue.reason == ROGUE_CLONE) {
+        if (victim) res.cloneFlagged = true;
+        else res.cloneFalse++;
+      } else if (rogue.reason == ROGUE_CLOCK) {
+        if (victim) res.clockFlagged = true;
+        else res.clockFalse++;
+      } else if (strcmp(rogue.ssid, world.aps[0].ssid) == 0) {
+        res.twinFlagged = true;
+      }
+    }
+  }
+
+  uint32_t hiddenTotal = 0;
+  for (uint32_t i = 0; i < world.cfg.aps; i++) hiddenTotal += world.aps[i].probed;
+  res.hiddenExpected = std::min<uint32_t>(hiddenTotal, MAX_HIDDEN_SSIDS);
+  res.hiddenFound = hiddenCount;
+  for (int i = 0; i < hiddenCount; i++) {
+    unsigned id;
+    if (sscanf(hiddenList[i].ssid, "Hidden%u", &id) == 1 && id < world.cfg.aps && world.aps[id].probed) {
+      res.hiddenTrue++;
+    }
+  }
+
+  res.bleExpected = std::min<uint32_t>(world.cfg.ble, MAX_BLE_DEVICES);
+  for (int i = 0; i < bleDeviceCount; i++) {
+    if (!bleDevices[i].isActive) continue;
+    res.bleEntries++;
+    auto it = world.issuedAddrs.find(bleDevices[i].address.c_str());
+    if (it == world.issuedAddrs.end()) continue;
+    uint32_t id = (uint32_t)(it->second >> 32);
+    if ((uint32_t)it->second != advertiserEpoch(id, now)) res.bleStale++;
+  }
+  res.floodBeacons = world.floodBeacons;
+
+  std::unordered_map<uint64_t, const SimAP*> byBssid;
+  for (const SimAP& ap : world.aps) byBssid[macKey(ap.bssid)] = &ap;
+  float errSum = 0;
+  for (int i = 0; i < apCount; i++) {
+    auto it = byBssid.find(macKey(apList[i].bssid));
+    if (it == byBssid.end()) continue;
+    res.lossListed++;
+    int8_t loss = beaconLossPct(apList[i].bssid);
+    if (loss < 0) continue;
+    res.lossMeasured++;
+    errSum += fabsf(loss - it->second->lossPct);
+    res.lossMaxTrue = std::max(res.lossMaxTrue, (float)it->second->lossPct);
+  }
+  for (int i = 0; i < apCount; i++) {
+    auto it = byBssid.find(macKey(apList[i].bssid));
+    if (it == byBssid.end()) continue;
+    const SimAP& ap = *it->second;
+    if (apSecondaryOffset(apList[i]) == ap.secondary) res.widthRight++;
+    if (!ap.bssLoad) continue;
+    res.loadSent++;
+    uint8_t util;
+    uint16_t stations;
+    if (beaconBssLoad(apList[i].bssid, &util, &stations) && stations == ap.stations &&
+        util == (ap.utilization * 100 + 127) / 255) {
+      res.loadParsed++;
+    }
+  }
+  res.lossMeanErr = res.lossMeasured ? errSum / res.lossMeasured : 0;
+
+  // Our clock is exact here, so the drift measured is the AP's crystal
+  errSum = 0;
+  float jitterSum = 0;
+  for (int i = 0; i < apCount; i++) {
+    auto it = byBssid.find(macKey(apList[i].bssid));
+    int16_t drift;
+    uint16_t jitter;
+    if (it == byBssid.end() || it->second == &world.aps[0] ||
+        !tsfStats(apList[i].bssid, &drift, &jitter)) {
+      continue;
+    }
+    res.tsfTimed++;
+    errSum += abs(drift - it->second->ppm);
+    jitterSum += jitter;
+  }
+  res.tsfDriftErr = res.tsfTimed ? errSum / res.tsfTimed : 0;
+
+  res.karmaFlagged = karmaFlagged(world.karmaBssid);
+  res.karmaFalse = karmaDetected - res.karmaFlagged;
+  res.probeResponses = world.probeResponses;
+  res.karmaResponses = world.karmaResponses;
+  res.tsfJitter = res.tsfTimed ? jitterSum / res.tsfTimed : 0;
+
+  res.duplicates = retryDuplicates;
+  res.retransmissions = world.retransmissions;
+  errSum = 0;
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    int8_t retry = channelRetryPct(ch);
+    if (retry < 0 || world.sequenced[ch] == 0) continue;
+    res.retryChannels++;
+    errSum += fabsf(retry - 100.0f * world.retried[ch] / world.sequenced[ch]);
+  }
+  res.retryMeanErr = res.retryChannels ? errSum / res.retryChannels : 0;
+
+  // The phase is shorter than ten minutes, so that window covers all of it
+  res.wifiSeenEst = wifiDevicesSeen(CARD_10MIN);
+  res.wifiSeenTrue = world.heardTx.size();
+  res.bleSeenEst = bleDevicesSeen(CARD_10MIN);
+  res.bleSeenTrue = world.issuedAddrs.size();
+}
+
+static void scoreDeviceMonitor(PhaseResult& res) {
+  std::unordered_set<uint64_t> truth;
+  for (const SimClient& c : world.clients) truth.insert(macKey(c.mac));
+  res.wifiExpected = std::min<uint32_t>(world.clients.size(), deviceCapacity);
+  res.deviceSlots = deviceCapacity;
+  res.deviceEvictions = deviceTableStats.evictions;
+  for (uint16_t i = 0; i < deviceCapacity; i++) {
+    if (!deviceActive(i)) continue;
+    if (monitoredDevices[i].type != 0) {
+      res.bleDevicesMonitored++;
+      continue;
+    }
+    res.wifiDevices++;
+    res.wifiDevicesTrue += truth.count(deviceKey[i] & 0xFFFFFFFFFFFFULL);
+  }
+
+  for (const SimClient& c : world.clients) {
+    uint8_t bssid[6], roams;
+    res.roamsExpected += c.roamed;
+    if (!assocStationAp(c.mac, bssid, &roams)) continue;
+    res.assocMapped++;
+    res.assocRight += memcmp(bssid, world.aps[c.ap].bssid, 6) == 0;
+    if (c.roamed) res.roamsFound += roams > 0;
+    else res.roamsFalse += roams > 0;
+  }
+}
+
+static PhaseResult runPhase(const SimConfig& cfg, SimPhase phase) {
+  PhaseResult res;
+  memset(&res, 0, sizeof(res));
+
+  buildWorld(cfg);
+  if (cfg.pcapPrefix) openPcap(phase);
+  hostSetTimeHook(simTimeHook);
+  setup();
+  startTraffic(hostMicros());
+
+  switch (phase) {
+    case PHASE_AUTO_WATCH:
+      openMainMenuItem(0);
+      break;
+    case PHASE_DEVICE_MONITOR:
+      openMainMenuItem(4);
+      break;
+    case PHASE_DEAUTH_WATCH:
+      openMainMenuItem(7);
+      securityMenuIndex = 0;
+      pressAction(LONG_PRESS_MS + 100);
+      break;
+    default:
+      break;
+  }
+
+  uint64_t phaseStart = hostMicros();
+  uint64_t third = cfg.phaseSec * 1000000ULL / 3;
+  if (phase == PHASE_AUTO_WATCH) startFlood(phaseStart + third);
+  if (phase == PHASE_AUTO_WATCH) startClone(phaseStart + third / 2);
+  if (phase == PHASE_AUTO_WATCH) startRestart(phaseStart + third);
+  if (phase == PHASE_AUTO_WATCH) startKarma(phaseStart + third / 2);
+  if (phase == PHASE_DEAUTH_WATCH) startKick(phaseStart + third / 2);
+  if (phase == PHASE_DEAUTH_WATCH) startDeauth(phaseStart + third);
+  if (phase == PHASE_DEAUTH_WATCH) startSwitch(phaseStart + third / 2 + KICK_SEC * 1000000ULL);
+  if (phase == PHASE_DEAUTH_WATCH) startFakeCsa(phaseStart + 2 * third);
+  if (phase == PHASE_DEAUTH_WATCH) startHandshakes(phaseStart, cfg.phaseSec * 1000000ULL);
+  if (phase == PHASE_DEVICE_MONITOR) startRoaming(phaseStart + third);
+  prevAttack = attackActive;
+  prevFlood = beaconFloodActive;
+  runFor(cfg.phaseSec * 1000000ULL);
+
+  uint64_t now = hostMicros();
+  if (phase == PHASE_AUTO_WATCH) scoreAutoWatch(res, now);
+  if (phase == PHASE_DEVICE_MONITOR) scoreDeviceMonitor(res);
+  res.deauthLatencyMs = firstOnsetUs ? (int32_t)((firstOnsetUs - world.deauthStart) / 1000) : -1;
+  res.falseAlarms = falseAlarms;
+  res.forgedFlagged = deauthSpoofedTotal;
+  res.forgedHeard = world.forgedHeard;
+  res.kicksGenuine = deauthGenuineTotal;
+  res.kicksHeard = world.kicksHeard;
+  res.disassocCounted = totalDisassocDetected;
+  res.disassocHeard = world.disassocHeard;
+  if (phase == PHASE_DEAUTH_WATCH && cfg.aps > 0) {
+    res.csaFlagged = csaFlagged(world.aps[0].bssid);
+    res.switchFlagged = world.switcher != UINT32_MAX && csaFlagged(world.aps[world.switcher].bssid);
+    res.csaFalse = csaDetected - res.csaFlagged;
+  }
+  if (phase == PHASE_DEAUTH_WATCH && world.clients.size() > WRONG_KEY_CLIENT) {
+    const SimClient& c = world.clients[WRONG_KEY_CLIENT];
+    res.authFlagged = eapolFlagged(c.mac, world.aps[c.ap].bssid);
+    res.authFalse = authStorms - res.authFlagged;
+  }
+  res.handshakesCounted = eapolHandshakes;
+  res.handshakesHeard = world.handshakesHeard;
+  res.csaForgedHeard = world.csaForgedHeard;
+  res.switchHeard = world.switchHeard;
+  res.floodLatencyMs = floodOnsetUs ? (int32_t)((floodOnsetUs - world.floodStart) / 1000) : -1;
+  res.floodFalseAlarms = floodFalseAlarms;
+  res.events = world.events;
+  res.frames = world.frames;
+  res.adverts = world.adverts;
+  res.virtualMs = now / 1000;
+  if (world.pcap) fclose(world.pcap);
+  return res;
+}
+
+// Each phase runs in its own process so every screen starts from a fresh
+// firmware and its CPU time and peak RSS can be read back separately.
+static bool runPhaseIsolated(const SimConfig& cfg, SimPhase phase, PhaseResult& out) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  fflush(stdout);
+
+  struct rusage before;
+  getrusage(RUSAGE_CHILDREN, &before);
+
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    close(fds[0]);
+    PhaseResult res = runPhase(cfg, phase);
+    bool ok = write(fds[1], &res, sizeof(res)) == (ssize_t)sizeof(res);
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  bool ok = read(fds[0], &out, sizeof(out)) == (ssize_t)sizeof(out);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  struct rusage after;
+  getrusage(RUSAGE_CHILDREN, &after);
+  out.cpuSec = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) +
+               (after.ru_stime.tv_sec - before.ru_stime.tv_sec) +
+               ((after.ru_utime.tv_usec - before.ru_utime.tv_usec) +
+                (after.ru_stime.tv_usec - before.ru_stime.tv_usec)) / 1e6;
+  out.maxRssKb = after.ru_maxrss;
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ---- reports ----
+
+static size_t firmwareTableBytes() {
+  return sizeof(apList) + sizeof(hiddenList) + sizeof(rogueList) + sizeof(bleDevices);
+}
+
+static void printReport(const SimConfig& cfg, const PhaseResult* r) {
+  printf("scenario       %u APs, %u clients, %u BLE advertisers, seed %llu, %u s per phase\n",
+         cfg.aps, cfg.clients, cfg.ble, (unsigned long long)cfg.seed, cfg.phaseSec);
+  printf("firmware       %zu bytes of AP/BLE tables, %u device slots\n", firmwareTableBytes(),
+         r[PHASE_DEVICE_MONITOR].deviceSlots);
+  printf("phase              events     frames    adverts   cpu s  maxrss KB\n");
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    printf("%-16s %8llu %10llu %10llu %7.2f %10ld\n", phaseNames[p],
+           (unsigned long long)r[p].events, (unsigned long long)r[p].frames,
+           (unsigned long long)r[p].adverts, r[p].cpuSec, r[p].maxRssKb);
+  }
+
+  const PhaseResult& a = r[PHASE_AUTO_WATCH];
+  printf("AP list        %u listed, %u/%u of the strongest\n", a.apListed, a.apTopHits, a.apTopExpected);
+  printf("evil twin      %s\n", a.twinFlagged ? "flagged" : "missed");
+  printf("cloned BSSID   %s, %u other BSSIDs flagged as cloned\n", a.cloneFlagged ? "flagged" : "missed", a.cloneFalse);
+  printf("beacon clocks  second TSF %s, %u other BSSIDs flagged (one AP restarted); drift within %.1f ppm, jitter %.1f us on %u listed APs\n",
+         a.clockFlagged ? "flagged" : "missed", a.clockFalse, a.tsfDriftErr, a.tsfJitter, a.tsfTimed);
+  printf("karma AP       %s, %u other BSSIDs flagged; %u of %u probe responses heard from it\n",
+         a.karmaFlagged ? "flagged" : "missed", a.karmaFalse, a.karmaResponses, a.probeResponses);
+  printf("hidden SSIDs   %u found, %u correct, %u expected\n", a.hiddenFound, a.hiddenTrue, a.hiddenExpected);
+  printf("BLE            %u active, %u stale addresses, %u expected\n", a.bleEntries, a.bleStale, a.bleExpected);
+  printf("device counts  WiFi ~%u of %u transmitters heard, BLE ~%u of %u addresses advertised\n",
+         a.wifiSeenEst, a.wifiSeenTrue, a.bleSeenEst, a.bleSeenTrue);
+  printf("beacon loss    %u of %u listed APs measured, mean error %.1f points (true loss up to %.0f%%)\n",
+         a.lossMeasured, a.lossListed, a.lossMeanErr, a.lossMaxTrue);
+  printf("retries        %u of %u retransmissions dropped as copies, retry rate on %u channels within %.1f points\n",
+         a.duplicates, a.retransmissions, a.retryChannels, a.retryMeanErr);
+  printf("AP elements    %u of %u listed widths right, BSS Load read from %u of %u that send it\n",
+         a.widthRight, a.lossListed, a.loadParsed, a.loadSent);
+  printf("beacon flood   %u beacons heard from %u BSSIDs, ", a.floodBeacons, cfg.floodBssids);
+  if (a.floodLatencyMs >= 0) printf("detected after %d ms", a.floodLatencyMs);
+  else printf("missed");
+  uint16_t floodFalse = 0;
+  for (int p = 0; p < PHASE_COUNT; p++) floodFalse += r[p].floodFalseAlarms;
+  printf(", %u false alarms\n", floodFalse);
+
+  const PhaseResult& d = r[PHASE_DEVICE_MONITOR];
+  printf("clients        %u monitored, %u correct, %u expected (%u BLE entries share the table, %u evictions)\n",
+         d.wifiDevices, d.wifiDevicesTrue, d.wifiExpected, d.bleDevicesMonitored, d.deviceEvictions);
+  printf("associations   %u of %u clients mapped, %u on the right AP; roams %u of %u found, %u false\n",
+         d.assocMapped, cfg.aps ? cfg.clients : 0, d.assocRight, d.roamsFound, d.roamsExpected, d.roamsFalse);
+
+  const PhaseResult& w = r[PHASE_DEAUTH_WATCH];
+  if (w.deauthLatencyMs >= 0) printf("deauth burst   detected after %d ms", w.deauthLatencyMs);
+  else printf("deauth burst   missed");
+  printf(", %u false alarms\n", w.falseAlarms);
+  printf("deauth seq     %u of %u forged deauths out of sequence, %u of %u AP deauths in sequence\n",
+         w.forgedFlagged, w.forgedHeard, w.kicksGenuine, w.kicksHeard);
+  printf("disassoc       %u of %u forged disassocs counted apart\n", w.disassocCounted, w.disassocHeard);
+  printf("channel switch forged %s (%u frames heard), %u others flagged; AP's own switch %s (%u announcing beacons heard)\n",
+         w.csaFlagged ? "flagged" : "missed", w.csaForgedHeard, w.csaFalse,
+         w.switchFlagged ? "flagged" : "not flagged", w.switchHeard);
+  printf("auth failures  wrong-key client %s, %u other pairs flagged; %u handshakes counted, %u heard whole\n",
+         w.authFlagged ? "flagged" : "missed", w.authFalse, w.handshakesCounted, w.handshakesHeard);
+}
+
+static void printSweepHeader() {
+  printf("n,m,k,cpu_s,maxrss_kb,events,frames,ap_top_hits,ap_top_expected,twin,"
+         "hidden_true,hidden_expected,ble_active,ble_stale,ble_expected,"
+         "clients_true,clients_expected,monitor_ble,deauth_latency_ms,false_alarms,"
+         "flood_latency_ms,flood_false_alarms,wifi_seen_est,wifi_seen_true,ble_seen_est,ble_seen_true,"
+         "assoc_right,roams_found,roams_expected,roams_false,loss_measured,loss_mean_err,"
+         "width_right,load_parsed,load_sent,duplicates,retransmissions,retry_mean_err,"
+         "clone_flagged,clone_false,forged_flagged,forged_heard,kicks_genuine,kicks_heard,"
+         "clock_flagged,clock_false,tsf_timed,tsf_drift_err,karma_flagged,karma_false,"
+         "disassoc_counted,disassoc_heard,csa_flagged,csa_false,auth_flagged,auth_false\n");
+}
+
+static void printSweepRow(const SimConfig& cfg, const PhaseResult* r) {
+  double cpu = 0;
+  long rss = 0;
+  uint64_t events = 0, frames = 0;
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    cpu += r[p].cpuSec;
+    rss = std::max(rss, r[p].maxRssKb);
+    events += r[p].events;
+    frames += r[p].frames;
+  }
+  const PhaseResult& a = r[PHASE_AUTO_WATCH];
+  const PhaseResult& d = r[PHASE_DEVICE_MONITOR];
+  const PhaseResult& w = r[PHASE_DEAUTH_WATCH];
+  uint16_t floodFalse = 0;
+  for (int p = 0; p < PHASE_COUNT; p++) floodFalse += r[p].floodFalseAlarms;
+  printf("%u,%u,%u,%.3f,%ld,%llu,%llu,%u,%u,%d,%u,%u,%u,%u,%u,%u,%u,%u,%d,%u,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.1f,%u,%u,%u,%u,%u,%.1f,%d,%u,%u,%u,%u,%u,%d,%u,%u,%.1f,%d,%u,%u,%u,%d,%u,%d,%u\n",
+         cfg.aps, cfg.clients, cfg.ble, cpu, rss,
+         (unsigned long long)events, (unsigned long long)frames,
+         a.apTopHits, a.apTopExpected, a.twinFlagged ? 1 : 0,
+         a.hiddenTrue, a.hiddenExpected, a.bleEntries, a.bleStale, a.bleExpected,
+         d.wifiDevicesTrue, d.wifiExpected, d.bleDevicesMonitored, w.deauthLatencyMs, w.falseAlarms,
+         a.floodLatencyMs, floodFalse, a.wifiSeenEst, a.wifiSeenTrue, a.bleSeenEst, a.bleSeenTrue,
+         d.assocRight, d.roamsFound, d.roamsExpected, d.roamsFalse, a.lossMeasured, a.lossMeanErr,
+         a.widthRight, a.loadParsed, a.loadSent, a.duplicates, a.retransmissions, a.retryMeanErr,
+         a.cloneFlagged ? 1 : 0, a.cloneFalse, w.forgedFlagged, w.forgedHeard, w.kicksGenuine, w.kicksHeard,
+         a.clockFlagged ? 1 : 0, a.clockFalse, a.tsfTimed, a.tsfDriftErr, a.karmaFlagged ? 1 : 0, a.karmaFalse,
+         w.disassocCounted, w.disassocHeard, w.csaFlagged ? 1 : 0, w.csaFalse,
+         w.authFlagged ? 1 : 0, w.authFalse);
+  fflush(stdout);
+}
+
+static bool runScenario(const SimConfig& cfg, PhaseResult* results) {
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    if (!runPhaseIsolated(cfg, (SimPhase)p, results[p])) {
+      fprintf(stderr, "phase %s failed\n", phaseNames[p]);
+      return false;
+    }
+  }
+  return true;
+}
+
+static std::vector<uint32_t> parseList(const char* s) {
+  std::vector<uint32_t> out;
+  while (*s) {
+    out.push_back((uint32_t)strtoul(s, (char**)&s, 10));
+    if (*s == ',') s++;
+    else break;
+  }
+  return out;
+}
+
+// A scripted incident the radio never heard proves nothing about its
+// detector; such a run fails
+static bool incidentsHeard(const SimConfig& cfg, const PhaseResult* r) {
+  bool ok = true;
+  if (cfg.aps > 0 && cfg.clients > 0 && r[PHASE_AUTO_WATCH].karmaResponses == 0) {
+    fprintf(stderr, "%u APs: no probe response from the Karma AP was heard\n", cfg.aps);
+    ok = false;
+  }
+  if (cfg.aps > 1 && r[PHASE_DEAUTH_WATCH].switchHeard == 0) {
+    fprintf(stderr, "%u APs: no beacon announcing the genuine channel switch was heard\n", cfg.aps);
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  SimConfig cfg;
+  std::vector<uint32_t> sweep;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (a == "--sweep") sweep = parseList("10,100,1000,3000");
+    else if (a.rfind("--sweep=", 0) == 0) sweep = parseList(a.c_str() + 8);
+    else if (v && a == "--aps") { cfg.aps = atoi(v); i++; }
+    else if (v && a == "--clients") { cfg.clients = atoi(v); i++; }
+    else if (v && a == "--ble") { cfg.ble = atoi(v); i++; }
+    else if (v && a == "--seed") { cfg.seed = strtoull(v, nullptr, 10); i++; }
+    else if (v && a == "--phase-sec") { cfg.phaseSec = std::max(3, atoi(v)); i++; }
+    else if (v && a == "--flood-bssids") { cfg.floodBssids = atoi(v); i++; }
+    else if (v && a == "--deauth-rate") { cfg.deauthRate = atoi(v); i++; }
+    else if (v && a == "--pcap") { cfg.pcapPrefix = v; i++; }
+    else {
+      fprintf(stderr,
+              "usage: %s [--aps N] [--clients M] [--ble K] [--seed S] [--phase-sec T]\n"
+              "          [--flood-bssids F] [--deauth-rate R] [--pcap PREFIX]\n"
+              "          [--sweep[=10,100,1000,3000]]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  PhaseResult results[PHASE_COUNT];
+  if (sweep.empty()) {
+    if (!runScenario(cfg, results)) return 1;
+    printReport(cfg, results);
+    return incidentsHeard(cfg, results) ? 0 : 1;
+  }
+
+  printSweepHeader();
+  bool heard = true;
+  for (uint32_t n : sweep) {
+    cfg.aps = cfg.clients = cfg.ble = n;
+    if (!runScenario(cfg, results)) return 1;
+    printSweepRow(cfg, results);
+    heard = incidentsHeard(cfg, results) && heard;
+  }
+  return heard ? 0 : 1;
+}
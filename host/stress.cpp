@@ -0,0 +1,155 @@
+// Concurrency check for the per-channel counters, run by ctest. A producer
+// thread stands in for the Wi-Fi task and calls sniffer() with beacons, data
+// and deauths in a fixed order across every channel while the main thread
+// stands in for loop() and keeps reading snapshots with
+// readChannelCounters(). The order fixes exactly what every counter must
+// hold after k frames, so each snapshot must match that prefix field for
+// field. A torn read would not, nor would one that went backwards. The last
+// snapshot must account for every frame sent.
+//
+//   esp32util_stress [--frames=N]
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "wifi_scanner.h"
+
+struct Frame {
+  wifi_pkt_rx_ctrl_t rx;
+  uint8_t payload[64];
+};
+
+enum Kind { K_BEACON, K_DATA, K_DEAUTH, K_COUNT };
+
+static const wifi_promiscuous_pkt_type_t kindType[K_COUNT] = {WIFI_PKT_MGMT, WIFI_PKT_DATA, WIFI_PKT_MGMT};
+
+static Frame frames[K_COUNT];
+static uint32_t kindAirUs[K_COUNT];
+static std::atomic<bool> producing(false);
+
+static void buildFrame(Frame& f, uint8_t fc0, uint8_t fc1) {
+  memset(&f, 0, sizeof(f));
+  f.payload[0] = fc0;
+  f.payload[1] = fc1;
+  for (int i = 0; i < 6; i++) {
+    f.payload[4 + i] = fc0 == 0x80 ? 0xFF : 0x10 + i;
+    f.payload[10 + i] = 0x20 + i;
+    f.payload[16 + i] = 0x20 + i;
+  }
+  f.rx.rssi = -55;
+  f.rx.rate = WIFI_PHY_RATE_24M;
+  f.rx.sig_len = sizeof(f.payload);
+}
+
+// Frame i goes out on channel 1 + i % MAX_CHANNEL, and each pass over the
+// channels moves on to the next kind
+static uint8_t frameChannel(unsigned long long i) { return 1 + i % MAX_CHANNEL; }
+static Kind frameKind(unsigned long long i) { return (Kind)(i / MAX_CHANNEL % K_COUNT); }
+
+static void send(unsigned long long i) {
+  Kind k = frameKind(i);
+  Frame& f = frames[k];
+  f.rx.channel = frameChannel(i);
+  // Every frame a new sequence number, so none is a retried copy
+  uint16_t seq = (uint16_t)(i << 4);
+  f.payload[22] = seq;
+  f.payload[23] = seq >> 8;
+  sniffer(&f, kindType[k]);
+}
+
+static void advance(ChannelCounters& c, unsigned long long i) {
+  uint8_t ch = frameChannel(i);
+  Kind k = frameKind(i);
+  c.total[ch]++;
+  if (k == K_BEACON) c.beacon[ch]++;
+  if (k == K_DATA) c.data[ch]++;
+  if (k == K_DEAUTH) c.deauth[ch]++;
+  c.airtimeUs[ch] += kindAirUs[k];
+  c.sequenced[ch]++;
+}
+
+// Snapshot s against the baseline b plus the expected deltas e
+static bool matches(const ChannelCounters& s, const ChannelCounters& b, const ChannelCounters& e) {
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    if (s.total[ch] - b.total[ch] != e.total[ch] || s.beacon[ch] - b.beacon[ch] != e.beacon[ch] ||
+        s.data[ch] - b.data[ch] != e.data[ch] || s.deauth[ch] - b.deauth[ch] != e.deauth[ch] ||
+        s.airtimeUs[ch] - b.airtimeUs[ch] != e.airtimeUs[ch] || s.retry[ch] != b.retry[ch] ||
+        s.sequenced[ch] - b.sequenced[ch] != e.sequenced[ch])
+      return false;
+  }
+  return true;
+}
+
+static unsigned long long framesSeen(const ChannelCounters& s, const ChannelCounters& b) {
+  unsigned long long n = 0;
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) n += s.total[ch] - b.total[ch];
+  return n;
+}
+
+int main(int argc, char** argv) {
+  unsigned long long total = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--frames=", 9)) {
+      total = strtoull(argv[i] + 9, nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--frames=N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  buildFrame(frames[K_BEACON], 0x80, 0x00);
+  buildFrame(frames[K_DATA], 0x08, 0x01);
+  buildFrame(frames[K_DEAUTH], 0xC0, 0x00);
+  enterSnifferMode(1);
+
+  // Each kind's airtime, as the callback itself works it out
+  ChannelCounters before, after;
+  for (int k = 0; k < K_COUNT; k++) {
+    frames[k].rx.channel = 1;
+    readChannelCounters(&before);
+    sniffer(&frames[k], kindType[k]);
+    readChannelCounters(&after);
+    kindAirUs[k] = after.airtimeUs[1] - before.airtimeUs[1];
+  }
+
+  ChannelCounters base, snap, expect;
+  readChannelCounters(&base);
+  memset(&expect, 0, sizeof(expect));
+
+  producing = true;
+  std::thread producer([total] {
+    for (unsigned long long i = 0; i < total; i++) send(i);
+    producing = false;
+  });
+
+  unsigned long long seen = 0, snapshots = 0, midway = 0, torn = 0, backwards = 0;
+  bool running = true;
+  while (running) {
+    running = producing;
+    readChannelCounters(&snap);
+    snapshots++;
+    unsigned long long n = framesSeen(snap, base);
+    if (n < seen || n > total) {
+      if (backwards++ == 0) printf("FAIL snapshot %llu: %llu frames after %llu\n", snapshots, n, seen);
+      continue;
+    }
+    if (n > 0 && n < total) midway++;
+    for (; seen < n; seen++) advance(expect, seen);
+    if (!matches(snap, base, expect)) {
+      if (torn++ == 0) printf("FAIL snapshot %llu: counters disagree after %llu frames\n", snapshots, n);
+    }
+  }
+  producer.join();
+
+  readChannelCounters(&snap);
+  for (; seen < total; seen++) advance(expect, seen);
+  bool whole = framesSeen(snap, base) == total && matches(snap, base, expect);
+  if (!whole) printf("FAIL final snapshot: counters do not sum to the %llu frames sent\n", total);
+
+  printf("%llu frames, %llu snapshots (%llu mid-stream), %llu torn, %llu went backwards\n", total, snapshots, midway,
+         torn, backwards);
+  return whole && !torn && !backwards ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// Regression checks run by ctest. Runs esp32util_sim over fixed seeds and
+// population sizes and checks the scores in its sweep CSV, then writes a
+// simulated Deauth Watch and Auto Watch capture and checks what
+// esp32util_replay reports for them. Last it drives the hop planner on the
+// virtual clock with most APs on a few channels, so the rest starve
+// together and fall due at once, and checks every channel is visited within
+// the profile's maximum revisit interval. Any failed check is printed and
+// the exit status is 1.
+//
+//   esp32util_test SIM REPLAY WORKDIR
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "host_env.h"
+#include "hop_planner.h"
+#include "wifi_scanner.h"
+
+typedef std::map<std::string, double> Row;
+
+static const unsigned SEEDS[] = {1, 2, 3};
+static const char* SIZES = "5,10,40,100";
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what, const std::string& where) {
+  if (ok) return;
+  printf("FAIL %s: %s\n", where.c_str(), what);
+  failures++;
+}
+
+// Runs cmd and returns its stdout; status gets the exit code, -1 if it did
+// not exit normally
+static std::string run(const std::string& cmd, int& status) {
+  std::string out;
+  FILE* p = popen(cmd.c_str(), "r");
+  if (!p) {
+    status = -1;
+    return out;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), p)) > 0) out.append(buf, n);
+  int s = pclose(p);
+  status = WIFEXITED(s) ? WEXITSTATUS(s) : -1;
+  return out;
+}
+
+static std::vector<std::string> split(const std::string& s, char sep) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (;;) {
+    size_t end = s.find(sep, start);
+    parts.push_back(s.substr(start, end - start));
+    if (end == std::string::npos) return parts;
+    start = end + 1;
+  }
+}
+
+static std::vector<Row> parseSweep(const std::string& csv) {
+  std::vector<Row> rows;
+  std::vector<std::string> header;
+  for (const std::string& line : split(csv, '\n')) {
+    if (line.empty()) continue;
+    std::vector<std::string> cells = split(line, ',');
+    if (cells[0] == "n") {
+      header = cells;
+      continue;
+    }
+    if (header.empty() || cells.size() != header.size()) continue;
+    Row r;
+    for (size_t i = 0; i < cells.size(); i++) r[header[i]] = atof(cells[i].c_str());
+    rows.push_back(r);
+  }
+  return rows;
+}
+
+// What every scripted incident must come to, whatever the population
+static void checkRow(const Row& r, const std::string& where) {
+  auto v = [&](const char* col) {
+    auto it = r.find(col);
+    if (it == r.end()) {
+      expect(false, (std::string("no column ") + col).c_str(), where);
+      return -1.0;
+    }
+    return it->second;
+  };
+  expect(v("twin") == 1, "evil twin missed", where);
+  expect(v("deauth_latency_ms") >= 0, "deauth burst missed", where);
+  expect(v("false_alarms") == 0, "deauth false alarm", where);
+  expect(v("flood_false_alarms") == 0, "beacon flood false alarm", where);
+  expect(v("flood_latency_ms") >= 0, "beacon flood missed", where);
+  expect(v("roams_false") == 0, "roam false positive", where);
+  expect(v("duplicates") == v("retransmissions"), "retransmissions not dropped as copies", where);
+  expect(v("clone_flagged") == 1, "cloned BSSID missed", where);
+  expect(v("clone_false") == 0, "BSSID falsely flagged as cloned", where);
+  expect(v("forged_flagged") == v("forged_heard"), "forged deauth judged in sequence", where);
+  expect(v("kicks_genuine") == v("kicks_heard"), "AP's own deauth judged forged", where);
+  expect(v("clock_false") == 0, "BSSID falsely flagged with two clocks", where);
+  expect(v("karma_flagged") == 1, "Karma AP missed", where);
+  expect(v("karma_false") == 0, "BSSID falsely flagged as Karma", where);
+  expect(v("disassoc_counted") == v("disassoc_heard"), "disassociations miscounted", where);
+  expect(v("csa_flagged") == 1, "forged channel switch missed", where);
+  expect(v("csa_false") == 0, "genuine channel switch flagged", where);
+  expect(v("auth_flagged") == 1, "wrong-passphrase client missed", where);
+  expect(v("auth_false") == 0, "pair falsely flagged for auth failures", where);
+}
+
+static void checkSim(const char* sim) {
+  for (unsigned seed : SEEDS) {
+    int status;
+    std::string cmd = std::string(sim) + " --seed " + std::to_string(seed) + " --sweep=" + SIZES;
+    std::vector<Row> rows = parseSweep(run(cmd, status));
+    std::string where = "sim seed " + std::to_string(seed);
+    expect(status == 0, "sim failed or an incident was never heard", where);
+    expect(rows.size() == split(SIZES, ',').size(), "sweep rows missing", where);
+    for (const Row& r : rows) checkRow(r, where + " n " + std::to_string((int)r.at("n")));
+  }
+}
+
+// The first line of out starting with label, with the label cut off
+static std::string field(const std::string& out, const char* label) {
+  for (const std::string& line : split(out, '\n')) {
+    if (line.compare(0, strlen(label), label) == 0) return line.substr(strlen(label));
+  }
+  return "";
+}
+
+static void checkReplay(const char* sim, const char* replay, const char* dir) {
+  int status;
+  std::string prefix = std::string(dir) + "/esp32util_test";
+  run(std::string(sim) + " --seed 1 --aps 40 --pcap " + prefix, status);
+  expect(status == 0, "sim could not write captures", "replay");
+
+  std::string out = run(std::string(replay) + " " + prefix + "-deauth-watch.pcap", status);
+  expect(status == 0, "replay of deauth-watch failed", "replay");
+  unsigned deauth = 0, disassoc = 0, onsets = 0, announced = 0, suspect = 0, frames = 0, done = 0, storms = 0;
+  sscanf(field(out, "deauth").c_str(), "%u deauth + %u disassoc frames, %u attack onsets", &deauth, &disassoc,
+         &onsets);
+  sscanf(field(out, "channel switch").c_str(), "%u announced, %u suspect", &announced, &suspect);
+  sscanf(field(out, "eapol").c_str(), "%u frames, %u handshakes completed, %u auth-failure storms", &frames,
+         &done, &storms);
+  expect(deauth > 0 && disassoc > 0, "deauth-watch: deauths or disassocs not counted", "replay");
+  expect(onsets > 0, "deauth-watch: no attack onset", "replay");
+  expect(announced >= 2 && suspect == 1, "deauth-watch: channel switches misjudged", "replay");
+  expect(done > 0 && storms >= 1, "deauth-watch: handshakes or auth-failure storm missed", "replay");
+
+  out = run(std::string(replay) + " " + prefix + "-auto-watch.pcap", status);
+  expect(status == 0, "replay of auto-watch failed", "replay");
+  expect(out.find("two clocks") != std::string::npos, "auto-watch: second TSF clock missed", "replay");
+  expect(field(out, "sniffer()").find("ring drops 0") != std::string::npos, "auto-watch: ingest ring dropped frames",
+         "replay");
+
+  for (const char* phase : {"auto-watch", "device-monitor", "deauth-watch"}) {
+    remove((prefix + "-" + phase + ".pcap").c_str());
+  }
+}
+
+// 20 APs: 14 on channel 6 and 3 each on 1 and 11, which weighs those three
+// at 32, 10 and 10 against 4 for every other channel
+static void checkHopPlanner() {
+  memset(apList, 0, sizeof(apList));
+  apCount = 20;
+  for (int i = 0; i < apCount; i++) apList[i].primary = i < 14 ? 6 : i < 17 ? 1 : 11;
+
+  struct {
+    const char* name;
+    const HopProfile* profile;
+  } profiles[] = {{"Auto Watch", &HOP_AUTO_WATCH},
+                  {"Deauth Watch", &HOP_DEAUTH_WATCH},
+                  {"Device Monitor", &HOP_DEVICE_MONITOR},
+                  {"Hidden SSID", &HOP_HIDDEN_SSID}};
+  for (const auto& run : profiles) {
+    const HopProfile& hp = *run.profile;
+    std::string where = std::string("hop planner ") + run.name;
+    hostSetMicros(1000000);
+    hopStart(hp, 6);
+    for (int ms = 0; ms < 10 * hp.maxRevisitMs; ms++) {
+      hostAdvanceMicros(1000);
+      hopUpdate();
+    }
+    for (uint8_t ch = hp.firstCh; ch <= hp.lastCh; ch++) {
+      const ChannelCoverage* c = hopCoverage(ch);
+      expect(c->visits > 0, ("channel " + std::to_string(ch) + " never visited").c_str(), where);
+    }
+    uint32_t worst = hopWorstGapMs();
+    if (worst > hp.maxRevisitMs) {
+      std::string what = "worst revisit gap " + std::to_string(worst) + " ms over " + std::to_string(hp.maxRevisitMs);
+      expect(false, what.c_str(), where);
+    }
+  }
+  apCount = 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s SIM REPLAY WORKDIR\n", argv[0]);
+    return 2;
+  }
+  checkSim(argv[1]);
+  checkReplay(argv[1], argv[2], argv[3]);
+  checkHopPlanner();
+  printf("%s, %d failed checks\n", failures ? "FAILED" : "passed", failures);
+  return failures ? 1 : 0;
+}
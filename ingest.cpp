@@ -0,0 +1,69 @@
+#include "ingest.h"
+#include "wifi_scanner.h"
+#include "device_monitor.h"
+#include "assoc_graph.h"
+#include <esp_timer.h>
+
+// Hand-off from the promiscuous callbacks to the loop. The callbacks only
+// count and copy: anything that touches flash (vendor table, printf, string
+// formatting) or takes unbounded time runs here, one loop later.
+//
+// Single producer (Wi-Fi task), single consumer (loop). Head and tail are
+// free-running; each side only writes its own index, and the barrier
+// orders the slot contents against the index that publishes them. A full
+// ring drops the new frame and counts it against the callback.
+
+static IngestFrame ring[INGEST_RING_SIZE];
+static volatile uint16_t ringHead = 0;
+static volatile uint16_t ringTail = 0;
+
+bool IRAM_ATTR ingestPush(SnifferCallback source, const wifi_promiscuous_pkt_t* p,
+                          wifi_promiscuous_pkt_type_t type, uint8_t flags, uint16_t snapLen) {
+  uint16_t head = ringHead;
+  if ((uint16_t)(head - ringTail) >= INGEST_RING_SIZE) {
+    statsRingDrop(source);
+    return false;
+  }
+
+  IngestFrame& f = ring[head & (INGEST_RING_SIZE - 1)];
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (len > snapLen) len = snapLen;
+  if (len > INGEST_SNAP_LEN) len = INGEST_SNAP_LEN;
+
+  f.timeUs = esp_timer_get_time();
+  f.sigLen = p->rx_ctrl.sig_len;
+  f.len = len;
+  f.rssi = p->rx_ctrl.rssi;
+  f.channel = p->rx_ctrl.channel;
+  f.type = type;
+  f.source = source;
+  f.flags = flags;
+  if (len) memcpy(f.payload, p->payload, len);
+
+  __sync_synchronize();
+  ringHead = head + 1;
+  return true;
+}
+
+// Frames queued only for the client/AP graph back off at this point, so a
+// busy data channel leaves room for the deauths and probes behind it.
+bool IRAM_ATTR ingestHalfFull() { return (uint16_t)(ringHead - ringTail) >= INGEST_RING_SIZE / 2; }
+
+// Takes at most one ring's worth per call so a busy channel cannot hold
+// the loop here.
+void drainIngest() {
+  uint16_t tail = ringTail;
+  uint16_t head = ringHead;
+  __sync_synchronize();
+
+  while (tail != head) {
+    const IngestFrame& f = ring[tail & (INGEST_RING_SIZE - 1)];
+    if (f.flags & INGEST_ASSOC) assocObserve(f);
+    if (f.source == CB_SNIFFER) snifferDeferred(f);
+    else if (f.source == CB_DEVICE_MONITOR) deviceMonitorDeferred(f);
+
+    tail++;
+    __sync_synchronize();
+    ringTail = tail;
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "config.h"
+#include "sniffer_stats.h"
+#include <esp_wifi.h>
+
+// Work the loop still owes a queued frame
+#define INGEST_PROBE 0x01   // match the probed SSID against the hidden list
+#define INGEST_LOG 0x02     // write a CSV log line
+#define INGEST_CLIENT 0x04  // add the station to Device Monitor
+#define INGEST_DEAUTH 0x08  // feed the deauth detector
+#define INGEST_SPOOFED 0x10 // deauth out of its BSSID's sequence stream
+#define INGEST_GENUINE 0x20 // deauth in its BSSID's sequence stream
+#define INGEST_ASSOC 0x40   // feed the client/AP graph
+
+bool IRAM_ATTR ingestPush(SnifferCallback source, const wifi_promiscuous_pkt_t* p,
+                          wifi_promiscuous_pkt_type_t type, uint8_t flags, uint16_t snapLen);
+bool IRAM_ATTR ingestHalfFull();
+void drainIngest();
+
+#endif // INGEST_H
@@ -0,0 +1,133 @@
+#include "karma_detector.h"
+#include "alerts.h"
+#include "hll.h"
+#include <esp_timer.h>
+
+// Karma / Mana detection from probe responses. A normal AP only answers
+// probes with its own SSID; a Karma AP answers for whatever SSID a client
+// asks for, and in Mana's loud mode for every SSID it has collected. The
+// callback hashes the SSID of each probe response into a small set kept
+// for the responding BSSID, so a responder costs a fixed 32 bytes however
+// many SSIDs it offers. A BSSID that answers for KARMA_SSID_LIMIT distinct
+// SSIDs within KARMA_WINDOW_MS is flagged.
+//
+// The window is wall time and does not restart when the radio hops, so a
+// Karma AP is caught from the few dwells a hopping screen gives its
+// channel. Responders sit in a set associative table; a new BSSID takes a
+// slot whose window ran out, else the one answering for the fewest SSIDs
+// if that is under KARMA_KEEP. In a crowd of ordinary APs a suspect then
+// keeps its slot between dwells, and the newcomer goes unrecorded. The loop reads the table as the
+// callback writes it; a slot changing hands mid-read costs one late alert.
+
+bool karmaActive = false;
+uint8_t karmaBssid[6];
+uint8_t karmaSsids = 0;
+uint8_t karmaChannel = 0;
+uint32_t karmaDetected = 0;
+
+static KarmaResponder responders[1 << KARMA_SET_BITS][KARMA_WAYS];
+static uint32_t lastKarmaSeen = 0;
+
+static uint32_t IRAM_ATTR setOf(const uint8_t* mac) {
+  return (sketchHash(mac, 6, 0x4B41524DUL) >> (32 - KARMA_SET_BITS));
+}
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static KarmaResponder* IRAM_ATTR findResponder(const uint8_t* bssid) {
+  KarmaResponder* set = responders[setOf(bssid)];
+  for (int w = 0; w < KARMA_WAYS; w++) {
+    if (sameMac(set[w].bssid, bssid)) return &set[w];
+  }
+  return nullptr;
+}
+
+static KarmaResponder* IRAM_ATTR claimResponder(const uint8_t* bssid, uint32_t now) {
+  KarmaResponder* set = responders[setOf(bssid)];
+  KarmaResponder* r = nullptr;
+  for (int w = 0; w < KARMA_WAYS; w++) {
+    KarmaResponder& e = set[w];
+    if (e.count == 0 || now - e.windowStart > KARMA_WINDOW_MS) {
+      r = &e;
+      break;
+    }
+    if (e.count < KARMA_KEEP && (!r || e.count < r->count)) r = &e;
+  }
+  if (!r) return nullptr;
+  r->count = 0;
+  r->reported = false;
+  r->windowStart = now;
+  for (int i = 0; i < 6; i++) r->bssid[i] = bssid[i];
+  return r;
+}
+
+// p is a probe response: SSID element right after the 12 fixed bytes
+void IRAM_ATTR karmaObserveResponse(const wifi_promiscuous_pkt_t* p) {
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (len < 38) return;
+  const uint8_t* ie = &p->payload[36];
+  if (ie[0] != 0 || ie[1] == 0 || ie[1] > MAX_SSID_LEN || 38 + ie[1] > len) return;
+
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  const uint8_t* bssid = &p->payload[16];
+  KarmaResponder* r = findResponder(bssid);
+  if (!r) r = claimResponder(bssid, now);
+  if (!r) return;
+  if (now - r->windowStart > KARMA_WINDOW_MS) {
+    r->count = 0;
+    r->windowStart = now;
+  }
+  r->rssi = p->rx_ctrl.rssi;
+  r->channel = p->rx_ctrl.channel;
+
+  uint16_t h = (uint16_t)sketchHash(&ie[2], ie[1], 0x7F4A7C15UL);
+  uint8_t n = r->count;
+  for (uint8_t i = 0; i < n; i++) {
+    if (r->ssidHash[i] == h) return;
+  }
+  if (n < KARMA_SSIDS) {
+    r->ssidHash[n] = h;
+    r->count = n + 1;
+  }
+}
+
+static void raiseKarma(KarmaResponder& r) {
+  karmaActive = true;
+  karmaDetected++;
+  memcpy(karmaBssid, r.bssid, 6);
+  karmaSsids = r.count;
+  karmaChannel = r.channel;
+  char msg[40];
+  snprintf(msg, 40, "Karma AP Ch%d %02X:%02X:%02X %u SSIDs", r.channel, r.bssid[3], r.bssid[4], r.bssid[5],
+           r.count);
+  logEvent(5, msg);
+  Serial.printf("[KARMA] Ch%d %02X:%02X:%02X:%02X:%02X:%02X answered for %u%s SSIDs, %d dBm\n", r.channel,
+                r.bssid[0], r.bssid[1], r.bssid[2], r.bssid[3], r.bssid[4], r.bssid[5], r.count,
+                r.count >= KARMA_SSIDS ? "+" : "", r.rssi);
+}
+
+void updateKarmaDetector() {
+  uint32_t now = millis();
+  for (int s = 0; s < (1 << KARMA_SET_BITS); s++) {
+    for (int w = 0; w < KARMA_WAYS; w++) {
+      KarmaResponder& r = responders[s][w];
+      if (r.count < KARMA_SSID_LIMIT || now - r.windowStart > KARMA_WINDOW_MS) continue;
+      lastKarmaSeen = now;
+      if (!r.reported) {
+        r.reported = true;
+        raiseKarma(r);
+      }
+    }
+  }
+  if (karmaActive && now - lastKarmaSeen > KARMA_HOLD_MS) karmaActive = false;
+}
+
+bool karmaFlagged(const uint8_t* bssid) {
+  const KarmaResponder* r = findResponder(bssid);
+  return r && r->reported;
+}
@@ -0,0 +1,17 @@
+#ifndef KARMA_DETECTOR_H
+#define KARMA_DETECTOR_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+extern bool karmaActive;
+extern uint8_t karmaBssid[6];
+extern uint8_t karmaSsids;
+extern uint8_t karmaChannel;
+extern uint32_t karmaDetected;
+
+void IRAM_ATTR karmaObserveResponse(const wifi_promiscuous_pkt_t* p);
+void updateKarmaDetector();
+bool karmaFlagged(const uint8_t* bssid);
+
+#endif // KARMA_DETECTOR_H
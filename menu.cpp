@@ -48,7 +48,8 @@ const char* systemMenuItems[] = {
   "Display",
   "Radio Control",
   "Power Mode",
+  "Diagnostics",
   "About"
 };
 uint8_t systemMenuIndex = 0;
-const uint8_t SYSTEM_MENU_SIZE = 5;
+const uint8_t SYSTEM_MENU_SIZE = 6;
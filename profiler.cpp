@@ -0,0 +1,116 @@
+#include "profiler.h"
+
+LoopProfile loopProfiles[SCREEN_COUNT];
+
+static uint8_t phase = PH_HANDLER;
+static uint32_t phaseStart = 0;
+static uint32_t loopStart = 0;
+static uint32_t phaseUs[PH_COUNT];
+static Screen loopScreen = SCREEN_COUNT;
+
+static const char* const screenNames[] = {
+  "Menu", "AutoWatch", "RFHealth", "Monitor", "Analyzer", "DevMonitor",
+  "APList", "APDetail", "APWalk", "BLEScan", "BLEDetail", "BLEWalk",
+  "SecMenu", "Deauth", "RogueAP", "BLETracker", "AlertSet",
+  "InsightMenu", "WhySlow", "ChanRec", "EnvChange", "Snapshot", "Scorecard",
+  "HistMenu", "EventLog", "Baseline", "Export",
+  "SysMenu", "Battery", "DisplaySet", "RadioCtl", "PowerMode", "About",
+  "DevDetail", "Compare", "Stats", "HiddenSSID", "Diagnostics"
+};
+static_assert(sizeof(screenNames) / sizeof(screenNames[0]) == SCREEN_COUNT,
+              "screenNames must cover every Screen");
+
+static const char* const phaseNames[PH_COUNT] = {
+  "buttons", "handler", "radio", "draw", "flush", "delay"
+};
+
+static uint8_t latencyBucket(uint32_t us) {
+  uint8_t b = 0;
+  us >>= LAT_HIST_SHIFT + 1;
+  while (us && b < LAT_HIST_BUCKETS - 1) {
+    us >>= 1;
+    b++;
+  }
+  return b;
+}
+
+uint8_t profilerPhase(uint8_t next) {
+  uint8_t prev = phase;
+  if (!PROFILER_ENABLED) return prev;
+
+  uint32_t now = micros();
+  phaseUs[phase] += now - phaseStart;
+  phaseStart = now;
+  phase = next;
+  return prev;
+}
+
+// Closes the previous iteration, charging it to the screen that was current
+// when it started, and opens the next one in the button phase.
+void profilerLoopBegin(Screen screen) {
+  if (!PROFILER_ENABLED) return;
+
+  profilerPhase(PH_BUTTONS);
+  uint32_t now = phaseStart;
+
+  if (loopScreen < SCREEN_COUNT) {
+    LoopProfile& p = loopProfiles[loopScreen];
+    uint32_t total = now - loopStart;
+    p.count++;
+    p.hist[latencyBucket(total)]++;
+    if (total > p.maxUs) p.maxUs = total;
+    for (int i = 0; i < PH_COUNT; i++) p.phaseUs[i] += phaseUs[i];
+  }
+
+  memset(phaseUs, 0, sizeof(phaseUs));
+  loopStart = now;
+  loopScreen = screen;
+}
+
+void loopDelay(uint32_t ms) {
+  profilerPhase(PH_DELAY);
+  delay(ms);
+}
+
+void resetProfiler() {
+  memset(loopProfiles, 0, sizeof(loopProfiles));
+  loopScreen = SCREEN_COUNT;
+}
+
+const char* screenName(Screen screen) {
+  if (screen >= SCREEN_COUNT) return "?";
+  return screenNames[screen];
+}
+
+// Upper bound, in microseconds, of the bucket holding the pct-th percentile
+// loop; capped at the observed maximum.
+uint32_t latencyPercentile(const LoopProfile& p, uint8_t pct) {
+  if (p.count == 0) return 0;
+
+  uint32_t target = (uint64_t)p.count * pct / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < LAT_HIST_BUCKETS; b++) {
+    seen += p.hist[b];
+    if (seen > target || b == LAT_HIST_BUCKETS - 1) {
+      return min(1UL << (b + 1 + LAT_HIST_SHIFT), (unsigned long)p.maxUs);
+    }
+  }
+  return p.maxUs;
+}
+
+void printProfilerCSV() {
+  Serial.print("screen,loops,p50_us,p99_us,max_us");
+  for (int i = 0; i < PH_COUNT; i++) Serial.printf(",%s_us", phaseNames[i]);
+  Serial.println();
+
+  for (int s = 0; s < SCREEN_COUNT; s++) {
+    const LoopProfile& p = loopProfiles[s];
+    if (p.count == 0) continue;
+    Serial.printf("%s,%lu,%lu,%lu,%lu", screenNames[s], p.count,
+                  latencyPercentile(p, 50), latencyPercentile(p, 99), p.maxUs);
+    for (int i = 0; i < PH_COUNT; i++) {
+      Serial.printf(",%lu", (uint32_t)(p.phaseUs[i] / p.count));
+    }
+    Serial.println();
+  }
+}
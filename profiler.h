@@ -0,0 +1,30 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "config.h"
+#include "screens.h"
+
+// Latency histogram bucket k holds loops that took
+// [2^(k+LAT_HIST_SHIFT), 2^(k+1+LAT_HIST_SHIFT)) microseconds.
+#define LAT_HIST_SHIFT 9
+
+extern LoopProfile loopProfiles[SCREEN_COUNT];
+
+void profilerLoopBegin(Screen screen);
+uint8_t profilerPhase(uint8_t phase);
+void loopDelay(uint32_t ms);
+void resetProfiler();
+
+// Charges the enclosed code to a phase and restores the previous one on
+// exit, so radio calls made from a handler or a draw are split out.
+struct PhaseScope {
+  uint8_t prev;
+  explicit PhaseScope(uint8_t phase) : prev(profilerPhase(phase)) {}
+  ~PhaseScope() { profilerPhase(prev); }
+};
+
+const char* screenName(Screen screen);
+uint32_t latencyPercentile(const LoopProfile& p, uint8_t pct);
+void printProfilerCSV();
+
+#endif // PROFILER_H
@@ -0,0 +1,33 @@
+#include "retries.h"
+
+// Retransmissions of a frame already heard. A transmitter repeats a frame
+// it got no ACK for with the Retry bit set and the same sequence control
+// field, so a retry matching the last sequence number heard from that
+// address is a copy. The table is direct mapped on the transmitter
+// address: a transmitter hashing to a taken slot replaces its owner, which
+// at worst lets one copy through as a new frame. Only the sniffer callback
+// touches it.
+
+volatile uint32_t retryDuplicates = 0;
+
+static SeqSlot slots[1 << RETRY_TABLE_BITS];
+
+// hdr is a management or data header of at least 24 bytes
+bool IRAM_ATTR retryDuplicate(const uint8_t* hdr) {
+  const uint8_t* ta = &hdr[10];
+  uint32_t k = (uint32_t)ta[2] << 24 | (uint32_t)ta[3] << 16 | ta[4] << 8 | ta[5];
+  k ^= (uint32_t)(ta[0] << 8 | ta[1]) * 0x9E3779B1u;
+  SeqSlot& s = slots[(uint32_t)(k * 2654435761u) >> (32 - RETRY_TABLE_BITS)];
+
+  uint16_t seq = hdr[22] | (hdr[23] << 8);
+  bool same = s.seqCtl == seq;
+  for (int i = 0; i < 6 && same; i++) same = s.ta[i] == ta[i];
+
+  if (same && (hdr[1] & 0x08)) {
+    retryDuplicates++;
+    return true;
+  }
+  for (int i = 0; i < 6; i++) s.ta[i] = ta[i];
+  s.seqCtl = seq;
+  return false;
+}
@@ -0,0 +1,11 @@
+#ifndef RETRIES_H
+#define RETRIES_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+extern volatile uint32_t retryDuplicates;
+
+bool IRAM_ATTR retryDuplicate(const uint8_t* hdr);
+
+#endif // RETRIES_H
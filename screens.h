@@ -38,7 +38,9 @@ enum Screen {
   SCREEN_DEVICE_DETAIL,
   SCREEN_COMPARE,
   SCREEN_STATS,
-  SCREEN_HIDDEN_SSID
+  SCREEN_HIDDEN_SSID,
+  SCREEN_DIAGNOSTICS,
+  SCREEN_COUNT
 };
 
 extern Screen currentScreen;
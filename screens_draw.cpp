@@ -6,6 +6,18 @@
 #include "utils.h"
 #include "security.h"
 #include "alerts.h"
+#include "sniffer_stats.h"
+#include "profiler.h"
+#include "device_monitor.h"
+#include "deauth_detector.h"
+#include "flood_detector.h"
+#include "karma_detector.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
+#include "cardinality.h"
+#include "talkers.h"
+#include "assoc_graph.h"
+#include "beacon_loss.h"
 
 extern uint32_t pps, peak, peakPPS;
 extern uint32_t history[HISTORY_SIZE];
@@ -37,23 +49,26 @@ extern uint8_t walkHistoryIndex;
 extern int8_t walkMinRSSI, walkMaxRSSI;
 extern int32_t walkRSSISum;
 extern uint16_t walkSampleCount;
+extern int8_t walkLoss;
 extern uint8_t walkTestView;
 extern uint8_t whySlowView;
+extern uint8_t diagView;
 extern RSSIHistory rssiHistory[MAX_TRACKED_APS];
 extern uint8_t alertLevel;
 extern uint32_t lastAlertBlink;
 extern bool alertBlinkState;
-extern bool prevAttackActive;
-extern uint8_t prevRogueCount;
 extern uint8_t deauthChannel;
 extern uint8_t displaySettingCursor;
 extern uint8_t rfHealthView;
+extern uint8_t monitorView;
+extern uint8_t talkerKey;
+extern uint8_t apDetailView;
 extern int8_t rfHealthRSSIHistory[60];
 extern uint8_t rfHealthHistoryIndex;
 extern int8_t rfHealthMinRSSI, rfHealthMaxRSSI;
 
 void drawGenericMenu(const char* title, const char** items, uint8_t itemCount, uint8_t& cursor) {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
 
@@ -73,7 +88,7 @@ void drawGenericMenu(const char* title, const char** items, uint8_t itemCount, u
     oled.setFont(u8g2_font_4x6_tf);
     if (startIdx > 0) oled.drawStr(122, 22, "^");
     if (startIdx + 4 < itemCount) oled.drawStr(122, 58, "v");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void takeSnapshot(Baseline* snap) {
@@ -117,16 +132,74 @@ void drawSystemMenu() {
   drawGenericMenu("SYSTEM", systemMenuItems, SYSTEM_MENU_SIZE, systemMenuIndex);
 }
 
+static const char* talkerVendor(const uint8_t* mac) {
+  if (mac[0] & 0x02) return "Random";  // locally administered
+  return getVendor((uint8_t*)mac);
+}
+
+static void drawTalkers() {
+  static TalkerTable t;
+  readTalkers((TalkerKey)talkerKey, &t);
+  const Talker* top[TALKER_ROWS];
+  uint8_t n = topTalkers(t, top, TALKER_ROWS);
+
+  oledFirstPage();
+  do {
+    oled.drawFrame(0, 0, 128, 10);
+    oled.setFont(u8g2_font_5x7_tf);
+    oled.setCursor(2, 8);
+    oled.printf("CH%02d TOP %s", currentChannel, talkerKey == TALK_BSSID ? "BSSIDs" : "TALKERS");
+
+    if (n == 0) {
+      oled.drawStr(20, 35, "No frames yet");
+    }
+    for (uint8_t i = 0; i < n; i++) {
+      const Talker* e = top[i];
+      uint8_t share = t.airtimeUs ? (uint64_t)e->airtimeUs * 100 / t.airtimeUs : 0;
+      char vendor[8];
+      strncpy(vendor, talkerVendor(e->mac), 7);
+      vendor[7] = '\0';
+      oled.setCursor(0, 19 + i * 9);
+      // ~ marks counts that may include the address this one replaced
+      oled.printf("%-7s %02X%02X%02X%3u%%%c%lu", vendor, e->mac[3], e->mac[4], e->mac[5], share,
+                  e->frameErr ? '~' : ' ', e->frames);
+    }
+
+    oled.setFont(u8g2_font_4x6_tf);
+    oled.drawStr(0, 63, "SHORT=TX/BSS LONG=Graph");
+  } while (oledNextPage());
+}
+
 void drawMonitor() {
-  oled.firstPage();
+  if (monitorView == 1) {
+    drawTalkers();
+    return;
+  }
+
+  int8_t retryPct = liveRetryPct();
+
+  // Name who is behind a busy channel
+  char culprit[16] = "";
+  if (liveLoad() > 60 || pktData > pktBeacon * 3) {
+    static TalkerTable t;
+    readTalkers(TALK_TRANSMITTER, &t);
+    const Talker* top;
+    if (topTalkers(t, &top, 1) && t.airtimeUs) {
+      snprintf(culprit, sizeof(culprit), " %.6s %u%%", talkerVendor(top->mac),
+               (unsigned)((uint64_t)top->airtimeUs * 100 / t.airtimeUs));
+    }
+  }
+
+  oledFirstPage();
   do {
     oled.drawFrame(0, 0, 128, 10);
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(2, 8);
     oled.printf("CH%02d %luP/s L:%d%%", currentChannel, pps, liveLoad());
+    if (retryPct >= 0) oled.printf(" R:%d%%", retryPct);
 
     oled.setCursor(0, 18);
-    oled.printf("B:%lu D:%lu X:%lu", pktBeacon, pktData, pktDeauth);
+    oled.printf("B:%lu D:%lu X:%lu/%lu", pktBeacon, pktData, pktDeauth, pktDisassoc);
 
     int rssiBar = constrain((int)avgRssi + 100, 0, 50);
     oled.drawFrame(0, 20, 52, 6);
@@ -175,6 +248,7 @@ void drawMonitor() {
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(0, 63);
     oled.print(channelInsight());
+    oled.print(culprit);
 
     if (frozen) {
       oled.drawBox(118, 28, 9, 9);
@@ -183,14 +257,15 @@ void drawMonitor() {
       oled.setDrawColor(1);
     }
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawAnalyzer() {
   uint8_t selLoad = channelLoad(selectedChannel);
+  int8_t selRetry = channelRetryPct(selectedChannel);
   uint8_t best = bestChannel();
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
       int x = (ch - 1) * 9 + 2;
@@ -229,12 +304,13 @@ void drawAnalyzer() {
     oled.drawFrame(0, 54, 128, 10);
     oled.setCursor(2, 62);
     oled.printf("CH%02d:%s BEST:%02d", selectedChannel, loadQuality(selLoad), best);
+    if (selRetry >= 0) oled.printf(" R%d%%", selRetry);
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawAutoWatch() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
 
@@ -244,7 +320,7 @@ void drawAutoWatch() {
       oled.drawStr(8, 16, "Auto WiFi+BLE Monitor");
 
       oled.setFont(u8g2_font_5x7_tf);
-      char buf[20];
+      char buf[32];
       sprintf(buf, "APs:%d BLE:%d", autoTotalAPs, autoTotalBLE);
       oled.drawStr(0, 28, buf);
 
@@ -254,6 +330,17 @@ void drawAutoWatch() {
       if (deauthPerSecond > 0) {
         sprintf(buf, "DEAUTH:%lu/s", deauthPerSecond);
         oled.drawStr(0, 48, buf);
+      } else if (beaconFloodActive) {
+        sprintf(buf, "FLOOD:Ch%d %u BSS", floodChannel, floodBssids);
+        oled.drawStr(0, 48, buf);
+      } else if (karmaActive) {
+        sprintf(buf, "KARMA:Ch%d %u SSID", karmaChannel, karmaSsids);
+        oled.drawStr(0, 48, buf);
+      } else if (csaAlertActive) {
+        oled.drawStr(0, 48, "FAKE CSA");
+      } else if (authStormActive) {
+        sprintf(buf, "AUTH FAIL:%lu", authStorms);
+        oled.drawStr(0, 48, buf);
       } else {
         oled.drawStr(0, 48, "No attacks");
       }
@@ -330,12 +417,14 @@ void drawAutoWatch() {
     oled.drawStr(0, 63, "VIEW");
     oled.drawStr(90, 63, "BACK");
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawRFHealth() {
   if (rfHealthView == 0) {
-    int totalDevices = apCount + bleDeviceCount;
+    uint16_t wifiSeen = wifiDevicesSeen(CARD_10MIN);
+    uint16_t bleSeen = bleDevicesSeen(CARD_10MIN);
+    int totalDevices = wifiSeen + bleSeen;
     int avgRSSI = 0;
     int channelLoad[13] = {0};
 
@@ -369,16 +458,16 @@ void drawRFHealth() {
 
     healthScore = constrain(healthScore, 0, 100);
 
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(25, 10, "RF HEALTH");
 
       oled.setFont(u8g2_font_5x7_tf);
 
-      // Device count
+      // Distinct transmitters over the last 10 minutes
       oled.setCursor(0, 22);
-      oled.printf("Devices: %d (%dAP+%dBLE)", totalDevices, apCount, bleDeviceCount);
+      oled.printf("Devices:~%d (%uW+%uB)", totalDevices, wifiSeen, bleSeen);
 
       // Average RSSI
       oled.setCursor(0, 32);
@@ -398,9 +487,9 @@ void drawRFHealth() {
       oled.setFont(u8g2_font_4x6_tf);
       oled.drawStr(0, 63, "LONG=Graph");
       oled.drawStr(85, 63, "BACK");
-    } while (oled.nextPage());
-  } else {
-    oled.firstPage();
+    } while (oledNextPage());
+  } else if (rfHealthView == 1) {
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(15, 10, "Avg RSSI Graph");
@@ -443,14 +532,44 @@ void drawRFHealth() {
       oled.setCursor(0, 54);
       oled.printf("Now:%d Min:%d Max:%d", currentAvg, rfHealthMinRSSI, rfHealthMaxRSSI);
 
+      oled.drawStr(0, 63, "LONG=Devices");
+      oled.drawStr(85, 63, "BACK");
+    } while (oledNextPage());
+  } else {
+    oledFirstPage();
+    do {
+      oled.setFont(u8g2_font_6x10_tf);
+      oled.drawStr(15, 10, "DEVICES SEEN");
+
+      oled.setFont(u8g2_font_5x7_tf);
+      oled.setCursor(0, 20);
+      oled.print("      1m   10m   1h");
+      oled.setCursor(0, 28);
+      oled.printf("WiFi%5u%5u%5u", wifiDevicesSeen(CARD_1MIN), wifiDevicesSeen(CARD_10MIN),
+                  wifiDevicesSeen(CARD_1HOUR));
+      oled.setCursor(0, 36);
+      oled.printf("BLE %5u%5u%5u", bleDevicesSeen(CARD_1MIN), bleDevicesSeen(CARD_10MIN),
+                  bleDevicesSeen(CARD_1HOUR));
+
+      // WiFi transmitters per channel over the last minute
+      uint16_t top = 1;
+      for (uint8_t ch = 1; ch <= 13; ch++) top = max(top, chDevices[ch]);
+      for (uint8_t ch = 1; ch <= 13; ch++) {
+        uint8_t x = 2 + (ch - 1) * 9;
+        uint8_t h = chDevices[ch] * 14 / top;
+        if (h) oled.drawBox(x, 54 - h, 7, h);
+      }
+      oled.drawLine(0, 55, 127, 55);
+
+      oled.setFont(u8g2_font_4x6_tf);
       oled.drawStr(0, 63, "LONG=Stats");
       oled.drawStr(85, 63, "BACK");
-    } while (oled.nextPage());
+    } while (oledNextPage());
   }
 }
 
 void drawDeviceMonitor() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(10, 10, "CLIENT MONITOR");
@@ -466,9 +585,9 @@ void drawDeviceMonitor() {
 
       // Show up to 3 devices (with MAC addresses, need more space per device)
       uint8_t shown = 0;
-      uint8_t activeIndex = 0;
-      for (int i = 0; i < MAX_MONITORED_DEVICES && shown < 3; i++) {
-        if (!monitoredDevices[i].active) continue;
+      uint16_t activeIndex = 0;
+      for (uint16_t i = 0; i < deviceCapacity && shown < 3; i++) {
+        if (!deviceActive(i)) continue;
 
         // Skip until we reach scroll position
         if (activeIndex < deviceScroll) {
@@ -495,19 +614,13 @@ void drawDeviceMonitor() {
         oled.print(name);
 
         oled.setCursor(104, y);
-        oled.printf("%d", monitoredDevices[i].rssi);
+        oled.printf("%d", deviceRssi[i]);
 
+        // BSSID for WiFi, address for BLE
+        char addr[18];
+        formatDeviceAddress(i, addr);
         oled.setCursor(8, y + 7);
-        if (monitoredDevices[i].type == 0) {
-          // WiFi: show BSSID
-          oled.printf("%02X:%02X:%02X:%02X:%02X:%02X",
-            monitoredDevices[i].bssid[0], monitoredDevices[i].bssid[1],
-            monitoredDevices[i].bssid[2], monitoredDevices[i].bssid[3],
-            monitoredDevices[i].bssid[4], monitoredDevices[i].bssid[5]);
-        } else {
-          // BLE: show address
-          oled.print(monitoredDevices[i].bleAddr);
-        }
+        oled.print(addr);
 
         if (shown == deviceCursor) oled.setDrawColor(1);
 
@@ -525,19 +638,24 @@ void drawDeviceMonitor() {
     oled.drawStr(0, 61, "SEL");
     oled.drawStr(30, 61, "DETAIL");
     oled.drawStr(85, 61, "BACK");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawDeviceDetail() {
-  if (deviceSelectedIndex >= MAX_MONITORED_DEVICES ||
-      !monitoredDevices[deviceSelectedIndex].active) {
+  if (!deviceActive(deviceSelectedIndex)) {
     drawPlaceholder("DEVICE DETAIL", "Invalid Device");
     return;
   }
 
   MonitoredDevice* dev = &monitoredDevices[deviceSelectedIndex];
 
-  oled.firstPage();
+  // The AP this client last sent to, from the association graph
+  uint8_t mac[6], bssid[6], roams;
+  uint64_t a = deviceKey[deviceSelectedIndex];
+  for (int i = 5; i >= 0; i--, a >>= 8) mac[i] = (uint8_t)a;
+  bool associated = dev->type == 0 && assocStationAp(mac, bssid, &roams);
+
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(10, 10, dev->type == 0 ? "WiFi CLIENT" : "BLE DEVICE");
@@ -552,21 +670,15 @@ void drawDeviceDetail() {
     name[19] = '\0';
     oled.print(name);
 
+    char addr[18];
+    formatDeviceAddress(deviceSelectedIndex, addr);
     oled.setCursor(0, 28);
-    if (dev->type == 0) {
-      oled.print("BSSID:");
-      oled.setCursor(30, 28);
-      oled.printf("%02X:%02X:%02X:%02X:%02X:%02X",
-        dev->bssid[0], dev->bssid[1], dev->bssid[2],
-        dev->bssid[3], dev->bssid[4], dev->bssid[5]);
-    } else {
-      oled.print("Addr:");
-      oled.setCursor(30, 28);
-      oled.print(dev->bleAddr);
-    }
+    oled.print(dev->type == 0 ? "BSSID:" : "Addr:");
+    oled.setCursor(30, 28);
+    oled.print(addr);
 
     oled.setCursor(0, 36);
-    oled.printf("RSSI: %ddBm", dev->rssi);
+    oled.printf("RSSI: %ddBm", deviceRssi[deviceSelectedIndex]);
 
     if (dev->type == 0) {
       oled.setCursor(64, 36);
@@ -579,15 +691,21 @@ void drawDeviceDetail() {
     oled.print(dev->isPresent ? "Present" : "Not Seen");
 
     oled.setCursor(0, 52);
-    oled.printf("Seen: %d times", dev->seenCount);
+    oled.printf("Seen: %d times", deviceSeenCount[deviceSelectedIndex]);
+
+    if (associated) {
+      oled.setCursor(0, 61);
+      oled.printf("AP:%02X%02X%02X%02X%02X%02X R%u", bssid[0], bssid[1], bssid[2], bssid[3],
+                  bssid[4], bssid[5], roams);
+    }
 
     oled.drawLine(0, 54, 127, 54);
     oled.drawStr(85, 61, "BACK");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawApList() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawFrame(0, 0, 128, 9);
@@ -653,12 +771,61 @@ void drawApList() {
     if (apScroll > 0) oled.drawStr(122, 18, "^");
     if (apScroll + AP_VISIBLE < apCount) oled.drawStr(122, 61, "v");
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
+}
+
+static void drawApClients(const wifi_ap_record_t* ap) {
+  AssocLink clients[ASSOC_ROWS];
+  uint8_t total = assocClientCount(ap->bssid);
+  uint8_t n = assocClients(ap->bssid, clients, ASSOC_ROWS);
+  uint32_t now = millis();
+
+  oledFirstPage();
+  do {
+    oled.drawFrame(0, 0, 128, 10);
+    oled.setFont(u8g2_font_5x7_tf);
+    oled.setCursor(2, 8);
+    char ssidBuf[14] = {0};
+    strncpy(ssidBuf, (char*)ap->ssid, 13);
+    oled.printf("CLIENTS %u %s", total, strlen((char*)ap->ssid) ? ssidBuf : "<hidden>");
+
+    if (n == 0) {
+      oled.drawStr(4, 30, "None seen yet");
+      oled.setFont(u8g2_font_4x6_tf);
+      oled.drawStr(4, 40, "Run Device Monitor to map");
+    }
+    for (uint8_t i = 0; i < n; i++) {
+      const AssocLink& c = clients[i];
+      char vendor[8];
+      strncpy(vendor, (c.sta[0] & 0x02) ? "Random" : getVendor((uint8_t*)c.sta), 7);
+      vendor[7] = '\0';
+      oled.setCursor(0, 19 + i * 8);
+      oled.printf("%-7s %02X%02X%02X ", vendor, c.sta[3], c.sta[4], c.sta[5]);
+      if (c.rssi) oled.printf("%4d", c.rssi);
+      else oled.print("   ?");
+      oled.printf(" %3lus", (now - c.lastSeen) / 1000);
+    }
+
+    oled.drawLine(0, 54, 127, 54);
+    oled.setFont(u8g2_font_4x6_tf);
+    oled.drawStr(0, 61, "SHORT=Info BACK=List");
+  } while (oledNextPage());
 }
 
 void drawApDetail() {
   wifi_ap_record_t* ap = &apList[apSelectedIndex];
-  oled.firstPage();
+  if (apDetailView == 1) {
+    drawApClients(ap);
+    return;
+  }
+  uint8_t clients = assocClientCount(ap->bssid);
+  int8_t loss = beaconLossPct(ap->bssid);
+  int8_t secondary = apSecondaryOffset(*ap);
+  uint8_t util = 0;
+  uint16_t stations = 0;
+  bool hasLoad = beaconBssLoad(ap->bssid, &util, &stations);
+
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(0, 7);
@@ -668,16 +835,21 @@ void drawApDetail() {
     oled.printf("SSID:%s", strlen((char*)ap->ssid) ? ssidBuf : "<hidden>");
 
     oled.setCursor(0, 16);
-    oled.printf("CH:%d RSSI:%d (%c)", ap->primary, ap->rssi, getQualityGrade(ap));
+    oled.printf("CH:%d%s RSSI:%d (%c)", ap->primary, secondary > 0 ? "+" : secondary < 0 ? "-" : "",
+      ap->rssi, getQualityGrade(ap));
 
     oled.setCursor(0, 25);
     oled.printf("SEC:%s", authStr(ap->authmode));
+    if (loss >= 0) oled.printf(" Loss:%d%%", loss);
+    else oled.print(" Loss:--");
 
     oled.setCursor(0, 34);
     oled.printf("Vendor:%s", getVendor(ap->bssid));
+    if (hasLoad) oled.printf(" Use:%u%%", util);
 
     oled.setCursor(0, 43);
-    oled.printf("Distance:%.1fm", estimateDistance(ap->rssi));
+    oled.printf("Dist:%.1fm Clients:%u", estimateDistance(ap->rssi), clients);
+    if (hasLoad) oled.printf("/%u", stations);
 
     oled.setFont(u8g2_font_4x6_tf);
     oled.setCursor(0, 51);
@@ -687,13 +859,13 @@ void drawApDetail() {
 
     oled.drawLine(0, 54, 127, 54);  // Separator line
     oled.setFont(u8g2_font_4x6_tf);
-    oled.drawStr(0, 61, "LONG=Walk BACK=List");
-  } while (oled.nextPage());
+    oled.drawStr(0, 61, "SHORT=Clients LONG=Walk");
+  } while (oledNextPage());
 }
 
 void drawAPWalkTest() {
   if (walkTestView == 0) {
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(15, 10, "AP WALK TEST");
@@ -710,6 +882,7 @@ void drawAPWalkTest() {
         oled.setCursor(0, 30);
         if (currentRSSI != 0) {
           oled.printf("Now: %ddBm", currentRSSI);
+          if (walkLoss >= 0) oled.printf(" Loss:%d%%", walkLoss);
         } else {
           oled.print("Scanning...");
         }
@@ -735,9 +908,9 @@ void drawAPWalkTest() {
         oled.setFont(u8g2_font_5x7_tf);
         oled.drawStr(10, 35, "No AP selected");
       }
-    } while (oled.nextPage());
+    } while (oledNextPage());
   } else {
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(20, 10, "RSSI Graph");
@@ -788,7 +961,7 @@ void drawAPWalkTest() {
       oled.setCursor(0, 60);
       oled.printf("Avg:%d Min:%d Max:%d", avgRSSI, walkMinRSSI, walkMaxRSSI);
       oled.drawStr(60, 64, "SHORT=Stats");
-    } while (oled.nextPage());
+    } while (oledNextPage());
   }
 }
 
@@ -796,7 +969,7 @@ void drawCompare() {
   wifi_ap_record_t* apA = &apList[apCompareA];
   wifi_ap_record_t* apB = &apList[apCompareB];
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawStr(30, 7, "AP COMPARE");
@@ -857,11 +1030,11 @@ void drawCompare() {
       oled.drawStr(48, 63, "TIE");
     }
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawBLEScan() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawFrame(0, 0, 128, 9);
@@ -933,13 +1106,13 @@ void drawBLEScan() {
       if (bleScroll + BLE_VISIBLE < bleDeviceCount) oled.drawStr(122, 61, "v");
     }
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawBLEDetail() {
   BLEDeviceInfo* dev = &bleDevices[bleSelectedIndex];
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(0, 7);
@@ -971,12 +1144,12 @@ void drawBLEDetail() {
     oled.drawLine(0, 54, 127, 54);  // Separator line
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(0, 61, "LONG=Walk BACK=List");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawBLEWalkTest() {
   if (walkTestView == 0) {
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(10, 10, "BLE WALK TEST");
@@ -1028,9 +1201,9 @@ void drawBLEWalkTest() {
         oled.setFont(u8g2_font_5x7_tf);
         oled.drawStr(5, 35, "No BLE device selected");
       }
-    } while (oled.nextPage());
+    } while (oledNextPage());
   } else {
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(20, 10, "RSSI Graph");
@@ -1082,30 +1255,44 @@ void drawBLEWalkTest() {
       oled.setCursor(0, 60);
       oled.printf("Avg:%d Min:%d Max:%d", avgRSSI, walkMinRSSI, walkMaxRSSI);
       oled.drawStr(60, 64, "SHORT=Stats");
-    } while (oled.nextPage());
+    } while (oledNextPage());
   }
 }
 
 void drawDeauthWatch() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(10, 10, "DEAUTH WATCH");
 
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(0, 22);
-    oled.printf("Channel: %d", currentChannel);
+    oled.printf("Ch:%d  Disassoc:%lu", currentChannel, totalDisassocDetected);
 
     oled.setCursor(0, 32);
     oled.printf("Rate: %lu/sec", deauthPerSecond);
+    if (csaHeard) oled.printf(" CSA:%lu", csaHeard);
 
     oled.setCursor(0, 42);
-    oled.printf("Total: %lu", totalDeauthDetected);
+    const DeauthSource* src = deauthTopSource();
+    if (src) {
+      oled.printf("Src %02X:%02X:%02X:%02X:%02X:%02X", src->mac[0], src->mac[1], src->mac[2],
+                  src->mac[3], src->mac[4], src->mac[5]);
+    } else {
+      oled.printf("Total: %lu", totalDeauthDetected);
+      if (deauthSpoofedTotal) oled.printf(" Forged:%lu", deauthSpoofedTotal);
+    }
 
     oled.setCursor(0, 52);
     if (attackActive) {
       oled.setFont(u8g2_font_6x10_tf);
-      oled.print("!! ATTACK !!");
+      oled.print(src && deauthSourceSpoofed(*src) ? "!! SPOOFED !!" : "!! ATTACK !!");
+    } else if (csaAlertActive) {
+      oled.setFont(u8g2_font_6x10_tf);
+      oled.print("!! FAKE CSA !!");
+    } else if (authStormActive) {
+      oled.setFont(u8g2_font_6x10_tf);
+      oled.print("!! AUTH FAIL !!");
     } else {
       oled.print("Status: Normal");
     }
@@ -1113,43 +1300,48 @@ void drawDeauthWatch() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawRogueAPWatch() {
-  oled.firstPage();
+  uint8_t active = activeRogueCount();
+
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
-    oled.drawStr(5, 10, "ROGUE AP WATCH");
+    oled.drawStr(5, 10, rogueTraining ? "ROGUE AP: TRAIN" : "ROGUE AP WATCH");
 
     oled.setFont(u8g2_font_5x7_tf);
     oled.setCursor(0, 22);
     oled.printf("Scanning: %d APs", apCount);
+    oled.setCursor(90, 22);
+    oled.printf("T:%u", trustedCount);
 
     oled.setCursor(0, 32);
-    if (rogueCount > 0) {
-      oled.printf("!! %d Rogue(s) !!", rogueCount);
+    if (rogueTraining) {
+      oled.print("Learning trusted APs");
+    } else if (active > 0) {
+      oled.printf("!! %d Rogue(s) !!", active);
     } else {
       oled.print("Status: Clean");
     }
 
-    if (rogueCount > 0) {
+    if (active > 0 && !rogueTraining) {
       oled.setFont(u8g2_font_4x6_tf);
-      oled.setCursor(0, 42);
-      oled.print("Evil Twin Detected:");
-      for (int i = 0; i < min((int)rogueCount, 2); i++) {
-        oled.setCursor(5, 50 + i * 8);
-        char ssid[17];
-        strncpy(ssid, rogueList[i].ssid, 16);
-        ssid[16] = '\0';
-        oled.printf("%s", ssid);
+      uint8_t row = 0;
+      for (int i = 0; i < rogueCount && row < 2; i++) {
+        if (!rogueList[i].active) continue;
+        oled.setCursor(0, 42 + row * 8);
+        oled.printf("%s %.16s", rogueReasonName(rogueList[i].reason), rogueList[i].ssid);
+        row++;
       }
     }
 
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
-    oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+    if (rogueTraining) oled.drawStr(0, 61, "SHORT=Forget LONG=Done");
+    else oled.drawStr(0, 61, "LONG=Train BACK=Menu");
+  } while (oledNextPage());
 }
 
 void drawBLETrackerWatch() {
@@ -1160,7 +1352,7 @@ void drawBLETrackerWatch() {
     }
   }
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "BLE TRACKER");
@@ -1197,11 +1389,11 @@ void drawBLETrackerWatch() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawAlertSettings() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "ALERT SETTINGS");
@@ -1216,6 +1408,11 @@ void drawAlertSettings() {
     oled.setCursor(0, 32);
     if (alertSettingIndex == 1) oled.print(">");
     oled.setCursor(10, 32);
+    oled.printf("Window: %dms", settings.deauthWindowMs);
+
+    oled.setCursor(0, 42);
+    if (alertSettingIndex == 2) oled.print(">");
+    oled.setCursor(10, 42);
     if (settings.screenTimeout == 0) {
       oled.print("Timeout: Never");
     } else {
@@ -1223,12 +1420,12 @@ void drawAlertSettings() {
     }
 
     oled.setFont(u8g2_font_4x6_tf);
-    oled.setCursor(0, 46);
+    oled.setCursor(0, 51);
     oled.print("SHORT=Next LONG=Adjust");
 
     oled.drawLine(0, 54, 127, 54);
     oled.drawStr(30, 61, "BACK=Save");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawWhyIsItSlow() {
@@ -1248,14 +1445,24 @@ void drawWhyIsItSlow() {
       if (apList[i].rssi < -75) weakSignalCount++;
     }
 
-    // Find max channel load
+    // Find max channel load, by AP count and by measured busy time, and
+    // the channel where the most frames need resending
+    uint8_t maxBusy = 0;
+    int8_t maxRetry = -1;
+    uint8_t retryCh = 0;
     for (int i = 0; i < 13; i++) {
       if (channelLoad[i] > maxLoad) maxLoad = channelLoad[i];
+      maxBusy = max(maxBusy, ::channelLoad(i + 1));
+      int8_t r = channelRetryPct(i + 1);
+      if (r > maxRetry) {
+        maxRetry = r;
+        retryCh = i + 1;
+      }
     }
 
     int avgRSSI = apCount > 0 ? avgRSSITotal / apCount : -100;
 
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(5, 10, "WHY IS IT SLOW?");
@@ -1263,17 +1470,29 @@ void drawWhyIsItSlow() {
       oled.setFont(u8g2_font_4x6_tf);
 
       // Issue 1: Channel congestion
-      oled.setCursor(0, 20);
-      if (maxLoad > 10) {
+      oled.setCursor(0, 18);
+      if (maxLoad > 10 || maxBusy > 70) {
         oled.print("! Congested channel");
-      } else if (maxLoad > 5) {
+      } else if (maxLoad > 5 || maxBusy > 40) {
         oled.print("  Moderate congestion");
       } else {
         oled.print("  Channel load OK");
       }
 
-      // Issue 2: Signal strength
-      oled.setCursor(0, 28);
+      // Issue 2: Retransmissions
+      oled.setCursor(0, 25);
+      if (maxRetry > 25) {
+        oled.printf("! Many retries CH%d %d%%", retryCh, maxRetry);
+      } else if (maxRetry > 10) {
+        oled.printf("  Some retries CH%d %d%%", retryCh, maxRetry);
+      } else if (maxRetry >= 0) {
+        oled.print("  Retry rate OK");
+      } else {
+        oled.print("  Retry rate unknown");
+      }
+
+      // Issue 3: Signal strength
+      oled.setCursor(0, 32);
       if (avgRSSI < -80) {
         oled.print("! Weak signals");
       } else if (avgRSSI < -70) {
@@ -1282,16 +1501,16 @@ void drawWhyIsItSlow() {
         oled.print("  Signal strength OK");
       }
 
-      // Issue 3: Interference
-      oled.setCursor(0, 36);
+      // Issue 4: Interference
+      oled.setCursor(0, 39);
       if (deauthPerSecond > 5) {
         oled.print("! High interference");
       } else {
         oled.print("  Interference OK");
       }
 
-      // Issue 4: Too many devices
-      oled.setCursor(0, 44);
+      // Issue 5: Too many devices
+      oled.setCursor(0, 46);
       if (apCount > 30) {
         oled.print("! Too many APs nearby");
       } else {
@@ -1301,17 +1520,17 @@ void drawWhyIsItSlow() {
       // Summary
       oled.setFont(u8g2_font_5x7_tf);
       oled.setCursor(0, 53);
-      int issues = (maxLoad > 10 ? 1 : 0) + (avgRSSI < -80 ? 1 : 0) +
+      int issues = (maxLoad > 10 ? 1 : 0) + (maxRetry > 25 ? 1 : 0) + (avgRSSI < -80 ? 1 : 0) +
                    (deauthPerSecond > 5 ? 1 : 0) + (apCount > 30 ? 1 : 0);
       oled.printf("%d issue(s) found", issues);
 
         oled.drawLine(0, 54, 127, 54);
       oled.setFont(u8g2_font_4x6_tf);
       oled.drawStr(10, 61, "LONG=Graph BACK=Menu");
-    } while (oled.nextPage());
+    } while (oledNextPage());
   } else {
     // RSSI Graph view
-    oled.firstPage();
+    oledFirstPage();
     do {
       oled.setFont(u8g2_font_6x10_tf);
       oled.drawStr(10, 10, "RSSI Over Time");
@@ -1380,7 +1599,7 @@ void drawWhyIsItSlow() {
         }
       }
       oled.drawStr(0, 62, apNames);
-    } while (oled.nextPage());
+    } while (oledNextPage());
   }
 }
 
@@ -1399,6 +1618,8 @@ void drawChannelRecommendation() {
   // Calculate scores (lower is better)
   for (int i = 0; i < 13; i++) {
     channelScore[i] = channelLoad[i] * 10; // Weight by AP count
+    channelScore[i] += countOverlappingAPs(i + 1) * 5; // Neighbours, 40 MHz reach included
+    channelScore[i] += channelUtilization(i + 1); // Plus measured or AP-reported busy %
   }
 
   // Find top 3 best channels
@@ -1420,7 +1641,7 @@ void drawChannelRecommendation() {
     }
   }
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "BEST CHANNELS");
@@ -1434,7 +1655,7 @@ void drawChannelRecommendation() {
       int aps = channelLoad[ch - 1];
 
       oled.setCursor(0, y);
-      oled.printf("%d. CH %d (%d APs)", i + 1, ch, aps);
+      oled.printf("%d. CH %d (%d APs) %d%%", i + 1, ch, aps, channelUtilization(ch));
     }
 
     // Reasoning
@@ -1442,11 +1663,11 @@ void drawChannelRecommendation() {
     oled.setCursor(0, 55);
     oled.printf("Total APs scanned: %d", apCount);
     oled.drawStr(85, 63, "BACK");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawEnvironmentChange() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "ENV CHANGE");
@@ -1501,26 +1722,26 @@ void drawEnvironmentChange() {
     } else {
       oled.drawStr(15, 61, "BACK=Menu");
     }
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawQuickSnapshot() {
   // Quick snapshot of current RF environment
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "QUICK SNAPSHOT");
 
     oled.setFont(u8g2_font_5x7_tf);
 
-    // WiFi Stats
+    // WiFi Stats, with distinct transmitters over 10 minutes
     oled.setCursor(0, 22);
-    oled.printf("WiFi APs: %d", apCount);
+    oled.printf("WiFi APs: %d (~%u dev)", apCount, wifiDevicesSeen(CARD_10MIN));
 
     // BLE Stats
     oled.setCursor(0, 31);
     uint8_t activeBLE = getActiveBLECount();
-    oled.printf("BLE Devices: %d", activeBLE);
+    oled.printf("BLE Devices: %d (~%u)", activeBLE, bleDevicesSeen(CARD_10MIN));
 
     // Average RSSI
     int avgRSSI = 0;
@@ -1553,12 +1774,12 @@ void drawQuickSnapshot() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawChannelScorecard() {
   // Visual quality/congestion score for all channels
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "CHANNEL SCORE");
@@ -1616,11 +1837,11 @@ void drawChannelScorecard() {
 
     oled.drawLine(0, 57, 127, 57);
     oled.drawStr(30, 63, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawEventLog() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(25, 10, "EVENT LOG");
@@ -1650,6 +1871,11 @@ void drawEventLog() {
         if (ev->type == 0) icon = "D";  // Deauth
         else if (ev->type == 1) icon = "R";  // Rogue
         else if (ev->type == 2) icon = "T";  // Tracker
+        else if (ev->type == 3) icon = "F";  // Beacon flood
+        else if (ev->type == 4) icon = "M";  // Client roamed
+        else if (ev->type == 5) icon = "K";  // Karma AP
+        else if (ev->type == 6) icon = "C";  // Channel switch
+        else if (ev->type == 7) icon = "A";  // Auth failures
 
         oled.setCursor(0, y);
         oled.printf("%s:", icon);
@@ -1674,11 +1900,11 @@ void drawEventLog() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawBaselineCompare() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "BASELINE VS NOW");
@@ -1732,11 +1958,11 @@ void drawBaselineCompare() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawBatteryPower() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(5, 10, "SYSTEM INFO");
@@ -1756,20 +1982,20 @@ void drawBatteryPower() {
 
     // Free heap
     oled.setCursor(0, 42);
-    oled.printf("Free RAM: %d KB", ESP.getFreeHeap() / 1024);
+    oled.printf("Free RAM: %lu KB", ESP.getFreeHeap() / 1024);
 
     // Flash size
     oled.setCursor(0, 52);
-    oled.printf("Flash: %d MB", ESP.getFlashChipSize() / (1024 * 1024));
+    oled.printf("Flash: %lu MB", ESP.getFlashChipSize() / (1024 * 1024));
 
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawDisplaySettings() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(15, 10, "DISPLAY");
@@ -1798,11 +2024,11 @@ void drawDisplaySettings() {
 
     oled.drawLine(0, 54, 127, 54);
     oled.drawStr(30, 61, "BACK=Save");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawRadioControl() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(10, 10, "RADIO CONTROL");
@@ -1829,11 +2055,84 @@ void drawRadioControl() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
+}
+
+void drawDiagnostics() {
+  if (diagView == 0) {
+    const SnifferStats& s = snifferStats[CB_SNIFFER];
+    const SnifferStats& d = snifferStats[CB_DEVICE_MONITOR];
+
+    oledFirstPage();
+    do {
+      oled.setFont(u8g2_font_6x10_tf);
+      oled.drawStr(25, 10, "DIAGNOSTICS");
+
+      oled.setFont(u8g2_font_5x7_tf);
+      if (!SNIFFER_STATS_ENABLED) {
+        oled.drawStr(0, 30, "Stats compiled out");
+      } else {
+        oled.setCursor(0, 20);
+        oled.printf("RX %lu/s  peak %lu/s", s.fps, s.peakFps);
+        oled.setCursor(0, 28);
+        oled.printf("p50<%luus p99<%luus", cyclesToMicros(cyclePercentile(s, 50)),
+                    cyclesToMicros(cyclePercentile(s, 99)));
+        oled.setCursor(0, 36);
+        oled.printf("Max %luus", cyclesToMicros(s.maxCycles));
+        oled.setCursor(0, 44);
+        oled.printf("Drop %lu Err %lu Dis %lu", s.ringDrops, s.rxErrors, s.discarded);
+        oled.setCursor(0, 52);
+        oled.printf("DevMon %lu/s max %luus", d.fps, cyclesToMicros(d.maxCycles));
+      }
+
+      oled.setFont(u8g2_font_4x6_tf);
+      oled.drawStr(0, 63, "SHORT=Serial LONG=Loop");
+      oled.drawStr(100, 63, "BACK");
+    } while (oledNextPage());
+  } else {
+    // Five slowest screens by p99 loop time
+    uint8_t top[5];
+    uint8_t topCount = 0;
+    bool used[SCREEN_COUNT] = {false};
+    for (int r = 0; r < 5; r++) {
+      int best = -1;
+      uint32_t bestP99 = 0;
+      for (int i = 0; i < SCREEN_COUNT; i++) {
+        if (used[i] || loopProfiles[i].count == 0) continue;
+        uint32_t p99 = latencyPercentile(loopProfiles[i], 99);
+        if (best < 0 || p99 > bestP99) {
+          best = i;
+          bestP99 = p99;
+        }
+      }
+      if (best < 0) break;
+      used[best] = true;
+      top[topCount++] = best;
+    }
+
+    oledFirstPage();
+    do {
+      oled.setFont(u8g2_font_6x10_tf);
+      oled.drawStr(20, 10, "LOOP PROFILE");
+
+      oled.setFont(u8g2_font_4x6_tf);
+      oled.drawStr(0, 18, "Screen        p50  p99  max ms");
+      for (int i = 0; i < topCount; i++) {
+        const LoopProfile& p = loopProfiles[top[i]];
+        oled.setCursor(0, 25 + i * 7);
+        oled.printf("%-12s %4lu %4lu %4lu", screenName((Screen)top[i]),
+                    latencyPercentile(p, 50) / 1000, latencyPercentile(p, 99) / 1000, p.maxUs / 1000);
+      }
+      if (topCount == 0) oled.drawStr(0, 32, "No loops recorded");
+
+      oled.drawStr(0, 63, "SHORT=CSV LONG=Sniffer");
+      oled.drawStr(100, 63, "BACK");
+    } while (oledNextPage());
+  }
 }
 
 void drawAbout() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(35, 10, "ABOUT");
@@ -1847,11 +2146,11 @@ void drawAbout() {
 
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(25, 63, "BACK = Return");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawHiddenSSID() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawFrame(0, 0, 128, 9);
@@ -1881,7 +2180,7 @@ void drawHiddenSSID() {
         oled.printf("%d", hiddenList[idx].rssi);
       }
     }
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawStats() {
@@ -1890,14 +2189,14 @@ void drawStats() {
   uint32_t mins = (runtime % 3600) / 60;
   uint32_t secs = runtime % 60;
 
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_5x7_tf);
     oled.drawStr(0, 8, "SESSION STATISTICS");
 
     oled.setFont(u8g2_font_6x10_tf);
     oled.setCursor(0, 20);
-    oled.printf("Time: %02d:%02d:%02d", hours, mins, secs);
+    oled.printf("Time: %02lu:%02lu:%02lu", hours, mins, secs);
 
     oled.setCursor(0, 30);
     oled.printf("Packets: %lu", totalPackets);
@@ -1916,11 +2215,11 @@ void drawStats() {
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(0, 63, "PRESS=Back HOLD=Reset");
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawRSSIMeter() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(25, 8, "RSSI METER");
@@ -1960,11 +2259,11 @@ void drawRSSIMeter() {
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(90, 63, "BACK");
 
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawExport() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(20, 10, "EXPORT DATA");
@@ -1984,11 +2283,11 @@ void drawExport() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(30, 61, "BACK=Menu");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawPowerMode() {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     oled.drawStr(20, 10, "POWER MODE");
@@ -2018,11 +2317,11 @@ void drawPowerMode() {
     oled.drawLine(0, 54, 127, 54);
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(0, 61, "SHORT=Change BACK=Save");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
 
 void drawPlaceholder(const char* title, const char* subtitle) {
-  oled.firstPage();
+  oledFirstPage();
   do {
     oled.setFont(u8g2_font_6x10_tf);
     uint8_t titleWidth = strlen(title) * 6;
@@ -2038,5 +2337,5 @@ void drawPlaceholder(const char* title, const char* subtitle) {
 
     oled.setFont(u8g2_font_4x6_tf);
     oled.drawStr(20, 58, "BACK = Return");
-  } while (oled.nextPage());
+  } while (oledNextPage());
 }
@@ -41,6 +41,7 @@ void drawBaselineCompare();
 void drawBatteryPower();
 void drawDisplaySettings();
 void drawRadioControl();
+void drawDiagnostics();
 void drawAbout();
 
 void drawHiddenSSID();
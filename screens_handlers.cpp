@@ -9,6 +9,16 @@
 #include "alerts.h"
 #include "settings.h"
 #include "device_monitor.h"
+#include "hop_planner.h"
+#include "sniffer_stats.h"
+#include "profiler.h"
+#include "cardinality.h"
+#include "talkers.h"
+#include "assoc_graph.h"
+#include "beacon_loss.h"
+#include "karma_detector.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
 
 extern Screen currentScreen;
 
@@ -46,6 +56,9 @@ extern uint8_t hiddenCursor, hiddenScroll;
 
 extern uint16_t autoTotalAPs, autoTotalBLE;
 extern uint8_t autoModeView;
+extern uint8_t monitorView;
+extern uint8_t talkerKey;
+extern uint8_t apDetailView;
 
 extern bool walkTestActive;
 extern char walkTargetSSID[33];
@@ -56,15 +69,16 @@ extern uint8_t walkHistoryIndex;
 extern int8_t walkMinRSSI, walkMaxRSSI;
 extern int32_t walkRSSISum;
 extern uint16_t walkSampleCount;
+extern int8_t walkLoss;
 extern uint8_t walkTestView;
 
 extern uint8_t whySlowView;
+extern uint8_t diagView;
 extern RSSIHistory rssiHistory[MAX_TRACKED_APS];
 extern uint32_t lastRSSISample;
 
 extern uint32_t deauthPerSecond, totalDeauthDetected;
-extern bool attackActive, prevAttackActive;
-extern uint8_t prevRogueCount;
+extern bool attackActive;
 extern uint8_t deauthChannel;
 extern uint8_t alertLevel;
 
@@ -90,6 +104,7 @@ void handleMainMenu(ButtonEvent ev) {
         currentChannel = 1;
         resetLiveStats();
         enterSnifferMode(currentChannel);
+        hopStart(HOP_AUTO_WATCH, currentChannel);
         startBLEScan();
         drawAutoWatch();
         break;
@@ -109,6 +124,7 @@ void handleMainMenu(ButtonEvent ev) {
         selectedChannel = 1;
         resetAnalyzer();
         enterSnifferMode(1);
+        hopStart(analyzerHopProfile(settings.scanSpeed), 1);
         break;
       case 4:
         currentScreen = SCREEN_DEVICE_MONITOR;
@@ -171,6 +187,7 @@ void handleSecurityMenu(ButtonEvent ev) {
         currentScreen = SCREEN_DEAUTH_WATCH;
         currentChannel = 1;
         enterSnifferMode(currentChannel);
+        hopStart(HOP_DEAUTH_WATCH, currentChannel);
         break;
       case 1:
         currentScreen = SCREEN_ROGUE_AP_WATCH;
@@ -272,6 +289,9 @@ void handleSystemMenu(ButtonEvent ev) {
         currentScreen = SCREEN_POWER_MODE;
         break;
       case 4:
+        currentScreen = SCREEN_DIAGNOSTICS;
+        break;
+      case 5:
         currentScreen = SCREEN_ABOUT;
         break;
     }
@@ -303,17 +323,16 @@ void handleAutoWatch(ButtonEvent ev) {
   if (millis() - lastAutoWifiScan > 5000) {
     enterScanMode();
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(true);
     autoTotalAPs = apCount;
     lastAutoWifiScan = millis();
-    enterSnifferMode(currentChannel);
+    enterSnifferMode(hopChannel());
+    hopResume();
     startBLEScan();
   }
-  else if (millis() - lastSecond > 1000) {
-    currentChannel = (currentChannel % 11) + 1;
-    enterSnifferMode(currentChannel);
-    lastSecond = millis();
+  else if (hopUpdate()) {
+    currentChannel = hopChannel();
   }
   else {
     updateBLEScan();
@@ -331,7 +350,7 @@ void handleRFHealth(ButtonEvent ev) {
   if (millis() - lastScan > 3000) {
     enterScanMode();
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(false);
     updateBLEScan();
     lastScan = millis();
@@ -349,14 +368,24 @@ void handleRFHealth(ButtonEvent ev) {
 }
 
 void handleMonitor(ButtonEvent ev) {
-  if (ev == BTN_SHORT && !frozen) {
+  if (ev == BTN_SHORT && monitorView == 1) {
+    talkerKey = (talkerKey + 1) % TALK_KEYS;
+  } else if (ev == BTN_SHORT && !frozen) {
     currentChannel = currentChannel % MAX_CHANNEL + 1;
     resetLiveStats();
     enterSnifferMode(currentChannel);
   }
 
+  // LONG cycles live graph -> frozen graph -> top talkers
   if (ev == BTN_LONG) {
-    frozen = !frozen;
+    if (monitorView == 1) {
+      monitorView = 0;
+    } else if (frozen) {
+      frozen = false;
+      monitorView = 1;
+    } else {
+      frozen = true;
+    }
   }
 
   if (ev == BTN_BACK) {
@@ -381,6 +410,7 @@ void handleMonitor(ButtonEvent ev) {
       avgRssi = 0.8 * avgRssi + 0.2 * r;
       rssiAccum = rssiCount = 0;
     }
+    sampleDwell();
     lastSecond = millis();
   }
 
@@ -388,18 +418,9 @@ void handleMonitor(ButtonEvent ev) {
 }
 
 void handleAnalyzer(ButtonEvent ev) {
-  uint32_t hopDelay = 30;
-  if (settings.scanSpeed == 0) hopDelay = 15;      // Fast
-  else if (settings.scanSpeed == 2) hopDelay = 50;  // Slow
-
-  if (millis() - analyzerLastHop > hopDelay) {
-    chPackets[analyzerChannel] += pktTotal;
-    chBeacons[analyzerChannel] += pktBeacon;
-    chDeauth[analyzerChannel] += pktDeauth;
-
-    pktTotal = pktBeacon = pktDeauth = 0;
-    analyzerChannel = analyzerChannel % MAX_CHANNEL + 1;
-    enterSnifferMode(analyzerChannel);
+  if (hopUpdate()) {
+    updateAnalyzerCounters();
+    analyzerChannel = hopChannel();
     analyzerLastHop = millis();
   }
 
@@ -428,13 +449,7 @@ void handleAnalyzer(ButtonEvent ev) {
 void handleDeviceMonitor(ButtonEvent ev) {
   // Handle buttons FIRST for better responsiveness
   if (ev == BTN_SHORT && monitoredDeviceCount > 0) {
-    // Count active devices
-    uint8_t activeCount = 0;
-    for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-      if (monitoredDevices[i].active) activeCount++;
-    }
-
-    if (deviceScroll + deviceCursor + 1 < activeCount) {
+    if (deviceScroll + deviceCursor + 1 < monitoredDeviceCount) {
       if (deviceCursor < 2) deviceCursor++;  // Show 3 devices at a time
       else deviceScroll++;
     } else {
@@ -445,9 +460,9 @@ void handleDeviceMonitor(ButtonEvent ev) {
 
   if (ev == BTN_LONG && monitoredDeviceCount > 0) {
     // Find the actual device index (skipping inactive slots)
-    uint8_t activeIndex = 0;
-    for (int i = 0; i < MAX_MONITORED_DEVICES; i++) {
-      if (monitoredDevices[i].active) {
+    uint16_t activeIndex = 0;
+    for (uint16_t i = 0; i < deviceCapacity; i++) {
+      if (deviceActive(i)) {
         if (activeIndex == deviceScroll + deviceCursor) {
           deviceSelectedIndex = i;
           currentScreen = SCREEN_DEVICE_DETAIL;
@@ -495,6 +510,7 @@ void handleApList(ButtonEvent ev) {
 
   if (ev == BTN_LONG && apCount > 0) {
     apSelectedIndex = apScroll + apCursor;
+    apDetailView = 0;
     currentScreen = SCREEN_AP_DETAIL;
   }
 
@@ -516,7 +532,7 @@ void handleApList(ButtonEvent ev) {
 
 void handleApDetail(ButtonEvent ev) {
   if (ev == BTN_SHORT) {
-    currentScreen = SCREEN_AP_LIST;
+    apDetailView = (apDetailView + 1) % 2;
   }
   if (ev == BTN_LONG) {
     if (apSelectedIndex < apCount) {
@@ -529,6 +545,7 @@ void handleApDetail(ButtonEvent ev) {
       walkMaxRSSI = -100;
       walkRSSISum = 0;
       walkSampleCount = 0;
+      walkLoss = -1;
       walkTestActive = true;
       memset(walkRSSIHistory, 0, sizeof(walkRSSIHistory));
       currentScreen = SCREEN_AP_WALK_TEST;
@@ -551,14 +568,17 @@ void handleAPWalkTest(ButtonEvent ev) {
   }
 
   if (millis() - lastScan > 1500) {
+    // Leaving the channel closes the listening dwell since the last scan
     enterScanMode();
+    walkLoss = beaconDwellLoss(walkTargetBSSID);
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(false);
 
     if (apCount > 0) {
       for (int i = 0; i < apCount; i++) {
         if (memcmp(apList[i].bssid, walkTargetBSSID, 6) == 0) {
+          enterSnifferMode(apList[i].primary);
           int8_t rssi = apList[i].rssi;
 
           walkRSSIHistory[walkHistoryIndex] = rssi;
@@ -604,12 +624,18 @@ void handleCompare(ButtonEvent ev) {
   drawCompare();
 }
 
+// The screen has no menu entry of its own, so its first call starts the
+// sniffer and the hop
+static bool hiddenHopping = false;
+
 void handleHiddenSSID(ButtonEvent ev) {
-  static uint32_t lastHop = 0;
-  if (millis() - lastHop > 200) {
-    currentChannel = (currentChannel % MAX_CHANNEL) + 1;
+  if (!hiddenHopping) {
+    hiddenHopping = true;
+    currentChannel = 1;
     enterSnifferMode(currentChannel);
-    lastHop = millis();
+    hopStart(HOP_HIDDEN_SSID, currentChannel);
+  } else if (hopUpdate()) {
+    currentChannel = hopChannel();
   }
 
   if (ev == BTN_SHORT && hiddenCount > 0) {
@@ -624,6 +650,7 @@ void handleHiddenSSID(ButtonEvent ev) {
 
   if (ev == BTN_BACK) {
     currentScreen = SCREEN_MENU;
+    hiddenHopping = false;
     stopAllWifi();
     drawMenu();
   }
@@ -759,31 +786,19 @@ void handleBLEWalkTest(ButtonEvent ev) {
 }
 
 void handleDeauthWatch(ButtonEvent ev) {
-  static uint32_t lastChannelHop = 0;
-  if (millis() - lastChannelHop > 500) {
-    currentChannel = (currentChannel % MAX_CHANNEL) + 1;
-    enterSnifferMode(currentChannel);
-    lastChannelHop = millis();
+  if (hopUpdate()) {
+    currentChannel = hopChannel();
   }
 
-  totalDeauthDetected = pktDeauth;
-
-  if (attackActive) {
+  if (attackActive || karmaActive || csaAlertActive) {
     alertLevel = 2;
-  } else if (deauthPerSecond > 0) {
+  } else if (deauthPerSecond > 0 || authStormActive) {
     alertLevel = 1;
   } else {
     alertLevel = 0;
   }
   updateAlertLED();
 
-  if (attackActive && !prevAttackActive) {
-    char msg[40];
-    snprintf(msg, 40, "Deauth attack! Ch%d %lu/sec", currentChannel, deauthPerSecond);
-    logEvent(0, msg);
-  }
-  prevAttackActive = attackActive;
-
   drawDeauthWatch();
   if (ev == BTN_BACK) {
     currentScreen = SCREEN_SECURITY_MENU;
@@ -795,27 +810,20 @@ void handleDeauthWatch(ButtonEvent ev) {
 }
 
 void handleRogueAPWatch(ButtonEvent ev) {
-  if (millis() - lastScan > 3000) {
-    fetchApResults(false);
-    uint8_t oldRogueCount = rogueCount;
-    detectRogueAPs();  // Check for APs with same SSID but different BSSID
-
-    // Log new rogue detections
-    if (rogueCount > prevRogueCount) {
-      for (int i = prevRogueCount; i < rogueCount; i++) {
-        char msg[40];
-        snprintf(msg, 40, "Rogue AP: %.15s", rogueList[i].ssid);
-        logEvent(1, msg);
-      }
-    }
-    prevRogueCount = rogueCount;
+  if (ev == BTN_LONG) {
+    setRogueTraining(!rogueTraining);
+  } else if (ev == BTN_SHORT && rogueTraining) {
+    clearTrustedAPs();
+  }
 
+  if (millis() - lastScan > 3000) {
+    fetchApResults(false);  // runs detectRogueAPs(), which logs new findings
     startApScan();
     lastScan = millis();
   }
 
   // Update alert level based on rogue AP detection
-  if (rogueCount > 0) {
+  if (activeRogueCount() > 0) {
     alertLevel = 2;  // Critical - red blink
   } else {
     alertLevel = 0;  // Normal - green
@@ -824,6 +832,7 @@ void handleRogueAPWatch(ButtonEvent ev) {
 
   drawRogueAPWatch();
   if (ev == BTN_BACK) {
+    setRogueTraining(false);
     currentScreen = SCREEN_SECURITY_MENU;
     stopAllWifi();
     drawSecurityMenu();
@@ -865,7 +874,7 @@ void handleBLETrackerWatch(ButtonEvent ev) {
 void handleAlertSettings(ButtonEvent ev) {
   if (ev == BTN_SHORT) {
     // Navigate between settings
-    alertSettingIndex = (alertSettingIndex + 1) % 2;
+    alertSettingIndex = (alertSettingIndex + 1) % 3;
   } else if (ev == BTN_LONG) {
     // Adjust selected setting
     switch (alertSettingIndex) {
@@ -873,7 +882,13 @@ void handleAlertSettings(ButtonEvent ev) {
         settings.deauthThreshold = (settings.deauthThreshold + 5) % 55;  // 0, 5, 10, ... 50
         if (settings.deauthThreshold == 0) settings.deauthThreshold = 5;
         break;
-      case 1:  // Screen timeout
+      case 1:  // Alert window
+        if (settings.deauthWindowMs < 250) settings.deauthWindowMs = 250;
+        else if (settings.deauthWindowMs < 500) settings.deauthWindowMs = 500;
+        else if (settings.deauthWindowMs < 1000) settings.deauthWindowMs = 1000;
+        else settings.deauthWindowMs = 100;
+        break;
+      case 2:  // Screen timeout
         if (settings.screenTimeout == 0) settings.screenTimeout = 30;
         else if (settings.screenTimeout == 30) settings.screenTimeout = 60;
         else if (settings.screenTimeout == 60) settings.screenTimeout = 120;
@@ -968,7 +983,7 @@ void handleWhyIsItSlow(ButtonEvent ev) {
   if (millis() - lastScan > 2000) {
     enterScanMode();
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(false);
     updateRSSIHistory();
     lastScan = millis();
@@ -982,7 +997,7 @@ void handleChannelRecommendation(ButtonEvent ev) {
   if (millis() - lastScan > 3000) {
     enterScanMode();
     startApScan();
-    delay(1500); // Wait for scan to complete
+    waitForScan(1500);
     fetchApResults(false);
     lastScan = millis();
   }
@@ -1000,7 +1015,7 @@ void handleEnvironmentChange(ButtonEvent ev) {
   if (millis() - lastEnvCheck > 2000) {
     enterScanMode();
     startApScan();
-    delay(1500); // Wait for scan to complete
+    waitForScan(1500);
     fetchApResults(false);
     takeSnapshot(&currentSnapshot);
     lastEnvCheck = millis();
@@ -1025,7 +1040,7 @@ void handleQuickSnapshot(ButtonEvent ev) {
   if (millis() - lastScan > 2000) {
     enterScanMode();
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(false);
     updateBLEScan();
     lastScan = millis();
@@ -1046,7 +1061,7 @@ void handleChannelScorecard(ButtonEvent ev) {
   if (millis() - lastScan > 2000) {
     enterScanMode();
     startApScan();
-    delay(1500);
+    waitForScan(1500);
     fetchApResults(false);
     lastScan = millis();
   }
@@ -1075,7 +1090,7 @@ void handleBaselineCompare(ButtonEvent ev) {
   if (millis() - lastBaselineUpdate > 2000) {
     enterScanMode();
     startApScan();
-    delay(1500); // Wait for scan to complete
+    waitForScan(1500);
     fetchApResults(false);
     takeSnapshot(&currentSnapshot);
     lastBaselineUpdate = millis();
@@ -1147,6 +1162,24 @@ void handleRadioControl(ButtonEvent ev) {
   }
 }
 
+void handleDiagnostics(ButtonEvent ev) {
+  if (ev == BTN_LONG) {
+    diagView = (diagView + 1) % 2;
+  }
+
+  if (ev == BTN_SHORT) {
+    if (diagView == 0) printSnifferStats();
+    else printProfilerCSV();
+  }
+
+  drawDiagnostics();
+
+  if (ev == BTN_BACK) {
+    currentScreen = SCREEN_SYSTEM_MENU;
+    drawSystemMenu();
+  }
+}
+
 void handleAbout(ButtonEvent ev) {
   drawAbout();
 
@@ -1203,6 +1236,30 @@ void handleExport(ButtonEvent ev) {
       );
     }
 
+    // Export distinct-device estimates
+    Serial.println("\nDevices Seen (estimated): window,wifi,ble");
+    for (uint8_t w = 0; w < CARD_WINDOWS; w++) {
+      Serial.printf("%s,%u,%u\n", cardWindowName((CardWindow)w), wifiDevicesSeen((CardWindow)w),
+                    bleDevicesSeen((CardWindow)w));
+    }
+    Serial.print("WiFi per channel (1m):");
+    for (uint8_t ch = 1; ch <= MAX_CHANNEL; ch++) Serial.printf(" %u", chDevices[ch]);
+    Serial.println();
+
+    // Export station <-> AP pairs, most recently seen first
+    static AssocLink links[ASSOC_MAX_EDGES];
+    uint8_t linkCount = assocLinks(links, ASSOC_MAX_EDGES);
+    uint32_t now = millis();
+    Serial.printf("\nAssociations: %u (%lu roams): station,bssid,frames,rssi,age_s\n", linkCount,
+                  assocRoamCount);
+    for (uint8_t i = 0; i < linkCount; i++) {
+      const uint8_t* s = links[i].sta;
+      const uint8_t* b = links[i].bssid;
+      Serial.printf("%02X:%02X:%02X:%02X:%02X:%02X,%02X:%02X:%02X:%02X:%02X:%02X,%u,%d,%lu\n",
+                    s[0], s[1], s[2], s[3], s[4], s[5], b[0], b[1], b[2], b[3], b[4], b[5],
+                    links[i].frames, links[i].rssi, (now - links[i].lastSeen) / 1000);
+    }
+
     // Export security events
     Serial.printf("\nSecurity Events: %d\n", eventCount);
     for (int i = 0; i < eventCount; i++) {
@@ -46,6 +46,7 @@ void handleBatteryPower(ButtonEvent ev);
 void handleDisplaySettings(ButtonEvent ev);
 void handleRadioControl(ButtonEvent ev);
 void handlePowerMode(ButtonEvent ev);
+void handleDiagnostics(ButtonEvent ev);
 void handleAbout(ButtonEvent ev);
 
 void handleStats(ButtonEvent ev);
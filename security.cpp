@@ -1,22 +1,278 @@
 #include "security.h"
 #include "wifi_scanner.h"
+#include "alerts.h"
+#include "seq_watch.h"
+#include "tsf_watch.h"
+
+// Evil twin detection. Each scan is grouped by SSID through a hash index,
+// so a scan costs one pass instead of comparing every pair of APs.
+//
+// An SSID with trusted BSSIDs (learned in train mode, kept in NVS) alerts
+// on any BSSID not on its list, and on a trusted BSSID advertising weaker
+// security than it was trained with or sitting on another channel. An untrained SSID only alerts when one
+// of its BSSIDs is open or WEP while another is encrypted, so a network
+// with many identical APs is left alone. The same BSSID on two channels in
+// one scan is always flagged, and so is a BSSID whose beacons the sniffer
+// heard coming from two sequence counters or two TSF clocks. Findings
+// stay in rogueList across scans and are logged once, when first seen.
 
 RogueAP rogueList[MAX_ROGUE_APS];
 uint8_t rogueCount = 0;
+bool rogueTraining = false;
+TrustedAP trustedAPs[MAX_TRUSTED_APS];
+uint16_t trustedCount = 0;
 
-void detectRogueAPs() {
-  rogueCount = 0;
-  for (int i = 0; i < apCount && rogueCount < MAX_ROGUE_APS; i++) {
-    for (int j = i + 1; j < apCount; j++) {
-      if (strcmp((char*)apList[i].ssid, (char*)apList[j].ssid) == 0 &&
-          memcmp(apList[i].bssid, apList[j].bssid, 6) != 0) {
-        strcpy(rogueList[rogueCount].ssid, (char*)apList[i].ssid);
-        memcpy(rogueList[rogueCount].bssid1, apList[i].bssid, 6);
-        memcpy(rogueList[rogueCount].bssid2, apList[j].bssid, 6);
-        rogueList[rogueCount].active = true;
-        rogueCount++;
+// Open-addressed scan indexes holding AP index + 1 (0 = empty), grown to
+// twice the largest scan seen. groupRank is the strongest security of the
+// SSID whose first AP sits in that slot.
+static uint16_t indexSlots = 0;
+static uint16_t* ssidIndex = nullptr;
+static uint16_t* bssidIndex = nullptr;
+static uint8_t* groupRank = nullptr;
+static uint32_t* apHash = nullptr;
+static uint16_t* apGroup = nullptr;
+
+static uint32_t ssidHash(const uint8_t* ssid) {
+  uint32_t h = 2166136261UL;  // FNV-1a
+  for (int i = 0; i < MAX_SSID_LEN && ssid[i]; i++) {
+    h = (h ^ ssid[i]) * 16777619UL;
+  }
+  return h;
+}
+
+static uint16_t bssidHome(const uint8_t* bssid, uint16_t mask) {
+  uint32_t h = 2166136261UL;
+  for (int i = 0; i < 6; i++) h = (h ^ bssid[i]) * 16777619UL;
+  return h & mask;
+}
+
+// Orders auth modes by protection; OWE counts with WEP as unauthenticated.
+static uint8_t authRank(uint8_t mode) {
+  switch (mode) {
+    case WIFI_AUTH_OPEN: return 0;
+    case WIFI_AUTH_WEP:
+    case WIFI_AUTH_OWE: return 1;
+    case WIFI_AUTH_WPA_PSK: return 2;
+    case WIFI_AUTH_WPA_WPA2_PSK: return 3;
+    case WIFI_AUTH_WPA2_WPA3_PSK:
+    case WIFI_AUTH_WPA2_ENTERPRISE: return 5;
+    case WIFI_AUTH_WPA3_PSK: return 6;
+    default: return 4;
+  }
+}
+
+static bool reserveIndex(uint16_t n) {
+  uint16_t want = 16;
+  while (want < n * 2) want <<= 1;
+  if (want <= indexSlots) return true;
+
+  free(ssidIndex);
+  size_t bytes = want * (2 * sizeof(uint16_t) + sizeof(uint8_t)) + (want / 2) * (sizeof(uint32_t) + sizeof(uint16_t));
+  uint8_t* block = (uint8_t*)calloc(1, bytes);
+  if (!block) {
+    ssidIndex = nullptr;
+    indexSlots = 0;
+    return false;
+  }
+  ssidIndex = (uint16_t*)block;
+  bssidIndex = ssidIndex + want;
+  apHash = (uint32_t*)(bssidIndex + want);
+  apGroup = (uint16_t*)(apHash + want / 2);
+  groupRank = (uint8_t*)(apGroup + want / 2);
+  indexSlots = want;
+  return true;
+}
+
+// First trusted entry for the SSID hash, or trustedCount
+static uint16_t trustedLowerBound(uint32_t hash) {
+  uint16_t lo = 0, hi = trustedCount;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (trustedAPs[mid].ssidHash < hash) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static TrustedAP* findTrusted(uint32_t hash, const uint8_t* bssid, uint16_t& pos) {
+  pos = trustedLowerBound(hash);
+  for (; pos < trustedCount && trustedAPs[pos].ssidHash == hash; pos++) {
+    int c = memcmp(trustedAPs[pos].bssid, bssid, 6);
+    if (c == 0) return &trustedAPs[pos];
+    if (c > 0) break;
+  }
+  return nullptr;
+}
+
+static void trustAP(const wifi_ap_record_t& ap, uint32_t hash) {
+  uint16_t pos;
+  TrustedAP* t = findTrusted(hash, ap.bssid, pos);
+  if (!t) {
+    if (trustedCount >= MAX_TRUSTED_APS) return;
+    memmove(&trustedAPs[pos + 1], &trustedAPs[pos], (trustedCount - pos) * sizeof(TrustedAP));
+    trustedCount++;
+    t = &trustedAPs[pos];
+    t->ssidHash = hash;
+    memcpy(t->bssid, ap.bssid, 6);
+    t->authmode = ap.authmode;
+  } else if (authRank(ap.authmode) > authRank(t->authmode)) {
+    t->authmode = ap.authmode;
+  }
+  t->channel = ap.primary;
+}
+
+static void flagRogue(const wifi_ap_record_t& ap, uint8_t reason, uint32_t now) {
+  RogueAP* r = nullptr;
+  RogueAP* oldest = nullptr;
+  for (int i = 0; i < rogueCount; i++) {
+    RogueAP& e = rogueList[i];
+    if (e.reason == reason && memcmp(e.bssid, ap.bssid, 6) == 0) {
+      r = &e;
+      break;
+    }
+    if (!e.active && (!oldest || e.lastSeen < oldest->lastSeen)) oldest = &e;
+  }
+
+  bool isNew = !r;
+  if (!r) {
+    if (rogueCount < MAX_ROGUE_APS) r = &rogueList[rogueCount++];
+    else if (oldest) r = oldest;
+    else return;
+    strncpy(r->ssid, (const char*)ap.ssid, MAX_SSID_LEN);
+    r->ssid[MAX_SSID_LEN] = '\0';
+    memcpy(r->bssid, ap.bssid, 6);
+    r->reason = reason;
+  }
+  r->channel = ap.primary;
+  r->authmode = ap.authmode;
+  r->lastSeen = now;
+  r->active = true;
+
+  if (isNew) {
+    char msg[40];
+    snprintf(msg, 40, "%s: %.20s", rogueReasonName(reason), r->ssid);
+    logEvent(1, msg);
+    Serial.printf("[ROGUE] %s %s %02X:%02X:%02X:%02X:%02X:%02X ch%u auth %u\n", rogueReasonName(reason), r->ssid,
+                  ap.bssid[0], ap.bssid[1], ap.bssid[2], ap.bssid[3], ap.bssid[4], ap.bssid[5], ap.primary, ap.authmode);
+  }
+}
+
+void checkRogueAPs(const wifi_ap_record_t* aps, uint16_t n) {
+  for (int i = 0; i < rogueCount; i++) rogueList[i].active = false;
+  if (n == 0 || !reserveIndex(n)) return;
+
+  uint16_t mask = indexSlots - 1;
+  uint32_t now = millis();
+  memset(ssidIndex, 0, indexSlots * sizeof(uint16_t));
+  memset(bssidIndex, 0, indexSlots * sizeof(uint16_t));
+
+  // Group by SSID, keeping each group's strongest security, and look for
+  // a BSSID reported twice on different channels.
+  for (uint16_t i = 0; i < n; i++) {
+    const wifi_ap_record_t& ap = aps[i];
+    uint32_t h = ssidHash(ap.ssid);
+    uint8_t rank = authRank(ap.authmode);
+    apHash[i] = h;
+    if (seqCloned(ap.bssid)) flagRogue(ap, ROGUE_CLONE, now);
+    if (tsfCloned(ap.bssid)) flagRogue(ap, ROGUE_CLOCK, now);
+
+    uint16_t s = h & mask;
+    for (;; s = (s + 1) & mask) {
+      if (!ssidIndex[s]) {
+        ssidIndex[s] = i + 1;
+        groupRank[s] = rank;
+        break;
+      }
+      uint16_t j = ssidIndex[s] - 1;
+      if (apHash[j] == h && strncmp((const char*)aps[j].ssid, (const char*)ap.ssid, MAX_SSID_LEN) == 0) {
+        if (rank > groupRank[s]) groupRank[s] = rank;
+        break;
+      }
+    }
+    apGroup[i] = s;
+
+    for (s = bssidHome(ap.bssid, mask);; s = (s + 1) & mask) {
+      if (!bssidIndex[s]) {
+        bssidIndex[s] = i + 1;
+        break;
+      }
+      const wifi_ap_record_t& other = aps[bssidIndex[s] - 1];
+      if (memcmp(other.bssid, ap.bssid, 6) == 0) {
+        if (other.primary != ap.primary) flagRogue(ap, ROGUE_CHANNEL, now);
         break;
       }
     }
   }
+
+  for (uint16_t i = 0; i < n; i++) {
+    const wifi_ap_record_t& ap = aps[i];
+    if (ap.ssid[0] == 0) continue;  // hidden networks share no name to group on
+    if (rogueTraining) {
+      trustAP(ap, apHash[i]);
+      continue;
+    }
+
+    uint16_t pos = trustedLowerBound(apHash[i]);
+    bool trainedSSID = pos < trustedCount && trustedAPs[pos].ssidHash == apHash[i];
+    const TrustedAP* t = trainedSSID ? findTrusted(apHash[i], ap.bssid, pos) : nullptr;
+    uint8_t rank = authRank(ap.authmode);
+
+    if (t) {
+      if (rank < authRank(t->authmode)) flagRogue(ap, ROGUE_DOWNGRADE, now);
+      if (t->channel && ap.primary != t->channel) flagRogue(ap, ROGUE_CHANNEL, now);
+    } else if (trainedSSID) {
+      flagRogue(ap, ROGUE_UNTRUSTED, now);
+    } else if (rank < 2 && groupRank[apGroup[i]] >= 2) {
+      flagRogue(ap, ROGUE_DOWNGRADE, now);
+    }
+  }
+}
+
+void detectRogueAPs() {
+  checkRogueAPs(apList, apCount);
+}
+
+uint8_t activeRogueCount() {
+  uint8_t n = 0;
+  for (int i = 0; i < rogueCount; i++) {
+    if (rogueList[i].active) n++;
+  }
+  return n;
+}
+
+const char* rogueReasonName(uint8_t reason) {
+  switch (reason) {
+    case ROGUE_UNTRUSTED: return "Untrusted";
+    case ROGUE_DOWNGRADE: return "Downgrade";
+    case ROGUE_CHANNEL: return "Ch clash";
+    case ROGUE_CLONE: return "Cloned";
+    case ROGUE_CLOCK: return "2 Clocks";
+    default: return "?";
+  }
+}
+
+void loadTrustedAPs() {
+  size_t len = prefs.getBytesLength("trustedAPs");
+  if (len % sizeof(TrustedAP) != 0 || len > sizeof(trustedAPs)) len = 0;
+  trustedCount = len ? prefs.getBytes("trustedAPs", trustedAPs, len) / sizeof(TrustedAP) : 0;
+}
+
+void saveTrustedAPs() {
+  if (trustedCount == 0) prefs.remove("trustedAPs");
+  else prefs.putBytes("trustedAPs", trustedAPs, trustedCount * sizeof(TrustedAP));
+}
+
+void clearTrustedAPs() {
+  trustedCount = 0;
+  rogueCount = 0;
+  saveTrustedAPs();
+}
+
+// Leaving train mode saves what was learned. Findings made before training
+// are dropped, since the trusted list they were judged against changed.
+void setRogueTraining(bool on) {
+  if (rogueTraining == on) return;
+  rogueTraining = on;
+  if (!on) saveTrustedAPs();
+  rogueCount = 0;
 }
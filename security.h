@@ -2,10 +2,22 @@
 #define SECURITY_H
 
 #include "config.h"
+#include <esp_wifi.h>
 
 extern RogueAP rogueList[MAX_ROGUE_APS];
 extern uint8_t rogueCount;
+extern bool rogueTraining;
+extern TrustedAP trustedAPs[MAX_TRUSTED_APS];
+extern uint16_t trustedCount;
 
 void detectRogueAPs();
+void checkRogueAPs(const wifi_ap_record_t* aps, uint16_t n);
+uint8_t activeRogueCount();
+const char* rogueReasonName(uint8_t reason);
+
+void loadTrustedAPs();
+void saveTrustedAPs();
+void clearTrustedAPs();
+void setRogueTraining(bool on);
 
 #endif // SECURITY_H
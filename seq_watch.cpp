@@ -0,0 +1,133 @@
+#include "seq_watch.h"
+#include <esp_timer.h>
+
+// Sequence number continuity per BSSID. An AP numbers the frames it sends
+// from one 12-bit counter, so from one of its beacons to the next the
+// number climbs by about as many frames as it sent in between. Someone
+// forging its address counts on their own, and their frames land outside
+// the window the elapsed time allows.
+//
+// Only beacons move a stream. Deauth and disassoc frames sent as the BSSID
+// are judged against it but never change it, so forged frames cannot
+// steer it. Each number is good for one frame, though: the frames judged
+// in-stream must keep climbing, so copying the number after a beacon
+// passes once. A stream unheard for so long that any number is possible
+// re-anchors on its next beacon; an established stream stays established.
+// Falling outside a stream only counts once the stream is established, so
+// an odd frame that happened to anchor it cannot make the AP look forged.
+//
+// Streams sit in a SEQ_WAYS-way set associative table, so a lookup reads
+// only a few slots. A new BSSID takes a slot that is free, gone stale or
+// not yet established, else the weakest current one if it is louder: in a
+// crowd the table keeps the streams it can judge, the nearest first,
+// rather than churning.
+
+static SeqStream streams[1 << SEQ_SET_BITS][SEQ_WAYS];
+
+static uint32_t IRAM_ATTR setOf(const uint8_t* mac) {
+  uint32_t k = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | mac[4] << 8 | mac[5];
+  k ^= (uint32_t)(mac[0] << 8 | mac[1]) * 0x9E3779B1u;
+  return (uint32_t)(k * 2654435761u) >> (32 - SEQ_SET_BITS);
+}
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static int16_t IRAM_ATTR seqDiff(uint16_t a, uint16_t b) {
+  return (int16_t)(((a - b) & 0x0FFF) << 4) >> 4;  // -2048..2047
+}
+
+// Keeps the last judged number no further back than a frame queued before
+// the beacon could be, so it stays comparable as the counter wraps
+static void IRAM_ATTR floorJudged(SeqStream* s) {
+  if (seqDiff(s->judgedSeq, s->seq) < -SEQ_BACKWARD) s->judgedSeq = (s->seq - SEQ_BACKWARD - 1) & 0x0FFF;
+}
+
+static SeqStream* IRAM_ATTR findStream(const uint8_t* bssid) {
+  SeqStream* set = streams[setOf(bssid)];
+  for (int w = 0; w < SEQ_WAYS; w++) {
+    if (sameMac(set[w].bssid, bssid)) return &set[w];
+  }
+  return nullptr;
+}
+
+static SeqStream* IRAM_ATTR claimStream(const uint8_t* bssid, int8_t rssi, uint32_t now) {
+  SeqStream* set = streams[setOf(bssid)];
+  SeqStream* weakest = nullptr;
+  for (int w = 0; w < SEQ_WAYS; w++) {
+    SeqStream& s = set[w];
+    if (s.run < SEQ_ESTABLISHED || now - s.lastMs >= SEQ_STALE_MS) return &s;
+    if (!weakest || s.rssi < weakest->rssi) weakest = &s;
+  }
+  return weakest->rssi < rssi ? weakest : nullptr;
+}
+
+// p is a beacon, deauth or disassoc of at least 24 bytes. Only frames sent
+// as their BSSID are judged.
+SeqVerdict IRAM_ATTR seqCheck(const wifi_promiscuous_pkt_t* p, bool beacon) {
+  const uint8_t* hdr = p->payload;
+  const uint8_t* bssid = &hdr[16];
+  if (!sameMac(&hdr[10], bssid)) return SEQ_UNKNOWN;
+  uint16_t seq = (hdr[22] | (hdr[23] << 8)) >> 4;
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+
+  SeqStream* s = findStream(bssid);
+  if (!s) {
+    if (!beacon) return SEQ_UNKNOWN;
+    s = claimStream(bssid, p->rx_ctrl.rssi, now);
+    if (!s) return SEQ_UNKNOWN;
+    for (int i = 0; i < 6; i++) s->bssid[i] = bssid[i];
+    s->seq = seq;
+    s->judgedSeq = (seq - SEQ_BACKWARD - 1) & 0x0FFF;
+    s->lastMs = now;
+    s->rssi = p->rx_ctrl.rssi;
+    s->run = 0;
+    s->strays = 0;
+    return SEQ_UNKNOWN;
+  }
+
+  uint32_t gap = SEQ_GAP_BASE + (now - s->lastMs) / SEQ_MS_PER_FRAME;
+  if (gap > SEQ_GAP_MAX) {
+    if (beacon) {
+      s->seq = seq;
+      s->judgedSeq = (seq - SEQ_BACKWARD - 1) & 0x0FFF;
+      s->lastMs = now;
+      s->rssi = p->rx_ctrl.rssi;
+    }
+    return SEQ_UNKNOWN;
+  }
+
+  int16_t d = seqDiff(seq, s->seq);
+  if (d > 0 && d <= (int16_t)gap) {
+    if (beacon) {
+      s->seq = seq;
+      s->lastMs = now;
+      s->rssi = p->rx_ctrl.rssi;
+      if (s->run < 0xFF) s->run++;
+      floorJudged(s);
+    }
+  } else if (d > 0 || d < -SEQ_BACKWARD) {
+    if (beacon) {
+      if (now - s->lastStrayMs > SEQ_CLONE_HOLD_MS) s->strays = 0;
+      if (s->strays < 0xFF) s->strays++;
+      s->lastStrayMs = now;
+    }
+    return s->run < SEQ_ESTABLISHED ? SEQ_UNKNOWN : SEQ_STRAY;
+  }
+  if (!beacon) {
+    if (seqDiff(seq, s->judgedSeq) <= 0) return s->run < SEQ_ESTABLISHED ? SEQ_UNKNOWN : SEQ_STRAY;
+    s->judgedSeq = seq;
+  }
+  return SEQ_IN_STREAM;
+}
+
+// Beacons from a second sequence counter keep turning up for this BSSID
+bool seqCloned(const uint8_t* bssid) {
+  const SeqStream* s = findStream(bssid);
+  return s && s->run >= SEQ_ESTABLISHED && s->strays >= SEQ_CLONE_MIN &&
+         millis() - s->lastStrayMs <= SEQ_CLONE_HOLD_MS;
+}
@@ -0,0 +1,12 @@
+#ifndef SEQ_WATCH_H
+#define SEQ_WATCH_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+enum SeqVerdict : uint8_t { SEQ_UNKNOWN, SEQ_IN_STREAM, SEQ_STRAY };
+
+SeqVerdict IRAM_ATTR seqCheck(const wifi_promiscuous_pkt_t* p, bool beacon);
+bool seqCloned(const uint8_t* bssid);
+
+#endif // SEQ_WATCH_H
@@ -13,6 +13,7 @@ void loadSettings() {
   settings.deauthThreshold = prefs.getUChar("deauthThresh", 10);
   settings.screenTimeout = prefs.getUShort("screenTimeout", 60);
   settings.powerMode = prefs.getUChar("powerMode", 0);
+  settings.deauthWindowMs = prefs.getUShort("deauthWin", 500);
 }
 
 void saveSettings() {
@@ -24,4 +25,5 @@ void saveSettings() {
   prefs.putUChar("deauthThresh", settings.deauthThreshold);
   prefs.putUShort("screenTimeout", settings.screenTimeout);
   prefs.putUChar("powerMode", settings.powerMode);
+  prefs.putUShort("deauthWin", settings.deauthWindowMs);
 }
@@ -0,0 +1,77 @@
+#include "sniffer_stats.h"
+#include "hop_planner.h"
+#include "device_monitor.h"
+
+SnifferStats snifferStats[CB_COUNT];
+
+static const char* callbackNames[CB_COUNT] = {"sniffer", "devmon"};
+static uint32_t lastStatsUpdate = 0;
+
+void updateSnifferStats() {
+  if (!SNIFFER_STATS_ENABLED) return;
+  if (millis() - lastStatsUpdate < 1000) return;
+  lastStatsUpdate = millis();
+
+  for (int i = 0; i < CB_COUNT; i++) {
+    SnifferStats& s = snifferStats[i];
+    uint32_t frames = s.frames;
+    s.fps = frames - s.lastFrames;
+    s.lastFrames = frames;
+    s.peakFps = max(s.peakFps, s.fps);
+  }
+}
+
+void resetSnifferStats() {
+  memset(snifferStats, 0, sizeof(snifferStats));
+  lastStatsUpdate = millis();
+}
+
+uint32_t cyclesToMicros(uint32_t cycles) {
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  return (cycles + mhz - 1) / mhz;
+}
+
+// Upper bound, in cycles, of the histogram bucket holding the pct-th
+// percentile callback.
+uint32_t cyclePercentile(const SnifferStats& s, uint8_t pct) {
+  uint32_t total = 0;
+  for (int b = 0; b < CYCLE_HIST_BUCKETS; b++) total += s.cycleHist[b];
+  if (total == 0) return 0;
+
+  uint32_t target = (uint64_t)total * pct / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < CYCLE_HIST_BUCKETS; b++) {
+    seen += s.cycleHist[b];
+    if (seen > target || b == CYCLE_HIST_BUCKETS - 1) {
+      return 1UL << (b + 1 + CYCLE_HIST_SHIFT);
+    }
+  }
+  return 0;
+}
+
+void printSnifferStats() {
+  if (!SNIFFER_STATS_ENABLED) {
+    Serial.println("[DIAG] Sniffer stats compiled out");
+    return;
+  }
+
+  for (int i = 0; i < CB_COUNT; i++) {
+    const SnifferStats& s = snifferStats[i];
+    Serial.printf("[DIAG] %s frames=%lu fps=%lu peak=%lu discard=%lu rxerr=%lu drop=%lu\n",
+                  callbackNames[i], s.frames, s.fps, s.peakFps, s.discarded, s.rxErrors, s.ringDrops);
+    Serial.printf("[DIAG] %s us p50<%lu p99<%lu max=%lu\n", callbackNames[i],
+                  cyclesToMicros(cyclePercentile(s, 50)), cyclesToMicros(cyclePercentile(s, 99)),
+                  cyclesToMicros(s.maxCycles));
+    Serial.printf("[DIAG] %s hist", callbackNames[i]);
+    for (int b = 0; b < CYCLE_HIST_BUCKETS; b++) Serial.printf(" %lu", s.cycleHist[b]);
+    Serial.println();
+  }
+
+  Serial.print("[DIAG] hop coverage%");
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) Serial.printf(" %d", hopCoveragePct(ch));
+  Serial.printf(" worstgap=%lums\n", hopWorstGapMs());
+
+  const DeviceTableStats& d = deviceTableStats;
+  Serial.printf("[DIAG] devices %u/%u inserts=%lu evictions=%lu lookups=%lu maxprobe=%u\n",
+                monitoredDeviceCount, deviceCapacity, d.inserts, d.evictions, d.lookups, d.maxProbe);
+}
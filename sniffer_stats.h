@@ -0,0 +1,67 @@
+#ifndef SNIFFER_STATS_H
+#define SNIFFER_STATS_H
+
+#include "config.h"
+
+// Cycle histogram bucket k holds callbacks that took
+// [2^(k+CYCLE_HIST_SHIFT), 2^(k+1+CYCLE_HIST_SHIFT)) cycles; the first and
+// last buckets also take everything below and above.
+#define CYCLE_HIST_SHIFT 6
+
+enum SnifferCallback : uint8_t { CB_SNIFFER, CB_DEVICE_MONITOR, CB_COUNT };
+
+extern SnifferStats snifferStats[CB_COUNT];
+
+static inline uint8_t IRAM_ATTR cycleBucket(uint32_t cycles) {
+  uint8_t b = 0;
+  cycles >>= CYCLE_HIST_SHIFT + 1;
+  while (cycles && b < CYCLE_HIST_BUCKETS - 1) {
+    cycles >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// Scoped timer for a promiscuous callback: counts the frame and records
+// entry-to-exit cycles. The disabled specialisation is empty, so with
+// SNIFFER_STATS_ENABLED false the probe compiles away.
+template <bool Enabled>
+struct CallbackProbe {
+  SnifferStats& stats;
+  uint32_t start;
+
+  explicit CallbackProbe(SnifferStats& s) : stats(s), start(ESP.getCycleCount()) {}
+  ~CallbackProbe() {
+    uint32_t cycles = ESP.getCycleCount() - start;
+    stats.frames++;
+    stats.cycleHist[cycleBucket(cycles)]++;
+    if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+  }
+};
+
+template <>
+struct CallbackProbe<false> {
+  explicit CallbackProbe(SnifferStats&) {}
+};
+
+typedef CallbackProbe<SNIFFER_STATS_ENABLED> SnifferProbe;
+
+static inline void IRAM_ATTR statsDiscard(SnifferCallback cb) {
+  if (SNIFFER_STATS_ENABLED) snifferStats[cb].discarded++;
+}
+
+static inline void IRAM_ATTR statsRxError(SnifferCallback cb) {
+  if (SNIFFER_STATS_ENABLED) snifferStats[cb].rxErrors++;
+}
+
+static inline void IRAM_ATTR statsRingDrop(SnifferCallback cb) {
+  if (SNIFFER_STATS_ENABLED) snifferStats[cb].ringDrops++;
+}
+
+void updateSnifferStats();
+void resetSnifferStats();
+uint32_t cyclesToMicros(uint32_t cycles);
+uint32_t cyclePercentile(const SnifferStats& s, uint8_t pct);
+void printSnifferStats();
+
+#endif // SNIFFER_STATS_H
@@ -0,0 +1,154 @@
+#include "talkers.h"
+
+// Who is using the channel: Space-Saving top-K of transmitter addresses
+// and of BSSIDs, with frames, bytes and airtime per address. Both tables
+// are fixed-size and only the promiscuous callback writes them. A frame
+// costs one index probe and a binary search over K entries: a counted
+// address swaps to the end of its equal-count run and is incremented, so
+// the entries stay sorted without moving anything else. A new address
+// takes entry[0], the minimum, and inherits its counts as error.
+//
+// The tables cover one dwell: they empty when the radio changes channel
+// or the loop asks for a reset. The loop copies them under a sequence
+// count, like the channel counters.
+
+static TalkerTable tables[TALK_KEYS];
+static uint8_t tableChannel = 0;
+static volatile uint32_t talkerSeq = 0;
+static volatile bool resetPending = true;
+
+static inline uint8_t IRAM_ATTR indexHome(const uint8_t* mac) {
+  uint32_t k = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+  return (uint32_t)(k * 2654435761u) >> 27;  // top 5 bits for 32 slots
+}
+
+static inline bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (uint8_t i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static inline uint8_t IRAM_ATTR findSlot(const TalkerTable& t, const uint8_t* mac) {
+  uint8_t i = indexHome(mac);
+  while (t.index[i] && !sameMac(t.entry[t.index[i] - 1].mac, mac)) {
+    i = (i + 1) & (TALKER_INDEX_SIZE - 1);
+  }
+  return i;
+}
+
+// Linear-probing delete: pull later entries of the cluster back into the
+// hole when their home allows it, so lookups never need tombstones.
+static void IRAM_ATTR unindex(TalkerTable& t, uint8_t slot) {
+  uint8_t hole = slot;
+  for (uint8_t i = (slot + 1) & (TALKER_INDEX_SIZE - 1); t.index[i]; i = (i + 1) & (TALKER_INDEX_SIZE - 1)) {
+    uint8_t home = indexHome(t.entry[t.index[i] - 1].mac);
+    if (((i - home) & (TALKER_INDEX_SIZE - 1)) >= ((i - hole) & (TALKER_INDEX_SIZE - 1))) {
+      t.index[hole] = t.index[i];
+      hole = i;
+    }
+  }
+  t.index[hole] = 0;
+}
+
+// Count one frame for the entry at pos. Moving it to the end of the run
+// of entries with its count keeps the array sorted after the increment.
+static void IRAM_ATTR bump(TalkerTable& t, uint8_t pos, uint8_t slot, uint16_t len, uint32_t airUs) {
+  uint32_t c = t.entry[pos].frames;
+  uint8_t lo = pos, hi = TALKER_K - 1;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi + 1) / 2;
+    if (t.entry[mid].frames == c) lo = mid;
+    else hi = mid - 1;
+  }
+  if (lo != pos) {
+    if (t.entry[lo].frames) t.index[findSlot(t, t.entry[lo].mac)] = pos + 1;
+    t.index[slot] = lo + 1;
+    Talker tmp = t.entry[pos];
+    t.entry[pos] = t.entry[lo];
+    t.entry[lo] = tmp;
+  }
+  Talker& e = t.entry[lo];
+  e.frames++;
+  e.bytes += len;
+  e.airtimeUs += airUs;
+  t.frames++;
+  t.airtimeUs += airUs;
+}
+
+static void IRAM_ATTR count(TalkerTable& t, const uint8_t* mac, uint16_t len, uint32_t airUs) {
+  uint8_t slot = findSlot(t, mac);
+  if (t.index[slot]) {
+    bump(t, t.index[slot] - 1, slot, len, airUs);
+    return;
+  }
+
+  Talker& min = t.entry[0];
+  if (min.frames) {
+    unindex(t, findSlot(t, min.mac));
+    slot = findSlot(t, mac);
+  }
+  min.frameErr = min.frames;
+  memcpy(min.mac, mac, 6);
+  t.index[slot] = 1;
+  bump(t, 0, slot, len, airUs);
+}
+
+void IRAM_ATTR talkersObserve(const wifi_promiscuous_pkt_t* p, wifi_promiscuous_pkt_type_t type, uint32_t airUs) {
+  uint16_t len = p->rx_ctrl.sig_len;
+  if (len < 20) return;
+  const uint8_t* f = p->payload;
+  uint8_t st = f[0] >> 4;
+
+  const uint8_t* ta = nullptr;
+  const uint8_t* bssid = nullptr;
+  if (type == WIFI_PKT_CTRL) {
+    if (st >= 0x08 && st <= 0x0B) ta = &f[10];  // BAR, BA, PS-Poll, RTS
+  } else if (len >= 28) {
+    ta = &f[10];
+    if (type == WIFI_PKT_MGMT) bssid = &f[16];
+    else if ((f[1] & 0x03) == 0) bssid = &f[16];
+    else if ((f[1] & 0x03) == 1) bssid = &f[4];   // to DS
+    else if ((f[1] & 0x03) == 2) bssid = &f[10];  // from DS
+  }
+  if (bssid && (bssid[0] & 0x01)) bssid = nullptr;  // wildcard in probe requests
+  if (!ta && !bssid) return;
+
+  talkerSeq++;
+  __sync_synchronize();
+  if (resetPending || p->rx_ctrl.channel != tableChannel) {
+    memset(tables, 0, sizeof(tables));
+    tableChannel = p->rx_ctrl.channel;
+    resetPending = false;
+  }
+  if (ta) count(tables[TALK_TRANSMITTER], ta, len, airUs);
+  if (bssid) count(tables[TALK_BSSID], bssid, len, airUs);
+  __sync_synchronize();
+  talkerSeq++;
+}
+
+void resetTalkers() {
+  resetPending = true;
+}
+
+uint8_t talkersChannel() {
+  return resetPending ? 0 : tableChannel;
+}
+
+void readTalkers(TalkerKey key, TalkerTable* out) {
+  uint32_t seq;
+  do {
+    seq = talkerSeq;
+    __sync_synchronize();
+    memcpy(out, &tables[key], sizeof(TalkerTable));
+    __sync_synchronize();
+  } while ((seq & 1) || seq != talkerSeq);
+  if (resetPending) memset(out, 0, sizeof(TalkerTable));
+}
+
+// The heaviest entries of a copied table, largest first.
+uint8_t topTalkers(const TalkerTable& t, const Talker** out, uint8_t max) {
+  uint8_t n = 0;
+  for (int i = TALKER_K - 1; i >= 0 && n < max && t.entry[i].frames; i--) out[n++] = &t.entry[i];
+  return n;
+}
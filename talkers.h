@@ -0,0 +1,15 @@
+#ifndef TALKERS_H
+#define TALKERS_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+enum TalkerKey : uint8_t { TALK_TRANSMITTER, TALK_BSSID, TALK_KEYS };
+
+void IRAM_ATTR talkersObserve(const wifi_promiscuous_pkt_t* p, wifi_promiscuous_pkt_type_t type, uint32_t airUs);
+void resetTalkers();
+uint8_t talkersChannel();
+void readTalkers(TalkerKey key, TalkerTable* out);
+uint8_t topTalkers(const TalkerTable& t, const Talker** out, uint8_t max);
+
+#endif // TALKERS_H
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Flag code reachable from the promiscuous callbacks that is not in IRAM.
+
+Walks the call graph of the firmware ELF from the IRAM_ATTR callbacks and
+reports every reachable function, and every data symbol they reference,
+that lives in flash. ROM functions (absolute symbols) and DRAM are fine.
+Exits 1 when something is flagged so it can gate a build:
+
+    arduino-cli compile --fqbn esp32:esp32:esp32c3 --export-binaries .
+    tools/iram_audit.py build/esp32.esp32.esp32c3/esp32Util.ino.elf
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+ROOTS = ["sniffer", "deviceMonitorSniffer"]
+FLASH_SECTIONS = (".flash.text", ".flash.rodata", ".flash.appdesc")
+
+# objdump -t: "42000abc g     F .flash.text\t0000002c sniffer(void*, ...)"
+SYM_RE = re.compile(r"^([0-9a-f]+)\s.{7}\s(\S+)\s+[0-9a-f]+\s+(.+)$")
+FUNC_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+# A call or jump with a resolved target, e.g. "jal ra,42001234 <memcpy>"
+CALL_RE = re.compile(r"\t(?:jal|jalr|j|call|tail|callx?\d*|bl?)\s.*<([^>+]+)(?:\+0x[0-9a-f]+)?>")
+# An address the disassembler resolved to a symbol in an operand or comment
+REF_RE = re.compile(r"<([^>+]+)(?:\+0x[0-9a-f]+)?>")
+
+
+def base_name(sym):
+    return sym.split("(", 1)[0]
+
+
+def run(tool, args):
+    return subprocess.run([tool] + args, check=True, capture_output=True, text=True).stdout
+
+
+def load_sections(objdump, elf):
+    sections = {}
+    for line in run(objdump, ["-t", "-C", elf]).splitlines():
+        m = SYM_RE.match(line)
+        if m:
+            sections.setdefault(m.group(3).strip(), m.group(2))
+    return sections
+
+
+def load_graph(objdump, elf):
+    calls, refs = {}, {}
+    current = None
+    for line in run(objdump, ["-d", "-C", "--no-show-raw-insn", elf]).splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            current = m.group(2)
+            calls.setdefault(current, set())
+            refs.setdefault(current, set())
+            continue
+        if current is None or "\t" not in line:
+            continue
+        c = CALL_RE.search(line)
+        if c:
+            if c.group(1) != current:
+                calls[current].add(c.group(1))
+            continue
+        for r in REF_RE.findall(line):
+            if r != current:
+                refs[current].add(r)
+    return calls, refs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf")
+    ap.add_argument("--objdump", default="riscv32-esp-elf-objdump",
+                    help="target objdump (xtensa-esp32-elf-objdump on Xtensa parts)")
+    ap.add_argument("--root", action="append", help="callback to start from (default: %s)" % ", ".join(ROOTS))
+    args = ap.parse_args()
+
+    sections = load_sections(args.objdump, args.elf)
+    calls, refs = load_graph(args.objdump, args.elf)
+
+    roots = [f for f in calls if base_name(f) in (args.root or ROOTS)]
+    if not roots:
+        print("iram_audit: no callback symbols found in %s" % args.elf, file=sys.stderr)
+        return 2
+
+    parent = {f: None for f in roots}
+    queue = list(roots)
+    problems = []
+    while queue:
+        fn = queue.pop(0)
+        section = sections.get(fn, "?")
+        if section.startswith(FLASH_SECTIONS):
+            problems.append((fn, section))
+            continue  # report the entry point into flash, not everything below it
+        for ref in sorted(refs.get(fn, ())):
+            if sections.get(ref, "").startswith(FLASH_SECTIONS) and ref not in parent:
+                parent[ref] = fn
+                problems.append((ref, sections[ref]))
+        for callee in sorted(calls.get(fn, ())):
+            if callee not in parent:
+                parent[callee] = fn
+                queue.append(callee)
+
+    for sym, section in problems:
+        chain = []
+        p = parent.get(sym)
+        while p is not None:
+            chain.append(base_name(p))
+            p = parent.get(p)
+        print("%s: %s  (via %s)" % (section, sym, " <- ".join(chain)))
+
+    reached = len(parent)
+    if problems:
+        print("iram_audit: %d flash symbols reachable from %d callbacks (%d symbols walked)"
+              % (len(problems), len(roots), reached))
+        return 1
+    print("iram_audit: ok, %d symbols reachable from %d callbacks, all IRAM/DRAM/ROM" % (reached, len(roots)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
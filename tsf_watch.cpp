@@ -0,0 +1,201 @@
+#include "tsf_watch.h"
+#include <esp_timer.h>
+
+// Beacon clock per BSSID. Every beacon carries the AP's 64-bit TSF, a
+// microsecond counter the AP keeps from power-up, so from one beacon to
+// the next it advances by the time in between as our rx timestamps
+// measure it, off by the two crystals' rate difference. That drift is
+// measured over a baseline of at least a second, in fixed point, and
+// predicted beacons must land within a tolerance of it.
+//
+// An evil twin that clones the BSSID still runs its own TSF. Its beacons
+// miss the prediction and start a second clock under the same BSSID, and
+// as the two transmitters take turns the beacons keep alternating between
+// the two clocks. An AP that restarts also jumps to a new clock, but only
+// once: a second clock heard TSF_ADOPT_BEACONS times in a row replaces
+// the first. A twin that copies the TSF closely enough to fit the
+// tolerance drags the clock back and forth instead, which shows in the
+// mean deviation.
+//
+// The drift and deviation arithmetic is 32-bit apart from the TSF values
+// themselves, so it never divides 64-bit numbers; only switchClock() does,
+// to read the millisecond clock, as the other watches do. The table is laid
+// out like the sequence streams: set associative, a new BSSID taking a
+// slot that is not established or gone stale, else the weakest one if it
+// is louder.
+
+static TsfClock clocks[1 << TSF_SET_BITS][TSF_WAYS];
+
+static uint32_t IRAM_ATTR setOf(const uint8_t* mac) {
+  uint32_t k = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | mac[4] << 8 | mac[5];
+  k ^= (uint32_t)(mac[0] << 8 | mac[1]) * 0x9E3779B1u;
+  return (uint32_t)(k * 2654435761u) >> (32 - TSF_SET_BITS);
+}
+
+static bool IRAM_ATTR sameMac(const uint8_t* a, const uint8_t* b) {
+  for (int i = 0; i < 6; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+static TsfClock* IRAM_ATTR findClock(const uint8_t* bssid) {
+  TsfClock* set = clocks[setOf(bssid)];
+  for (int w = 0; w < TSF_WAYS; w++) {
+    if (sameMac(set[w].bssid, bssid)) return &set[w];
+  }
+  return nullptr;
+}
+
+static TsfClock* IRAM_ATTR claimClock(const uint8_t* bssid, int8_t rssi, uint32_t rxUs) {
+  TsfClock* set = clocks[setOf(bssid)];
+  TsfClock* weakest = nullptr;
+  for (int w = 0; w < TSF_WAYS; w++) {
+    TsfClock& c = set[w];
+    if (c.run < TSF_ESTABLISHED || rxUs - c.rxUs >= TSF_REBASE_MS * 1000UL) return &c;
+    if (!weakest || c.rssi < weakest->rssi) weakest = &c;
+  }
+  return weakest->rssi < rssi ? weakest : nullptr;
+}
+
+static void IRAM_ATTR anchor(TsfClock* c, uint64_t tsf, uint32_t rxUs) {
+  c->tsf = tsf;
+  c->rxUs = rxUs;
+  c->refTsf = tsf;
+  c->refRxUs = rxUs;
+}
+
+// Deviation of a beacon from a clock last heard at (tsf, rxUs) that runs
+// drift / 16 ppm fast, or INT32_MAX when it is further off than slackPpm
+// over the elapsed time allows.
+static int32_t IRAM_ATTR deviation(uint64_t tsf, uint32_t rxUs, uint64_t lastTsf, uint32_t lastRxUs,
+                                   int32_t drift, int32_t slackPpm) {
+  uint32_t elapsed = rxUs - lastRxUs;
+  int32_t elapsedMs = (int32_t)(elapsed / 1000);
+  uint64_t predicted = lastTsf + elapsed + elapsedMs * drift / 16000;
+  int64_t d = (int64_t)(tsf - predicted);
+  int32_t tol = TSF_TOLERANCE_US + elapsedMs * slackPpm / 1000;
+  if (d > tol || d < -tol) return INT32_MAX;
+  return (int32_t)d;
+}
+
+static void IRAM_ATTR switchClock(TsfClock* c) {
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  if (now - c->lastSwitchMs > TSF_CLONE_HOLD_MS) c->switches = 0;
+  if (c->switches < 0xFF) c->switches++;
+  c->lastSwitchMs = now;
+}
+
+// p is a beacon; frames sent by anyone but their BSSID are ignored.
+void IRAM_ATTR tsfObserve(const wifi_promiscuous_pkt_t* p) {
+  if (p->rx_ctrl.sig_len < 24 + 12 + 4) return;
+  const uint8_t* f = p->payload;
+  const uint8_t* bssid = &f[16];
+  if (!sameMac(&f[10], bssid)) return;
+
+  uint64_t tsf = 0;
+  for (int i = 7; i >= 0; i--) tsf = (tsf << 8) | f[24 + i];
+  uint16_t intervalTu = f[32] | (f[33] << 8);
+  uint32_t rxUs = p->rx_ctrl.timestamp;
+  int8_t rssi = p->rx_ctrl.rssi;
+
+  TsfClock* c = findClock(bssid);
+  if (!c) {
+    c = claimClock(bssid, rssi, rxUs);
+    if (!c) return;
+    for (int i = 0; i < 6; i++) c->bssid[i] = bssid[i];
+    c->intervalTu = intervalTu;
+    anchor(c, tsf, rxUs);
+    c->drift = 0;
+    c->jitter = 0;
+    c->rssi = rssi;
+    c->run = 1;
+    c->altRun = 0;
+    c->altAlone = 0;
+    c->onAlt = false;
+    c->switches = 0;
+    return;
+  }
+
+  if (rxUs - c->rxUs >= TSF_REBASE_MS * 1000UL) {
+    anchor(c, tsf, rxUs);
+    c->intervalTu = intervalTu;
+    c->altRun = 0;
+    c->altAlone = 0;
+    c->onAlt = false;
+    return;
+  }
+
+  int32_t slack = c->run >= TSF_ESTABLISHED ? TSF_SLACK_PPM : TSF_DRIFT_MAX_PPM;
+  int32_t d = intervalTu == c->intervalTu ? deviation(tsf, rxUs, c->tsf, c->rxUs, c->drift, slack) : INT32_MAX;
+  if (d != INT32_MAX) {
+    int32_t a = min((d < 0 ? -d : d) << 4, (int32_t)0xFFFF);
+    c->jitter += (a - (int32_t)c->jitter) / 8;
+    c->tsf = tsf;
+    c->rxUs = rxUs;
+    c->rssi = rssi;
+    if (c->run < 0xFF) c->run++;
+    if (c->onAlt) switchClock(c);
+    c->onAlt = false;
+    c->altAlone = 0;
+
+    uint32_t baseMs = (rxUs - c->refRxUs) / 1000;
+    if (baseMs >= TSF_REBASE_MS) {
+      c->refTsf = tsf;
+      c->refRxUs = rxUs;
+    } else if (baseMs >= TSF_DRIFT_BASE_MS) {
+      int64_t ahead = (int64_t)(tsf - c->refTsf - (rxUs - c->refRxUs));
+      int32_t drift = (int32_t)constrain(ahead, -100000, 100000) * 16000 / (int32_t)baseMs;
+      c->drift = constrain(drift, -TSF_DRIFT_MAX_PPM * 16, TSF_DRIFT_MAX_PPM * 16);
+    }
+    return;
+  }
+
+  if (c->altRun &&
+      deviation(tsf, rxUs, c->altTsf, c->altRxUs, 0, TSF_DRIFT_MAX_PPM) != INT32_MAX) {
+    c->altTsf = tsf;
+    c->altRxUs = rxUs;
+    if (c->altRun < 0xFF) c->altRun++;
+    if (!c->onAlt) switchClock(c);
+    c->onAlt = true;
+    if (++c->altAlone >= TSF_ADOPT_BEACONS) {
+      anchor(c, tsf, rxUs);
+      c->intervalTu = intervalTu;
+      c->drift = 0;
+      c->jitter = 0;
+      c->run = c->altRun;
+      c->altRun = 0;
+      c->altAlone = 0;
+      c->onAlt = false;
+    }
+    return;
+  }
+
+  c->altTsf = tsf;
+  c->altRxUs = rxUs;
+  c->altRun = 1;
+  c->altAlone = 1;
+}
+
+// Beacons under this BSSID keep alternating between two clocks, or sway
+// around one by more than any single AP does
+bool tsfCloned(const uint8_t* bssid) {
+  const TsfClock* c = findClock(bssid);
+  if (!c || c->run < TSF_ESTABLISHED) return false;
+  if (c->jitter > TSF_JITTER_MAX_US * 16) return true;
+  return c->switches >= TSF_CLONE_SWITCHES && millis() - c->lastSwitchMs <= TSF_CLONE_HOLD_MS;
+}
+
+bool tsfStats(const uint8_t* bssid, int16_t* driftPpm, uint16_t* jitterUs) {
+  const TsfClock* c = findClock(bssid);
+  if (!c || c->run < TSF_ESTABLISHED) return false;
+  if (driftPpm) *driftPpm = (int16_t)(c->drift / 16);
+  if (jitterUs) *jitterUs = c->jitter / 16;
+  return true;
+}
+
+const TsfClock* tsfClockAt(uint16_t i) {
+  if (i >= TSF_CLOCKS) return nullptr;
+  const TsfClock* c = &clocks[i / TSF_WAYS][i % TSF_WAYS];
+  return c->run ? c : nullptr;
+}
@@ -0,0 +1,14 @@
+#ifndef TSF_WATCH_H
+#define TSF_WATCH_H
+
+#include "config.h"
+#include <esp_wifi.h>
+
+#define TSF_CLOCKS ((1 << TSF_SET_BITS) * TSF_WAYS)
+
+void IRAM_ATTR tsfObserve(const wifi_promiscuous_pkt_t* p);
+bool tsfCloned(const uint8_t* bssid);
+bool tsfStats(const uint8_t* bssid, int16_t* driftPpm, uint16_t* jitterUs);
+const TsfClock* tsfClockAt(uint16_t i);
+
+#endif // TSF_WATCH_H
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "wifi_scanner.h"
+#include "beacon_loss.h"
 
 const Vendor vendors[] = {
   {{0x00, 0x03, 0x93}, "Apple"},
@@ -57,11 +58,17 @@ char getQualityGrade(wifi_ap_record_t* ap) {
   else if (ap->authmode == WIFI_AUTH_WPA_PSK) score += 10;
   else if (ap->authmode == WIFI_AUTH_WEP) score += 5;
 
-  uint8_t load = channelLoad(ap->primary);
+  uint8_t load = channelUtilization(ap->primary);
   if (load < 20) score += 30;
   else if (load < 40) score += 20;
   else if (load < 70) score += 10;
 
+  // Missed beacons mean missed frames, whatever the scan RSSI said
+  int8_t loss = beaconLossPct(ap->bssid);
+  if (loss >= 50) score -= 40;
+  else if (loss >= 20) score -= 20;
+  else if (loss >= 10) score -= 10;
+
   if (score >= 90) return 'A';
   if (score >= 75) return 'B';
   if (score >= 60) return 'C';
@@ -69,14 +76,23 @@ char getQualityGrade(wifi_ap_record_t* ap) {
   return 'F';
 }
 
-bool hasOverlap(uint8_t ch1, uint8_t ch2) {
-  return abs(ch1 - ch2) <= 4 && abs(ch1 - ch2) > 0;
+// A 20 MHz channel reaches two channel numbers either side of its centre;
+// a 40 MHz AP adds four more on the side of its secondary channel. Sharing
+// the primary is contention, not overlap, and is not counted here.
+bool apOverlaps(const wifi_ap_record_t& ap, uint8_t ch) {
+  if (ap.primary == ch) return false;
+  int lo = ap.primary - 2;
+  int hi = ap.primary + 2;
+  int8_t secondary = apSecondaryOffset(ap);
+  if (secondary > 0) hi += 4;
+  else if (secondary < 0) lo -= 4;
+  return lo <= ch + 2 && hi >= ch - 2;
 }
 
 uint8_t countOverlappingAPs(uint8_t channel) {
   uint8_t count = 0;
   for (int i = 0; i < apCount; i++) {
-    if (hasOverlap(channel, apList[i].primary)) {
+    if (apOverlaps(apList[i], channel)) {
       count++;
     }
   }
@@ -10,7 +10,7 @@ extern const uint8_t vendorCount;
 const char* getVendor(uint8_t* mac);
 float estimateDistance(int rssi);
 char getQualityGrade(wifi_ap_record_t* ap);
-bool hasOverlap(uint8_t ch1, uint8_t ch2);
+bool apOverlaps(const wifi_ap_record_t& ap, uint8_t ch);
 uint8_t countOverlappingAPs(uint8_t channel);
 const char* authStr(wifi_auth_mode_t m);
 
@@ -1,8 +1,23 @@
 #include "wifi_scanner.h"
+#include "airtime.h"
+#include "ingest.h"
+#include "deauth_detector.h"
+#include "flood_detector.h"
+#include "karma_detector.h"
+#include "cardinality.h"
+#include "talkers.h"
+#include "beacon_loss.h"
+#include "retries.h"
+#include "seq_watch.h"
+#include "tsf_watch.h"
+#include "csa_watch.h"
+#include "eapol_watch.h"
+#include "sniffer_stats.h"
+#include "profiler.h"
 #include "security.h"
 #include "utils.h"
 
-volatile uint32_t pktTotal = 0, pktBeacon = 0, pktData = 0, pktDeauth = 0;
+volatile uint32_t pktTotal = 0, pktBeacon = 0, pktData = 0, pktDeauth = 0, pktDisassoc = 0;
 volatile int32_t rssiAccum = 0;
 volatile uint32_t rssiCount = 0;
 uint32_t history[HISTORY_SIZE];
@@ -21,6 +36,26 @@ uint8_t analyzerChannel = 1;
 uint8_t selectedChannel = 1;
 uint32_t analyzerLastHop = 0;
 
+// Per-channel counters are only ever written by the sniffer callback and are
+// never reset. Readers copy them under a seqlock: the writer makes the
+// sequence odd while it updates, so a copy taken across an update is retried.
+static ChannelCounters rxCounters;
+static volatile uint32_t rxCounterSeq = 0;
+static ChannelCounters analyzerBase;
+
+// Busy time per channel. Each dwell on a channel adds its airtime and its
+// length to decaying accumulators, so load is airtime / listening time
+// weighted towards the most recent dwells. Retry rate is kept the same way.
+static uint8_t dwellChannel = 0;
+static uint32_t dwellStart = 0;
+static uint32_t dwellAirtimeBase = 0;
+static uint32_t dwellRetryBase = 0;
+static uint32_t dwellSequencedBase = 0;
+static uint32_t busyAirUs[MAX_CHANNEL + 1];
+static uint32_t busyDwellMs[MAX_CHANNEL + 1];
+static uint32_t busyRetry[MAX_CHANNEL + 1];
+static uint32_t busySequenced[MAX_CHANNEL + 1];
+
 wifi_ap_record_t apList[MAX_APS];
 uint16_t apCount = 0;
 uint8_t apCursor = 0;
@@ -47,9 +82,8 @@ uint32_t loggedPackets = 0;
 bool loggingActive = false;
 
 uint32_t totalDeauthDetected = 0;
+uint32_t totalDisassocDetected = 0;
 uint32_t deauthPerSecond = 0;
-uint32_t lastDeauthCount = 0;
-uint32_t lastDeauthCheck = 0;
 bool attackActive = false;
 uint8_t deauthChannel = 0;
 
@@ -59,59 +93,146 @@ void initWiFi() {
   esp_wifi_init(&cfg);
 }
 
+static void beginDwell(uint8_t ch) {
+  ChannelCounters now;
+  readChannelCounters(&now);
+  dwellChannel = ch;
+  dwellStart = millis();
+  dwellAirtimeBase = now.airtimeUs[ch];
+  dwellRetryBase = now.retry[ch];
+  dwellSequencedBase = now.sequenced[ch];
+  beaconLossBeginDwell(ch);
+}
+
+static void endDwell() {
+  if (dwellChannel == 0) return;
+  uint8_t ch = dwellChannel;
+  dwellChannel = 0;
+
+  uint32_t elapsed = millis() - dwellStart;
+  beaconLossEndDwell(ch, elapsed);
+  if (elapsed < DWELL_MIN_MS) return;
+
+  ChannelCounters now;
+  readChannelCounters(&now);
+  uint32_t air = now.airtimeUs[ch] - dwellAirtimeBase;
+  busyAirUs[ch] = busyAirUs[ch] - busyAirUs[ch] / 4 + air;
+  busyDwellMs[ch] = busyDwellMs[ch] - busyDwellMs[ch] / 4 + elapsed;
+  busyRetry[ch] = busyRetry[ch] - busyRetry[ch] / 4 + (now.retry[ch] - dwellRetryBase);
+  busySequenced[ch] = busySequenced[ch] - busySequenced[ch] / 4 + (now.sequenced[ch] - dwellSequencedBase);
+}
+
+void sampleDwell() {
+  uint8_t ch = dwellChannel;
+  if (ch == 0) return;
+  endDwell();
+  beginDwell(ch);
+}
+
+void resetChannelBusy() {
+  memset(busyAirUs, 0, sizeof(busyAirUs));
+  memset(busyDwellMs, 0, sizeof(busyDwellMs));
+  memset(busyRetry, 0, sizeof(busyRetry));
+  memset(busySequenced, 0, sizeof(busySequenced));
+}
+
 void stopAllWifi() {
+  PhaseScope radio(PH_RADIO);
+  endDwell();
   esp_wifi_scan_stop();
   esp_wifi_set_promiscuous(false);
 }
 
 void enterSnifferMode(uint8_t ch) {
+  PhaseScope radio(PH_RADIO);
   stopAllWifi();
   esp_wifi_set_mode(WIFI_MODE_NULL);
   esp_wifi_start();
   esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
   esp_wifi_set_promiscuous_rx_cb(sniffer);
   esp_wifi_set_promiscuous(true);
+  beginDwell(ch);
+}
+
+void setSnifferChannel(uint8_t ch) {
+  PhaseScope radio(PH_RADIO);
+  bool tracking = dwellChannel != 0;
+  endDwell();
+  esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+  if (tracking) beginDwell(ch);
 }
 
 void enterScanMode() {
+  PhaseScope radio(PH_RADIO);
   stopAllWifi();
   esp_wifi_set_mode(WIFI_MODE_STA);
   esp_wifi_start();
 }
 
+void readChannelCounters(ChannelCounters* out) {
+  uint32_t seq;
+  do {
+    seq = rxCounterSeq;
+    __sync_synchronize();
+    memcpy(out, &rxCounters, sizeof(ChannelCounters));
+    __sync_synchronize();
+  } while ((seq & 1) || seq != rxCounterSeq);
+}
+
 void resetLiveStats() {
-  pktTotal = pktBeacon = pktData = pktDeauth = 0;
+  pktTotal = pktBeacon = pktData = pktDeauth = pktDisassoc = 0;
   rssiAccum = rssiCount = 0;
   pps = peak = lastPkt = 0;
   smoothPps = 0;
   memset(history, 0, sizeof(history));
   histIdx = 0;
   lastSecond = millis();
+  resetTalkers();
 }
 
 void resetAnalyzer() {
   memset(chPackets, 0, sizeof(chPackets));
   memset(chBeacons, 0, sizeof(chBeacons));
   memset(chDeauth, 0, sizeof(chDeauth));
+  readChannelCounters(&analyzerBase);
+  resetChannelBusy();
   analyzerChannel = 1;
   analyzerLastHop = millis();
 }
 
+void updateAnalyzerCounters() {
+  ChannelCounters now;
+  readChannelCounters(&now);
+  for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
+    chPackets[ch] = now.total[ch] - analyzerBase.total[ch];
+    chBeacons[ch] = now.beacon[ch] - analyzerBase.beacon[ch];
+    chDeauth[ch] = now.deauth[ch] - analyzerBase.deauth[ch];
+  }
+}
+
 void resetSession() {
   sessionStart = millis();
   totalAPsFound = 0;
   peakPPS = 0;
   totalPackets = 0;
   totalDeauthDetected = 0;
+  totalDisassocDetected = 0;
   loggedPackets = 0;
 }
 
 void startApScan() {
+  PhaseScope radio(PH_RADIO);
   wifi_scan_config_t cfg = {};
   cfg.show_hidden = true;
   esp_wifi_scan_start(&cfg, false);
 }
 
+// Blocking wait for an AP scan started with startApScan().
+void waitForScan(uint32_t ms) {
+  PhaseScope radio(PH_RADIO);
+  delay(ms);
+}
+
 void sortApsByRssi() {
   for (int i = 0; i < apCount - 1; i++) {
     for (int j = 0; j < apCount - i - 1; j++) {
@@ -132,6 +253,8 @@ void fetchApResults(bool forceSort) {
 
   secOpen = secWEP = secWPA = secWPA2 = secWPA3 = 0;
   for (int i = 0; i < apCount; i++) {
+    cardinalityObserveAP(apList[i]);
+    beaconLossTrack(apList[i]);
     switch (apList[i].authmode) {
       case WIFI_AUTH_OPEN: secOpen++; break;
       case WIFI_AUTH_WEP: secWEP++; break;
@@ -139,6 +262,7 @@ void fetchApResults(bool forceSort) {
       case WIFI_AUTH_WPA2_PSK:
       case WIFI_AUTH_WPA_WPA2_PSK: secWPA2++; break;
       case WIFI_AUTH_WPA3_PSK: secWPA3++; break;
+      default: break;
     }
   }
 
@@ -153,18 +277,19 @@ void fetchApResults(bool forceSort) {
 }
 
 uint8_t liveLoad() {
-  uint32_t score = pps + pktBeacon / 2 + pktDeauth * 3;
-  return min(score / 5, 100UL);
+  return channelLoad(dwellChannel ? dwellChannel : currentChannel);
 }
 
 const char* channelInsight() {
   if (attackActive) return "ATTACK DETECTED!";
   if (deauthPerSecond > 5) return "Deauth Storm!";
-  if (pktDeauth > pktBeacon / 4 && pktDeauth > 5) return "Possible Attack";
+  uint32_t kicks = pktDeauth + pktDisassoc;
+  if (kicks > pktBeacon / 4 && kicks > 5) return "Possible Attack";
 
   uint8_t load = liveLoad();
   if (load > 80) return "Overloaded";
   if (load > 60) return "Congested";
+  if (liveRetryPct() > 25) return "Many Retries";
 
   if (pktData > pktBeacon * 3) return "Heavy Traffic";
   if (pktData > pktBeacon * 2) return "Active Data";
@@ -178,8 +303,29 @@ const char* channelInsight() {
 }
 
 uint8_t channelLoad(uint8_t ch) {
-  uint32_t score = chPackets[ch] + chBeacons[ch] / 2 + chDeauth[ch] * 3;
-  return min(score / 5, 100UL);
+  if (ch == 0 || ch > MAX_CHANNEL || busyDwellMs[ch] == 0) return 0;
+  uint32_t pct = busyAirUs[ch] / (busyDwellMs[ch] * 10);
+  return min(pct, (uint32_t)100);
+}
+
+// Our airtime figure only counts frames the radio decoded while it was on
+// the channel; an AP's BSS Load counts all the time its own CCA saw the
+// medium busy. Both undercount in their own way, so the busier one wins.
+uint8_t channelUtilization(uint8_t ch) {
+  uint8_t measured = channelLoad(ch);
+  int8_t reported = beaconReportedLoad(ch);
+  return reported > measured ? reported : measured;
+}
+
+// Share of management and data frames sent with the Retry bit, -1 until
+// enough have been heard on the channel
+int8_t channelRetryPct(uint8_t ch) {
+  if (ch == 0 || ch > MAX_CHANNEL || busySequenced[ch] < RETRY_MIN_FRAMES) return -1;
+  return (int8_t)(busyRetry[ch] * 100 / busySequenced[ch]);
+}
+
+int8_t liveRetryPct() {
+  return channelRetryPct(dwellChannel ? dwellChannel : currentChannel);
 }
 
 const char* loadQuality(uint8_t load) {
@@ -193,7 +339,7 @@ uint8_t bestChannel() {
   uint8_t best = 1;
   uint8_t bestScore = 255;
   for (int ch = 1; ch <= MAX_CHANNEL; ch++) {
-    uint8_t s = channelLoad(ch);
+    uint8_t s = channelUtilization(ch);
     if (s < bestScore && chPackets[ch] > 0) {
       bestScore = s;
       best = ch;
@@ -215,60 +361,169 @@ uint8_t bestAPIndex() {
   return bestIdx;
 }
 
+// What the callback does with each management subtype
+#define MGMT_BEACON 0x01    // counted; flood, loss, sequence and clock checks
+#define MGMT_DEAUTH 0x02    // counted; sequence verdict, queued for the deauth detector
+#define MGMT_DISASSOC 0x04  // the same, counted apart
+#define MGMT_PROBE 0x08     // SSID queued for the hidden network list
+#define MGMT_RESPONSE 0x10  // Karma check
+#define MGMT_CSA 0x20       // may announce a channel switch
+#define MGMT_ASSOC 0x40     // station and AP queued for the client/AP graph
+
+DRAM_ATTR static const uint8_t mgmtRole[16] = {
+  MGMT_ASSOC, 0, MGMT_ASSOC, 0,                  // (re)association request and response
+  MGMT_PROBE, MGMT_RESPONSE | MGMT_CSA, 0, 0,    // probe request, probe response, timing advertisement
+  MGMT_BEACON | MGMT_CSA, 0, MGMT_DISASSOC, 0,   // beacon, ATIM, disassociation, authentication
+  MGMT_DEAUTH, MGMT_CSA, MGMT_CSA, 0,            // deauthentication, action, action no ack
+};
+
 void IRAM_ATTR sniffer(void* buf, wifi_promiscuous_pkt_type_t type) {
+  SnifferProbe probe(snifferStats[CB_SNIFFER]);
   const wifi_promiscuous_pkt_t* p = (wifi_promiscuous_pkt_t*)buf;
 
-  pktTotal++;
-  totalPackets++;
-  rssiAccum += p->rx_ctrl.rssi;
-  rssiCount++;
+  if (p->rx_ctrl.rx_state != 0) {
+    statsRxError(CB_SNIFFER);
+    return;
+  }
+
+  uint8_t ch = p->rx_ctrl.channel;
+  if (ch == 0 || ch > MAX_CHANNEL) {
+    statsDiscard(CB_SNIFFER);
+    return;
+  }
 
+  uint8_t st = 0;
+  uint8_t role = 0;
   if (type == WIFI_PKT_MGMT) {
-    uint8_t st = 0;
-    if (p->payload) st = (p->payload[0] >> 4) & 0x0F;
-
-    if (st == 0x08) {
-      pktBeacon++;
-    } else if (st == 0x0C || st == 0x0A) {
-      pktDeauth++;
-      totalDeauthDetected++;
+    st = (p->payload[0] >> 4) & 0x0F;
+    role = mgmtRole[st];
+  }
+  bool isBeacon = role & MGMT_BEACON;
+  bool isDeauth = role & (MGMT_DEAUTH | MGMT_DISASSOC);
+  bool isData = (type == WIFI_PKT_DATA);
+  bool acked = type != WIFI_PKT_CTRL && p->rx_ctrl.sig_len >= 10 && !(p->payload[4] & 0x01);
+  uint32_t air = frameAirtimeUs(&p->rx_ctrl, acked);
+  bool sequenced = type != WIFI_PKT_CTRL && p->rx_ctrl.sig_len >= 24;
+  bool retry = sequenced && (p->payload[1] & 0x08);
+  bool duplicate = sequenced && retryDuplicate(p->payload);
+
+  rxCounterSeq++;
+  __sync_synchronize();
+  if (!duplicate) {
+    rxCounters.total[ch]++;
+    if (isBeacon) rxCounters.beacon[ch]++;
+    if (isDeauth) rxCounters.deauth[ch]++;
+    if (isData) rxCounters.data[ch]++;
+  }
+  rxCounters.airtimeUs[ch] += air;
+  if (retry) rxCounters.retry[ch]++;
+  if (sequenced) rxCounters.sequenced[ch]++;
+  __sync_synchronize();
+  rxCounterSeq++;
+
+  // A copy still took airtime, but it is not a new frame for the traffic
+  // counts, here or in the pkt and total counters below. The detectors
+  // still see it: a flood sent with Retry set and one sequence number
+  // would otherwise never be counted.
+  talkersObserve(p, type, air);
+  if (!duplicate) {
+    pktTotal++;
+    totalPackets++;
+    rssiAccum += p->rx_ctrl.rssi;
+    rssiCount++;
+    cardinalityObserveWiFi(p, type);
+  }
+
+  uint8_t deferred = 0;
+  if (role) {
+    SeqVerdict v = SEQ_UNKNOWN;
+    if (isBeacon) {
+      if (!duplicate) pktBeacon++;
+      floodObserveBeacon(p);
+      beaconLossObserve(p);
+      if (sequenced) {
+        v = seqCheck(p, true);
+        tsfObserve(p);
+      }
+    } else if (isDeauth) {
+      if (!duplicate) {
+        if (role & MGMT_DISASSOC) {
+          pktDisassoc++;
+          totalDisassocDetected++;
+        } else {
+          pktDeauth++;
+          totalDeauthDetected++;
+        }
+      }
       deauthChannel = p->rx_ctrl.channel;
-    } else if (st == 0x04) {
-      if (p->payload && p->rx_ctrl.sig_len > 26) {
-        uint8_t ssidLen = p->payload[25];
-        if (ssidLen > 0 && ssidLen <= 32) {
-          char probedSSID[33] = {0};
-          uint8_t copyLen = (ssidLen < 32) ? ssidLen : 32;
-          memcpy(probedSSID, &p->payload[26], copyLen);
-          probedSSID[copyLen] = 0;
-
-          bool found = false;
-          for (int i = 0; i < hiddenCount; i++) {
-            if (strcmp(hiddenList[i].ssid, probedSSID) == 0) {
-              if (p->rx_ctrl.rssi > hiddenList[i].rssi) {
-                hiddenList[i].rssi = p->rx_ctrl.rssi;
-              }
-              hiddenList[i].active = true;
-              found = true;
-              break;
-            }
-          }
-          if (!found && hiddenCount < MAX_HIDDEN_SSIDS && strlen(probedSSID) > 0) {
-            strcpy(hiddenList[hiddenCount].ssid, probedSSID);
-            hiddenList[hiddenCount].rssi = p->rx_ctrl.rssi;
-            hiddenList[hiddenCount].channel = p->rx_ctrl.channel;
-            hiddenList[hiddenCount].active = true;
-            hiddenCount++;
+      deferred |= INGEST_DEAUTH;
+      // A copy repeats a number already judged; it is counted unjudged
+      v = sequenced && !duplicate ? seqCheck(p, false) : SEQ_UNKNOWN;
+      if (v == SEQ_STRAY) deferred |= INGEST_SPOOFED;
+      else if (v == SEQ_IN_STREAM) deferred |= INGEST_GENUINE;
+      deauthCount(ch, v == SEQ_IN_STREAM);
+    } else if ((role & MGMT_PROBE) && p->rx_ctrl.sig_len > 26) {
+      deferred |= INGEST_PROBE;
+    }
+    if (role & MGMT_RESPONSE) karmaObserveResponse(p);
+    if ((role & MGMT_CSA) && sequenced) csaObserve(p, st, v, duplicate);
+    if ((role & MGMT_ASSOC) && sequenced && !duplicate) deferred |= INGEST_ASSOC;
+  } else if (isData && !duplicate) {
+    pktData++;
+    if (sequenced) {
+      eapolObserve(p);
+      uint8_t ds = p->payload[1] & 0x03;
+      if (ds == 1 || ds == 2) deferred |= INGEST_ASSOC;
+    }
+  }
+
+  if (loggingActive && settings.csvLogging && loggedPackets < CSV_LOG_LIMIT) {
+    deferred |= INGEST_LOG;
+  }
+  // The graph only needs a station seen now and then, not every frame
+  if (deferred == INGEST_ASSOC && ingestHalfFull()) deferred = 0;
+  if (deferred) {
+    uint16_t snap = deferred & INGEST_ASSOC ? 24 : 0;
+    if (deferred & INGEST_DEAUTH) snap = 26;
+    if (deferred & INGEST_PROBE) snap = 26 + MAX_SSID_LEN;
+    ingestPush(CB_SNIFFER, p, type, deferred, snap);
+  }
+}
+
+// The part of sniffer() that runs in the loop, for frames it queued.
+void snifferDeferred(const IngestFrame& f) {
+  if (f.flags & INGEST_DEAUTH) deauthRecord(f);
+
+  if ((f.flags & INGEST_PROBE) && f.len > 26) {
+    uint8_t ssidLen = f.payload[25];
+    if (ssidLen > 0 && ssidLen <= 32 && 26 + ssidLen <= f.len) {
+      char probedSSID[33] = {0};
+      memcpy(probedSSID, &f.payload[26], ssidLen);
+      probedSSID[ssidLen] = 0;
+
+      bool found = false;
+      for (int i = 0; i < hiddenCount; i++) {
+        if (strcmp(hiddenList[i].ssid, probedSSID) == 0) {
+          if (f.rssi > hiddenList[i].rssi) {
+            hiddenList[i].rssi = f.rssi;
           }
+          hiddenList[i].active = true;
+          found = true;
+          break;
         }
       }
+      if (!found && hiddenCount < MAX_HIDDEN_SSIDS && strlen(probedSSID) > 0) {
+        strcpy(hiddenList[hiddenCount].ssid, probedSSID);
+        hiddenList[hiddenCount].rssi = f.rssi;
+        hiddenList[hiddenCount].channel = f.channel;
+        hiddenList[hiddenCount].active = true;
+        hiddenCount++;
+      }
     }
-  } else if (type == WIFI_PKT_DATA) {
-    pktData++;
   }
 
-  if (loggingActive && settings.csvLogging && loggedPackets < 1000) {
+  if ((f.flags & INGEST_LOG) && loggedPackets < CSV_LOG_LIMIT) {
     loggedPackets++;
-    Serial.printf("%lu,%d,%d,%d\n", millis(), p->rx_ctrl.channel, p->rx_ctrl.rssi, type);
+    Serial.printf("%lu,%d,%d,%d\n", (uint32_t)(f.timeUs / 1000), f.channel, f.rssi, f.type);
   }
 }
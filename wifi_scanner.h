@@ -5,7 +5,7 @@
 #include <esp_wifi.h>
 #include <nvs_flash.h>
 
-extern volatile uint32_t pktTotal, pktBeacon, pktData, pktDeauth;
+extern volatile uint32_t pktTotal, pktBeacon, pktData, pktDeauth, pktDisassoc;
 extern volatile int32_t rssiAccum;
 extern volatile uint32_t rssiCount;
 extern uint32_t history[HISTORY_SIZE];
@@ -51,29 +51,39 @@ extern uint32_t loggedPackets;
 extern bool loggingActive;
 
 extern uint32_t totalDeauthDetected;
+extern uint32_t totalDisassocDetected;
 extern uint32_t deauthPerSecond;
-extern uint32_t lastDeauthCount;
-extern uint32_t lastDeauthCheck;
 extern bool attackActive;
 extern uint8_t deauthChannel;
 
 void initWiFi();
 void stopAllWifi();
 void enterSnifferMode(uint8_t ch);
+void setSnifferChannel(uint8_t ch);
 void enterScanMode();
 void IRAM_ATTR sniffer(void* buf, wifi_promiscuous_pkt_type_t type);
+void snifferDeferred(const IngestFrame& f);
+
+void readChannelCounters(ChannelCounters* out);
+void sampleDwell();
+void resetChannelBusy();
 
 void resetLiveStats();
 void resetAnalyzer();
+void updateAnalyzerCounters();
 void resetSession();
 
 void startApScan();
+void waitForScan(uint32_t ms);
 void sortApsByRssi();
 void fetchApResults(bool forceSort = false);
 
 uint8_t liveLoad();
 const char* channelInsight();
 uint8_t channelLoad(uint8_t ch);
+uint8_t channelUtilization(uint8_t ch);
+int8_t channelRetryPct(uint8_t ch);
+int8_t liveRetryPct();
 const char* loadQuality(uint8_t load);
 uint8_t bestChannel();
 uint8_t bestAPIndex();